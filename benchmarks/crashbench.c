@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <config.h>
+#include <primitives.h>
+#include <fastrand.h>
+#include <threadtools.h>
+#include <barrier.h>
+#include <bench_args.h>
+#include <shadow.h>
+#include <pbcombqueue.h>
+#include <pbcombstack.h>
+#include <pbcombheap.h>
+
+// This benchmark kills a process that applies operations to a persistent object just before a chosen persist event
+// (i.e. pwb or psync), recovers the object from the persisted bytes (see shadow.h) and checks its invariants.
+
+/// The maximum total number of operations that the process applies to each object.
+#define CRASHBENCH_MAX_RUNS    2000
+/// The maximum number of persisted cache lines recorded for each run.
+#define CRASHBENCH_LOG_LINES   (1 << 21)
+
+#define CRASH_RECOVERED        0
+#define CRASH_NOT_CREATED      1
+#define CRASH_VIOLATION        2
+#define CRASH_INCONCLUSIVE     3
+
+enum { PBQUEUE_OBJECT, PBSTACK_OBJECT, PBHEAP_OBJECT, NUMBER_OF_OBJECTS };
+
+static const char *object_names[NUMBER_OF_OBJECTS] = {"pbqueue", "pbstack", "pbheap"};
+static const char *status_names[] = {"recovered", "not_created", "violation", "inconclusive"};
+
+PBCombQueueStruct *queue_object CACHE_ALIGN;
+PBCombStackStruct *stack_object;
+PBCombHeapStruct *heap_object;
+int object_type;
+SynchBarrier bar CACHE_ALIGN;
+SynchBenchArgs bench_args CACHE_ALIGN;
+
+// Each value identifies the thread that inserted it (upper 32 bits) and the order of its insertion (lower 32 bits).
+inline static ArgVal encodeValue(long id, long i) {
+    return (id << 32) | (i + 1);
+}
+
+inline static bool decodeValue(int64_t val, uint64_t *id, uint64_t *seq) {
+    *id = ((uint64_t)val) >> 32;
+    *seq = ((uint64_t)val) & 0xFFFFFFFFULL;
+
+    return *id < bench_args.nthreads && *seq >= 1 && *seq <= bench_args.runs;
+}
+
+inline static void *Execute(void* Arg) {
+    long id = (long) Arg;
+    long i;
+
+    synchFastRandomSetSeed(id + 1);
+    if (object_type == PBQUEUE_OBJECT) {
+        PBCombQueueThreadState *th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombQueueThreadState));
+
+        PBCombQueueThreadStateInit(queue_object, th_state, (int)id);
+        synchBarrierWait(&bar);
+        for (i = 0; i < bench_args.runs; i++) {
+            PBCombQueueApplyEnqueue(queue_object, th_state, encodeValue(id, i), id);
+            if (i % 2 == 1)
+                PBCombQueueApplyDequeue(queue_object, th_state, id);
+        }
+    } else if (object_type == PBSTACK_OBJECT) {
+        PBCombStackThreadState *th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombStackThreadState));
+
+        PBCombStackThreadStateInit(stack_object, th_state, (int)id);
+        synchBarrierWait(&bar);
+        for (i = 0; i < bench_args.runs; i++) {
+            PBCombStackPush(stack_object, th_state, encodeValue(id, i), id);
+            if (i % 2 == 1)
+                PBCombStackPop(stack_object, th_state, id);
+        }
+    } else {
+        PBCombHeapThreadState *th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombHeapThreadState));
+
+        PBCombHeapThreadStateInit(heap_object, th_state, (int)id);
+        synchBarrierWait(&bar);
+        for (i = 0; i < bench_args.runs; i++) {
+            PBCombHeapInsert(heap_object, th_state, encodeValue(id, i), id);
+            if (i % 2 == 1)
+                PBCombHeapDeleteMin(heap_object, th_state, id);
+        }
+    }
+
+    return NULL;
+}
+
+static void createObject(void) {
+    if (object_type == PBQUEUE_OBJECT) {
+        queue_object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombQueueStruct));
+        PBCombQueueInit(queue_object, bench_args.nthreads);
+        synchShadowSetRoot(0, (void *)queue_object->enqueue_struct.pstate);
+        synchShadowSetRoot(1, (void *)queue_object->dequeue_struct.pstate);
+    } else if (object_type == PBSTACK_OBJECT) {
+        stack_object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombStackStruct));
+        PBCombStackInit(stack_object, bench_args.nthreads);
+        synchShadowSetRoot(0, (void *)stack_object->object_struct.pstate);
+    } else {
+        heap_object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombHeapStruct));
+        PBCombHeapInit(heap_object, bench_args.nthreads);
+        synchShadowSetRoot(0, (void *)heap_object->heap.pstate);
+    }
+}
+
+// Runs the benchmarked operations in a child process that is killed just before its `crash_at`-th persist event.
+static void runChild(uint64_t crash_at) {
+    pid_t pid;
+    int status;
+
+    synchShadowReset(crash_at);
+    fflush(stdout);
+    pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    } else if (pid == 0) {
+        createObject();
+        synchBarrierSet(&bar, bench_args.nthreads);
+        synchStartThreadsN(bench_args.nthreads, Execute, bench_args.fibers_per_thread);
+        synchJoinThreadsN(bench_args.nthreads - 1);
+        _exit(EXIT_SUCCESS);
+    }
+    if (waitpid(pid, &status, 0) == -1) {
+        perror("waitpid");
+        exit(EXIT_FAILURE);
+    }
+    if (!((WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL) || (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS))) {
+        fprintf(stderr, "ERROR: the child process failed unexpectedly\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// The recovery of a PBcomb instance reads the latest persisted state record; the `state` field of the record
+// is not used, since the data of the state are always stored in the `flex` field.
+static bool recoverPBCombState(SynchShadowView *view, void *pstate, void *state, size_t state_size) {
+    PBCombPersistentState ps;
+
+    if (!synchShadowRead(view, pstate, &ps, sizeof(PBCombPersistentState)))
+        return false;
+
+    return synchShadowRead(view, ((char *)ps.last_state) + offsetof(PBCombStateRec, flex), state, state_size);
+}
+
+static int violation(const char *msg, const void *addr) {
+    fprintf(stderr, "%s: %s (%p)\n", object_names[object_type], msg, addr);
+    return CRASH_VIOLATION;
+}
+
+// Recovers the queue and checks that the recovered list is well-formed and the values of each thread are in FIFO order.
+static int recoverQueue(SynchShadowView *view, uint64_t *last_seq) {
+    void *enq_pstate = synchShadowGetRoot(0), *deq_pstate = synchShadowGetRoot(1);
+    uint64_t steps = 0, id, seq;
+    Node *first, *last, *cur, *next, node;
+
+    if (enq_pstate == NULL || deq_pstate == NULL)
+        return CRASH_NOT_CREATED;
+    if (!recoverPBCombState(view, enq_pstate, &last, sizeof(Node *)))
+        return violation("the state of enqueue instance is not persisted", enq_pstate);
+    if (!recoverPBCombState(view, deq_pstate, &first, sizeof(Node *)))
+        return violation("the state of dequeue instance is not persisted", deq_pstate);
+
+    // the first node is a dummy node, i.e. its value is already dequeued
+    for (cur = first; cur != last; cur = next) {
+        if (!synchShadowRead(view, cur, &node, sizeof(Node)))
+            return violation("a node of the queue is not persisted", cur);
+        next = (Node *)node.next;
+        if (next == NULL || ++steps > bench_args.total_runs)
+            return violation("the last node is not reachable from the first node", cur);
+        if (!synchShadowRead(view, next, &node, sizeof(Node)))
+            return violation("a node of the queue is not persisted", next);
+        if (!decodeValue(node.val, &id, &seq) || seq <= last_seq[id])
+            return violation("a value of the queue is invalid or out of order", next);
+        last_seq[id] = seq;
+    }
+
+    return CRASH_RECOVERED;
+}
+
+// Recovers the stack and checks that the recovered list is well-formed and the values of each thread are in LIFO order.
+static int recoverStack(SynchShadowView *view, uint64_t *last_seq) {
+    void *pstate = synchShadowGetRoot(0);
+    uint64_t steps = 0, id, seq;
+    Node *cur, node;
+
+    if (pstate == NULL)
+        return CRASH_NOT_CREATED;
+    if (!recoverPBCombState(view, pstate, &cur, sizeof(Node *)))
+        return violation("the state of the stack is not persisted", pstate);
+
+    for (id = 0; id < bench_args.nthreads; id++)
+        last_seq[id] = UINT64_MAX;
+    for (; cur != NULL; cur = (Node *)node.next) {
+        if (!synchShadowRead(view, cur, &node, sizeof(Node)))
+            return violation("a node of the stack is not persisted", cur);
+        if (++steps > bench_args.total_runs)
+            return violation("the list of nodes contains a cycle", cur);
+        if (!decodeValue(node.val, &id, &seq) || seq >= last_seq[id])
+            return violation("a value of the stack is invalid or out of order", cur);
+        last_seq[id] = seq;
+    }
+
+    return CRASH_RECOVERED;
+}
+
+// Recovers the heap and checks the heap property for all the used positions.
+static int recoverHeap(SynchShadowView *view, HeapState *heap) {
+    void *pstate = synchShadowGetRoot(0);
+    uint64_t level, pos, size, id, seq;
+
+    if (pstate == NULL)
+        return CRASH_NOT_CREATED;
+    if (!recoverPBCombState(view, pstate, heap, sizeof(HeapState)))
+        return violation("the state of the heap is not persisted", pstate);
+    if (heap->levels != INITIAL_HEAP_LEVELS || heap->last_used_level >= heap->levels ||
+        heap->last_used_level_size != _SIZE_OF_HEAP_LEVEL(heap->last_used_level) ||
+        heap->last_used_level_pos > heap->last_used_level_size)
+        return violation("the header of the heap is invalid", pstate);
+
+    for (level = 0; level <= heap->last_used_level; level++) {
+        size = (level == heap->last_used_level) ? heap->last_used_level_pos : _SIZE_OF_HEAP_LEVEL(level);
+        for (pos = 0; pos < size; pos++) {
+            if (!decodeValue(_HEAP_LEVEL(heap, level)[pos], &id, &seq))
+                return violation("a value of the heap is invalid", &_HEAP_LEVEL(heap, level)[pos]);
+            if (level > 0 && _HEAP_LEVEL(heap, level)[pos] < _HEAP_LEVEL(heap, level - 1)[pos / 2])
+                return violation("the heap property does not hold", &_HEAP_LEVEL(heap, level)[pos]);
+        }
+    }
+
+    return CRASH_RECOVERED;
+}
+
+// Recovers the object from the persisted bytes of the last run and returns its status.
+static int recoverObject(double *recovery_us) {
+    SynchShadowView view;
+    struct timespec start, end;
+    uint64_t *last_seq = calloc(bench_args.nthreads, sizeof(uint64_t));
+    HeapState *heap = malloc(sizeof(HeapState));
+    int status;
+
+    *recovery_us = 0;
+    if (synchShadowOverflow()) {
+        free(last_seq);
+        free(heap);
+        return CRASH_INCONCLUSIVE;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (synchShadowBuildView(&view) != 0) {
+        perror("synchShadowBuildView");
+        exit(EXIT_FAILURE);
+    }
+    if (object_type == PBQUEUE_OBJECT)
+        status = recoverQueue(&view, last_seq);
+    else if (object_type == PBSTACK_OBJECT)
+        status = recoverStack(&view, last_seq);
+    else
+        status = recoverHeap(&view, heap);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *recovery_us = (end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_nsec - start.tv_nsec) / 1000.0;
+
+    synchShadowFreeView(&view);
+    free(last_seq);
+    free(heap);
+
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t events, points, i;
+    int status;
+
+    synchParseArguments(&bench_args, argc, argv);
+    if (bench_args.total_runs > CRASHBENCH_MAX_RUNS) {
+        fprintf(stderr, "WARNING: the number of operations is limited to %d\n", CRASHBENCH_MAX_RUNS);
+        bench_args.total_runs = CRASHBENCH_MAX_RUNS;
+    }
+    bench_args.runs = bench_args.total_runs / bench_args.nthreads;
+    if (bench_args.runs == 0)
+        bench_args.runs = 1;
+    bench_args.total_runs = bench_args.runs * bench_args.nthreads;
+    if (synchShadowInit(CRASHBENCH_LOG_LINES) != 0)
+        exit(EXIT_FAILURE);
+    synchFastRandomSetSeed(1);
+
+    for (object_type = 0; object_type < NUMBER_OF_OBJECTS; object_type++) {
+        uint64_t count[4] = {0, 0, 0, 0};
+        double recovery_us = 0, total_us = 0, max_us = 0;
+
+        // a run without crash counts the persist events and checks the final state
+        runChild(0);
+        events = synchShadowEvents();
+        points = (bench_args.crash_points == 0 || bench_args.crash_points > events) ? events : bench_args.crash_points;
+
+        for (i = 0; i <= points; i++) {
+            uint64_t crash_at = 0;
+
+            if (i > 0) {
+                crash_at = (points == events) ? i : synchFastRandomRange(1, events);
+                runChild(crash_at);
+            }
+            status = recoverObject(&recovery_us);
+            count[status]++;
+            total_us += recovery_us;
+            if (recovery_us > max_us)
+                max_us = recovery_us;
+            printf("object: %s\tcrash_point: %lu\tstatus: %s\trecovery_time: %.2f (us)\n",
+                   object_names[object_type], crash_at, status_names[status], recovery_us);
+        }
+        printf("object: %s\tpersist_events: %lu\tcrash_points: %lu\trecovered: %lu\tnot_created: %lu\tviolations: %lu\t"
+               "inconclusive: %lu\tavg_recovery_time: %.2f (us)\tmax_recovery_time: %.2f (us)\n",
+               object_names[object_type], events, points + 1, count[CRASH_RECOVERED], count[CRASH_NOT_CREATED],
+               count[CRASH_VIOLATION], count[CRASH_INCONCLUSIVE], total_us / (points + 1), max_us);
+    }
+    synchShadowDestroy();
+
+    return 0;
+}
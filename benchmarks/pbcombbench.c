@@ -10,21 +10,27 @@
 #include <threadtools.h>
 #include <barrier.h>
 #include <pbcomb.h>
+#include <replica.h>
 #include <bench_args.h>
 
 
 volatile Object *object CACHE_ALIGN;
 PBCombStruct *object_lock;
-int64_t d1 CACHE_ALIGN, d2;
+SynchReplicaStruct *replica;
+int64_t d0, d1 CACHE_ALIGN, d2;
 SynchBarrier bar CACHE_ALIGN;
 SynchBenchArgs bench_args CACHE_ALIGN;
 
 
 inline static RetVal fetchAndMultiply(void *state, ArgVal arg, int pid) {
-    *object += arg;
-    return *object;
+    Object *obj = (Object *)state;
+
+    *obj += arg;
+    return *obj;
 }
 
+PBCOMB_DEFINE_OBJECT(fetchAndMultiply, Object, fetchAndMultiply, NULL, NULL)
+
 inline static void *Execute(void* Arg) {
     PBCombThreadState lobject_lock;
     long i, rnum;
@@ -38,7 +44,7 @@ inline static void *Execute(void* Arg) {
         d1 = synchGetTimeMillis();
     for (i = 0; i < bench_args.runs; i++) {
         // perform a fetchAndMultiply operation
-        PBCombApplyOp(object_lock, &lobject_lock, fetchAndMultiply, (ArgVal) id, id);
+        fetchAndMultiplyApplyOp(object_lock, &lobject_lock, (ArgVal) id, id);
         rnum = synchFastRandomRange(1, bench_args.max_work);
         for (j = 0; j < rnum; j++)
             ;
@@ -49,11 +55,18 @@ inline static void *Execute(void* Arg) {
 
 int main(int argc, char *argv[]) {
     synchParseArguments(&bench_args, argc, argv);
+    d0 = synchGetTimeMillis();
 
     object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(Object));
     *object = 1;
     object_lock = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombStruct));
     PBCombStructInit(object_lock, bench_args.nthreads, (void *)object, sizeof(Object));
+    if (bench_args.replica) {
+        replica = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(SynchReplicaStruct));
+        if (synchReplicaInit(replica, NULL, sizeof(Object), 0) != 0 || synchReplicaStart(replica) != 0)
+            exit(EXIT_FAILURE);
+        PBCombSetReplica(object_lock, replica);
+    }
 
     synchBarrierSet(&bar, bench_args.nthreads);
     synchStartThreadsN(bench_args.nthreads, Execute, bench_args.fibers_per_thread);
@@ -62,11 +75,25 @@ int main(int argc, char *argv[]) {
 
     printf("time: %d (ms)\tthroughput: %.2f (millions ops/sec)\t", (int) (d2 - d1), bench_args.runs * bench_args.nthreads/(1000.0*(d2 - d1)));
     synchPrintStats(bench_args.nthreads, bench_args.total_runs);
+    fprintf(stderr, "time_to_ready: %d (ms)\n", (int) (d1 - d0));
+    if (bench_args.replica) {
+        fprintf(stderr, "replica_lag: %lu (rounds)\treplica_max_lag: %lu (rounds)\treplica_mirror_writes: %lu\n",
+                synchReplicaLag(replica), replica->max_lag, replica->mirror_writes);
+        synchReplicaStop(replica);
+    }
 
 #ifdef DEBUG
     fprintf(stderr, "DEBUG: Object state: %d\n", object_lock->counter);
     fprintf(stderr, "DEBUG: rounds: %d\n", object_lock->rounds);
     fprintf(stderr, "DEBUG: Average helping: %f\n", (float)object_lock->counter/object_lock->rounds);
+    if (bench_args.replica) {
+        uint64_t mirror_round;
+        Object *mirror_state = synchReplicaMirrorData(replica->mirror, &mirror_round);
+
+        // after stopping the shipper, the mirror should be equal to the final state of the object
+        fprintf(stderr, "DEBUG: replica: round: %lu (expected %lu) -- state: %s\n", mirror_round, (uint64_t)object_lock->lock / 2,
+                (*mirror_state == *(Object *)object_lock->pstate->last_state->state) ? "equal" : "DIFFERENT");
+    }
     fprintf(stderr, "\n");
 #endif
     
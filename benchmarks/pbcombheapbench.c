@@ -13,7 +13,7 @@
 #include <bench_args.h>
 
 PBCombHeapStruct *object_struct CACHE_ALIGN;
-int64_t d1 CACHE_ALIGN, d2;
+int64_t d0, d1 CACHE_ALIGN, d2;
 SynchBarrier bar CACHE_ALIGN;
 SynchBenchArgs bench_args CACHE_ALIGN;
 
@@ -50,6 +50,7 @@ int main(int argc, char *argv[]) {
     int i;
 
     synchParseArguments(&bench_args, argc, argv);
+    d0 = synchGetTimeMillis();
     object_struct = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombHeapStruct));
     PBCombHeapInit(object_struct, bench_args.nthreads);
     PBCombHeapThreadStateInit(object_struct, &th_state, 0);
@@ -63,6 +64,7 @@ int main(int argc, char *argv[]) {
 
     printf("time: %d (ms)\tthroughput: %.2f (millions ops/sec)\t", (int) (d2 - d1), 2 * bench_args.runs * bench_args.nthreads/(1000.0*(d2 - d1)));
     synchPrintStats(bench_args.nthreads, bench_args.total_runs);
+    fprintf(stderr, "time_to_ready: %d (ms)\n", (int) (d1 - d0));
 
 #ifdef DEBUG
     fprintf(stderr, "DEBUG: object state: counter: %lld rounds: %d\n", object_struct->heap.counter - INITIAL_HEAP_SIZE, object_struct->heap.rounds);
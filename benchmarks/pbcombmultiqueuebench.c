@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <config.h>
+#include <primitives.h>
+#include <fastrand.h>
+#include <threadtools.h>
+#include <pbcombmultiqueue.h>
+#include <barrier.h>
+#include <bench_args.h>
+
+// Besides throughput, this benchmark reports the rank error of the delete-min operations, i.e. the number of elements
+// of the priority queue that are smaller than the removed one. Each thread logs the completion time (see synchGetTSC)
+// and the value of its operations, and after the end of the experiment, the logs are merged and replayed in order.
+
+/// The values of the inserted elements are chosen at random in [1, RANK_DOMAIN).
+#define RANK_DOMAIN      (1 << 20)
+#define RANK_DELETE_OP   (1ULL << 63)
+
+typedef struct RankLogEntry {
+    uint64_t ts;
+    uint64_t val;
+} RankLogEntry;
+
+PBCombMultiQueueStruct *object_struct CACHE_ALIGN;
+RankLogEntry **rank_logs;
+uint64_t *rank_log_sizes;
+int64_t d0, d1 CACHE_ALIGN, d2;
+SynchBarrier bar CACHE_ALIGN;
+SynchBenchArgs bench_args CACHE_ALIGN;
+
+inline static void logOperation(long id, uint64_t val) {
+    RankLogEntry *entry = &rank_logs[id][rank_log_sizes[id]++];
+
+    entry->ts = synchGetTSC();
+    entry->val = val;
+}
+
+inline static void *Execute(void* Arg) {
+    PBCombMultiQueueThreadState *th_state;
+    long i, rnum;
+    volatile int j;
+    long id = (long) Arg;
+    HeapElement val;
+
+    synchFastRandomSetSeed(id + 1);
+    th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombMultiQueueThreadState));
+    PBCombMultiQueueThreadStateInit(object_struct, th_state, (int)id);
+    synchBarrierWait(&bar);
+    if (id == 0)
+        d1 = synchGetTimeMillis();
+
+    for (i = 0; i < bench_args.runs; i++) {
+        // perform an insert operation
+        val = synchFastRandomRange32(1, RANK_DOMAIN - 2);
+        if (PBCombMultiQueueInsert(object_struct, th_state, val, id) == HEAP_INSERT_SUCCESS)
+            logOperation(id, val);
+        rnum = synchFastRandomRange(1, bench_args.max_work);
+        for (j = 0; j < rnum; j++)
+            ;
+        // perform a delete-min operation
+        val = PBCombMultiQueueDeleteMin(object_struct, th_state, id);
+        if (val != EMPTY_HEAP)
+            logOperation(id, val | RANK_DELETE_OP);
+        rnum = synchFastRandomRange(1, bench_args.max_work);
+        for (j = 0; j < rnum; j++)
+            ;
+    }
+    return NULL;
+}
+
+static int compareEntries(const void *a, const void *b) {
+    const RankLogEntry *e1 = a, *e2 = b;
+
+    return (e1->ts > e2->ts) - (e1->ts < e2->ts);
+}
+
+static int compareRanks(const void *a, const void *b) {
+    uint64_t r1 = *(const uint64_t *)a, r2 = *(const uint64_t *)b;
+
+    return (r1 > r2) - (r1 < r2);
+}
+
+// Replays the merged logs using a Fenwick tree that counts the present elements per value.
+static void printRankErrors(void) {
+    uint64_t total = 0, deletes = 0, sum = 0, i, k;
+    int64_t *tree = calloc(RANK_DOMAIN, sizeof(int64_t));
+    RankLogEntry *entries;
+    uint64_t *ranks;
+    int64_t rank;
+    long v;
+
+    for (k = 0; k <= bench_args.nthreads; k++)
+        total += rank_log_sizes[k];
+    entries = malloc(total * sizeof(RankLogEntry));
+    ranks = malloc(total * sizeof(uint64_t));
+    for (k = 0, i = 0; k <= bench_args.nthreads; k++) {
+        memcpy(&entries[i], rank_logs[k], rank_log_sizes[k] * sizeof(RankLogEntry));
+        i += rank_log_sizes[k];
+    }
+    qsort(entries, total, sizeof(RankLogEntry), compareEntries);
+
+    for (i = 0; i < total; i++) {
+        uint64_t val = entries[i].val & ~RANK_DELETE_OP;
+
+        if (entries[i].val & RANK_DELETE_OP) {
+            rank = 0;
+            for (v = val - 1; v > 0; v -= v & -v)
+                rank += tree[v];
+            ranks[deletes++] = (rank > 0) ? rank : 0;
+            sum += ranks[deletes - 1];
+            for (v = val; v < RANK_DOMAIN; v += v & -v)
+                tree[v]--;
+        } else {
+            for (v = val; v < RANK_DOMAIN; v += v & -v)
+                tree[v]++;
+        }
+    }
+    qsort(ranks, deletes, sizeof(uint64_t), compareRanks);
+    if (deletes > 0)
+        fprintf(stderr, "rank_error_avg: %.2f\trank_error_p50: %lu\trank_error_p99: %lu\trank_error_max: %lu\n",
+                (double)sum / deletes, ranks[(deletes - 1) / 2], ranks[((deletes - 1) * 99) / 100], ranks[deletes - 1]);
+    free(entries);
+    free(ranks);
+    free(tree);
+}
+
+int main(int argc, char *argv[]) {
+    PBCombMultiQueueThreadState th_state;
+    uint64_t prefill;
+    HeapElement val;
+    int i;
+
+    synchParseArguments(&bench_args, argc, argv);
+    d0 = synchGetTimeMillis();
+    object_struct = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombMultiQueueStruct));
+    PBCombMultiQueueInit(object_struct, bench_args.nthreads, bench_args.lanes * bench_args.nthreads, bench_args.choices);
+
+    // the log of the last pseudo-thread keeps the elements inserted before the experiment
+    prefill = object_struct->nheaps * (INITIAL_HEAP_SIZE / 2);
+    rank_logs = malloc((bench_args.nthreads + 1) * sizeof(RankLogEntry *));
+    rank_log_sizes = calloc(bench_args.nthreads + 1, sizeof(uint64_t));
+    for (i = 0; i < bench_args.nthreads; i++)
+        rank_logs[i] = malloc(2 * bench_args.runs * sizeof(RankLogEntry));
+    rank_logs[bench_args.nthreads] = malloc(prefill * sizeof(RankLogEntry));
+
+    PBCombMultiQueueThreadStateInit(object_struct, &th_state, 0);
+    synchFastRandomSetSeed(bench_args.nthreads + 1);
+    for (i = 0; i < prefill; i++) {
+        val = synchFastRandomRange32(1, RANK_DOMAIN - 2);
+        if (PBCombMultiQueueInsert(object_struct, &th_state, val, 0) == HEAP_INSERT_SUCCESS)
+            logOperation(bench_args.nthreads, val);
+    }
+
+    synchBarrierSet(&bar, bench_args.nthreads);
+    synchStartThreadsN(bench_args.nthreads, Execute, bench_args.fibers_per_thread);
+    synchJoinThreadsN(bench_args.nthreads - 1);
+    d2 = synchGetTimeMillis();
+
+    printf("time: %d (ms)\tthroughput: %.2f (millions ops/sec)\t", (int) (d2 - d1), 2 * bench_args.runs * bench_args.nthreads/(1000.0*(d2 - d1)));
+    synchPrintStats(bench_args.nthreads, bench_args.total_runs);
+    fprintf(stderr, "time_to_ready: %d (ms)\n", (int) (d1 - d0));
+    printRankErrors();
+
+#ifdef DEBUG
+    long counter = 0;
+
+    for (i = 0; i < object_struct->nheaps; i++)
+        counter += object_struct->heaps[i].heap.counter;
+    fprintf(stderr, "DEBUG: heaps: %u -- choices: %u\n", object_struct->nheaps, object_struct->choices);
+    fprintf(stderr, "DEBUG: object state: counter: %ld\n", counter - prefill);
+#endif
+
+    return 0;
+}
@@ -15,7 +15,8 @@
 #include <bench_args.h>
 
 PBCombQueueStruct *queue_object CACHE_ALIGN;
-int64_t d1 CACHE_ALIGN, d2;
+PBCombQueueThreadState **th_states;
+int64_t d0, d1 CACHE_ALIGN, d2;
 SynchBarrier bar CACHE_ALIGN;
 SynchBenchArgs bench_args CACHE_ALIGN;
 
@@ -28,19 +29,26 @@ inline static void *Execute(void* Arg) {
     synchFastRandomSetSeed(id + 1);
     th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombQueueThreadState));
     PBCombQueueThreadStateInit(queue_object, th_state, (int)id);
+    th_states[id] = th_state;
 
     synchBarrierWait(&bar);
     if (id == 0)
         d1 = synchGetTimeMillis();
 
     for (i = 0; i < bench_args.runs; i++) {
-        // perform an enqueue operation
-        PBCombQueueApplyEnqueue(queue_object, th_state, (ArgVal) i, id);
+        // perform an enqueue operation (a dequeue for consumer threads)
+        if (bench_args.producers == 0 || id < bench_args.producers)
+            PBCombQueueApplyEnqueue(queue_object, th_state, (ArgVal) i, id);
+        else
+            PBCombQueueApplyDequeue(queue_object, th_state, id);
         rnum = synchFastRandomRange(1, bench_args.max_work);
         for (j = 0; j < rnum; j++)
             ; 
-        // perform a dequeue operation
-        PBCombQueueApplyDequeue(queue_object, th_state, id);
+        // perform a dequeue operation (an enqueue for producer threads)
+        if (bench_args.producers == 0 || id >= bench_args.producers)
+            PBCombQueueApplyDequeue(queue_object, th_state, id);
+        else
+            PBCombQueueApplyEnqueue(queue_object, th_state, (ArgVal) i, id);
         rnum = synchFastRandomRange(1, bench_args.max_work);
         for (j = 0; j < rnum; j++)
             ;
@@ -50,7 +58,12 @@ inline static void *Execute(void* Arg) {
 }
 
 int main(int argc, char *argv[]) {
+    uint64_t footprint = 0, max_footprint = 0, pool_footprint;
+    int i;
+
     synchParseArguments(&bench_args, argc, argv);
+    d0 = synchGetTimeMillis();
+    th_states = synchGetAlignedMemory(CACHE_LINE_SIZE, bench_args.nthreads * sizeof(PBCombQueueThreadState *));
     queue_object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombQueueStruct));
     PBCombQueueInit(queue_object, bench_args.nthreads);   
     
@@ -61,6 +74,16 @@ int main(int argc, char *argv[]) {
 
     printf("time: %d (ms)\tthroughput: %.2f (millions ops/sec)\t", (int) (d2 - d1), 2 * bench_args.runs * bench_args.nthreads/(1000.0*(d2 - d1)));
     synchPrintStats(bench_args.nthreads, bench_args.total_runs);
+    fprintf(stderr, "time_to_ready: %d (ms)\n", (int) (d1 - d0));
+    // the high-water marks of the node pools, which stay bounded even with dedicated producers and consumers,
+    // since the dequeued nodes are returned to the pools that allocated them
+    for (i = 0; i < bench_args.nthreads; i++) {
+        pool_footprint = synchPoolFootprint(&th_states[i]->pool_node);
+        footprint += pool_footprint;
+        if (pool_footprint > max_footprint)
+            max_footprint = pool_footprint;
+    }
+    fprintf(stderr, "node_footprint: %lu (bytes)\tmax_pool_footprint: %lu (bytes)\n", footprint, max_footprint);
 #ifdef DEBUG
     fprintf(stderr, "DEBUG: Enqueue: Object state: %d\n", queue_object->enqueue_struct.counter);
     fprintf(stderr, "DEBUG: Enqueue: rounds: %d\n", queue_object->enqueue_struct.rounds);
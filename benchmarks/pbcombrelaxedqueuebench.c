@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdint.h>
+#include <sched.h>
+
+#include <config.h>
+#include <primitives.h>
+#include <fastrand.h>
+#include <pool.h>
+#include <threadtools.h>
+#include <pbcombrelaxedqueue.h>
+#include <barrier.h>
+#include <bench_args.h>
+
+PBCombRelaxedQueueStruct *queue_object CACHE_ALIGN;
+int64_t d0, d1 CACHE_ALIGN, d2;
+SynchBarrier bar CACHE_ALIGN;
+SynchBenchArgs bench_args CACHE_ALIGN;
+
+inline static void *Execute(void* Arg) {
+    PBCombRelaxedQueueThreadState *th_state;
+    long i, rnum;
+    volatile int j;
+    long id = (long) Arg;
+
+    synchFastRandomSetSeed(id + 1);
+    th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombRelaxedQueueThreadState));
+    PBCombRelaxedQueueThreadStateInit(queue_object, th_state, (int)id);
+
+    synchBarrierWait(&bar);
+    if (id == 0)
+        d1 = synchGetTimeMillis();
+
+    for (i = 0; i < bench_args.runs; i++) {
+        // perform an enqueue operation
+        PBCombRelaxedQueueApplyEnqueue(queue_object, th_state, (ArgVal) i, id);
+        rnum = synchFastRandomRange(1, bench_args.max_work);
+        for (j = 0; j < rnum; j++)
+            ; 
+        // perform a dequeue operation
+        PBCombRelaxedQueueApplyDequeue(queue_object, th_state, id);
+        rnum = synchFastRandomRange(1, bench_args.max_work);
+        for (j = 0; j < rnum; j++)
+            ;
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    synchParseArguments(&bench_args, argc, argv);
+    d0 = synchGetTimeMillis();
+    queue_object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombRelaxedQueueStruct));
+    PBCombRelaxedQueueInit(queue_object, bench_args.nthreads, bench_args.lanes, bench_args.choices,
+                           PBCOMB_RELAXED_QUEUE_AFFINITY, bench_args.sequenced);
+
+    synchBarrierSet(&bar, bench_args.nthreads);
+    synchStartThreadsN(bench_args.nthreads, Execute, bench_args.fibers_per_thread);
+    synchJoinThreadsN(bench_args.nthreads - 1);
+    d2 = synchGetTimeMillis();
+
+    printf("time: %d (ms)\tthroughput: %.2f (millions ops/sec)\t", (int) (d2 - d1), 2 * bench_args.runs * bench_args.nthreads/(1000.0*(d2 - d1)));
+    synchPrintStats(bench_args.nthreads, bench_args.total_runs);
+    fprintf(stderr, "time_to_ready: %d (ms)\n", (int) (d1 - d0));
+#ifdef DEBUG
+    uint32_t k;
+    long enqueues = 0, dequeues = 0, counter = 0;
+
+    for (k = 0; k < queue_object->nlanes; k++) {
+        PBCombQueueStruct *lane = &queue_object->lanes[k].queue;
+        Node *first = *((Node **)lane->dequeue_struct.pstate->last_state->state);
+
+        enqueues += lane->enqueue_struct.counter;
+        dequeues += lane->dequeue_struct.counter;
+        while (first->next != NULL) {
+            first = (Node *)first->next;
+            counter++;
+        }
+    }
+    fprintf(stderr, "DEBUG: lanes: %u -- choices: %u -- sequenced: %d\n", queue_object->nlanes, queue_object->choices, queue_object->sequenced);
+    fprintf(stderr, "DEBUG: Enqueue: Object state: %ld\n", enqueues);
+    fprintf(stderr, "DEBUG: Dequeue: Object state: %ld\n", dequeues);
+    fprintf(stderr, "DEBUG: %ld nodes were left in the queue\n", counter);
+#endif
+
+    return 0;
+}
@@ -4,16 +4,20 @@
 #include <stdint.h>
 
 #include <pwfcomb.h>
+#include <replica.h>
 #include <barrier.h>
 #include <bench_args.h>
 #include <fam.h>
 
 PWFCombStruct *pwfcomb_object CACHE_ALIGN;
-int64_t d1 CACHE_ALIGN, d2;
+SynchReplicaStruct *replica;
+int64_t d0, d1 CACHE_ALIGN, d2;
 SynchBarrier bar CACHE_ALIGN;
 SynchBenchArgs bench_args CACHE_ALIGN;
 int MAX_BACK CACHE_ALIGN;
 
+PWFCOMB_DEFINE_OBJECT(fetchAndMultiply, ObjectState, fetchAndMultiply)
+
 inline static void *Execute(void* Arg) {
     PWFCombThreadState th_state;
     long i, rnum;
@@ -27,7 +31,7 @@ inline static void *Execute(void* Arg) {
         d1 = synchGetTimeMillis();
 
     for (i = 0; i < bench_args.runs; i++) {
-        PWFCombApplyOp(pwfcomb_object, &th_state, fetchAndMultiply, (Object) (id + 1), id);
+        fetchAndMultiplyApplyOp(pwfcomb_object, &th_state, (Object) (id + 1), id);
         rnum = synchFastRandomRange(1, bench_args.max_work);
         for (j = 0; j < rnum; j++)
             ;
@@ -37,9 +41,19 @@ inline static void *Execute(void* Arg) {
 }
 
 int main(int argc, char *argv[]) {
+    ObjectState initial_state;
+
     synchParseArguments(&bench_args, argc, argv);
+    d0 = synchGetTimeMillis();
+    initial_state.state_f = 1.0;
     pwfcomb_object = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PWFCombStruct));
-    PWFCombInit(pwfcomb_object, bench_args.nthreads, bench_args.backoff_high);
+    PWFCombInit(pwfcomb_object, bench_args.nthreads, bench_args.numa_nodes, &initial_state, sizeof(ObjectState), bench_args.backoff_high);
+    if (bench_args.replica) {
+        replica = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(SynchReplicaStruct));
+        if (synchReplicaInit(replica, NULL, sizeof(ObjectState), 0) != 0 || synchReplicaStart(replica) != 0)
+            exit(EXIT_FAILURE);
+        PWFCombSetReplica(pwfcomb_object, replica);
+    }
     synchBarrierSet(&bar, bench_args.nthreads);
     synchStartThreadsN(bench_args.nthreads, Execute, bench_args.fibers_per_thread);
     synchJoinThreadsN(bench_args.nthreads - 1);
@@ -47,13 +61,31 @@ int main(int argc, char *argv[]) {
 
     printf("time: %d (ms)\tthroughput: %.2f (millions ops/sec)\t", (int) (d2 - d1), bench_args.runs * bench_args.nthreads/(1000.0*(d2 - d1)));
     synchPrintStats(bench_args.nthreads, bench_args.total_runs);
+    fprintf(stderr, "time_to_ready: %d (ms)\n", (int) (d1 - d0));
+    if (bench_args.replica) {
+        fprintf(stderr, "replica_lag: %lu (rounds)\treplica_max_lag: %lu (rounds)\treplica_mirror_writes: %lu\n",
+                synchReplicaLag(replica), replica->max_lag, replica->mirror_writes);
+        synchReplicaStop(replica);
+    }
 
 #ifdef DEBUG
     PWFCombStateRec *l = (PWFCombStateRec *)pwfcomb_object->mem_state[((pointer_t*)&pwfcomb_object->pstate->S)->struct_data.index];
-    fprintf(stderr, "DEBUG: Object float state: %f\n", l->st.state_f);
+    fprintf(stderr, "DEBUG: Object float state: %f\n", ((ObjectState *)l->state)->state_f);
     fprintf(stderr, "DEBUG: Object state: %d\n", l->counter);
     fprintf(stderr, "DEBUG: rounds: %d\n", l->rounds);
     fprintf(stderr, "DEBUG: Average helping: %f\n", (float)l->counter/l->rounds);
+    uint64_t wasted_copies, wasted_flushes;
+    PWFCombGetWasteStats(pwfcomb_object, &wasted_copies, &wasted_flushes);
+    fprintf(stderr, "DEBUG: wasted copies: %lu\twasted flushes: %lu\n", wasted_copies, wasted_flushes);
+    if (bench_args.replica) {
+        uint64_t mirror_round;
+        ObjectState *mirror_state = synchReplicaMirrorData(replica->mirror, &mirror_round);
+
+        // after stopping the shipper, the mirror should be equal to the final state of the object
+        fprintf(stderr, "DEBUG: replica: round: %lu (expected %lu) -- state: %s\n", mirror_round,
+                (uint64_t)((pointer_t *)&pwfcomb_object->pstate->S)->struct_data.seq,
+                (mirror_state->state == ((ObjectState *)l->state)->state) ? "equal" : "DIFFERENT");
+    }
     fprintf(stderr, "\n");
 #endif
 
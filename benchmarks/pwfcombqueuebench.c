@@ -14,7 +14,8 @@
 #include <bench_args.h>
 
 PWFCombQueueStruct *queue;
-int64_t d1, d2;
+PWFCombQueueThreadState **th_states;
+int64_t d0, d1, d2;
 SynchBarrier bar CACHE_ALIGN;
 SynchBenchArgs bench_args CACHE_ALIGN;
 
@@ -28,6 +29,7 @@ static void *Execute(void* Arg) {
     synchFastRandomSetSeed(id + 1);
     th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PWFCombQueueThreadState));
     PWFCombQueueThreadStateInit(queue, th_state, id);
+    th_states[id] = th_state;
 
     synchBarrierWait(&bar);
     if (id == 0)
@@ -47,9 +49,14 @@ static void *Execute(void* Arg) {
 }
 
 int main(int argc, char *argv[]) {
+    uint64_t footprint = 0;
+    int i;
+
     synchParseArguments(&bench_args, argc, argv);
+    d0 = synchGetTimeMillis();
+    th_states = synchGetAlignedMemory(CACHE_LINE_SIZE, bench_args.nthreads * sizeof(PWFCombQueueThreadState *));
     queue = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PWFCombQueueStruct));
-    PWFCombQueueInit(queue, bench_args.nthreads, bench_args.backoff_high);
+    PWFCombQueueInit(queue, bench_args.nthreads, bench_args.numa_nodes, bench_args.backoff_high);
 
     synchBarrierSet(&bar, bench_args.nthreads);
     synchStartThreadsN(bench_args.nthreads, Execute, bench_args.fibers_per_thread);
@@ -58,6 +65,11 @@ int main(int argc, char *argv[]) {
 
     printf("time: %d (ms)\tthroughput: %.2f (millions ops/sec)\t", (int) (d2 - d1), 2 * bench_args.runs * bench_args.nthreads/(1000.0*(d2 - d1)));
     synchPrintStats(bench_args.nthreads, bench_args.total_runs);
+    fprintf(stderr, "time_to_ready: %d (ms)\n", (int) (d1 - d0));
+    // the persistent memory occupied by the nodes of the queue, which stays flat in steady state since the nodes are recycled
+    for (i = 0; i < bench_args.nthreads; i++)
+        footprint += synchPoolFootprint(&th_states[i]->pool_node);
+    fprintf(stderr, "node_footprint: %lu (bytes)\n", footprint);
 
 #ifdef DEBUG
     Node *first = queue->EState[queue->Epstate->S.struct_data.index]->first;
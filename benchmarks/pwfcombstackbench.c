@@ -13,7 +13,7 @@
 #include <bench_args.h>
 
 PWFCombStackStruct *stack CACHE_ALIGN;
-int64_t d1 CACHE_ALIGN, d2;
+int64_t d0, d1 CACHE_ALIGN, d2;
 SynchBarrier bar CACHE_ALIGN;
 SynchBenchArgs bench_args CACHE_ALIGN;
 
@@ -48,8 +48,9 @@ inline static void *Execute(void* Arg) {
 
 int main(int argc, char *argv[]) {
     synchParseArguments(&bench_args, argc, argv);
+    d0 = synchGetTimeMillis();
     stack = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PWFCombStackStruct));
-    PWFCombStackInit(stack, bench_args.nthreads, bench_args.backoff_high);
+    PWFCombStackInit(stack, bench_args.nthreads, bench_args.numa_nodes, bench_args.backoff_high);
     synchBarrierSet(&bar, bench_args.nthreads);
     synchStartThreadsN(bench_args.nthreads, Execute, bench_args.fibers_per_thread);
     synchJoinThreadsN(bench_args.nthreads - 1);
@@ -57,6 +58,7 @@ int main(int argc, char *argv[]) {
 
     printf("time: %d (ms)\tthroughput: %.2f (millions ops/sec)\t", (int) (d2 - d1), 2 * bench_args.runs * bench_args.nthreads/(1000.0*(d2 - d1)));
     synchPrintStats(bench_args.nthreads, bench_args.total_runs);
+    fprintf(stderr, "time_to_ready: %d (ms)\n", (int) (d1 - d0));
 
 #ifdef DEBUG
     fprintf(stderr, "DEBUG: Object state: %lld\n", (long long int)stack->mem_state[stack->pstate->S.struct_data.index]->counter);
@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <config.h>
+#include <primitives.h>
+#include <fastrand.h>
+#include <threadtools.h>
+#include <barrier.h>
+#include <bench_args.h>
+#include <shadow.h>
+#include <pbcomb.h>
+#include <pbcombqueue.h>
+#include <pbcombstack.h>
+#include <pbcombheap.h>
+
+// This benchmark measures the time that a persistent object needs for becoming usable after a crash.
+// For each object and for each size of its state (1K, 10K, 100K, ... elements, up to the number of runs),
+// a child process fills the object, records the persisted image of the object (see shadow.h) and is killed.
+// Then, the parent process reopens the image (open), rebuilds a new instance of the object from the recovered state
+// and nodes (recover) and applies the first operation to it through the API of the object (first_op),
+// `repetitions` times, and reports the 50th and 99th percentiles of the time spent in each phase.
+//
+// The reported times are not the restart time of a real system, due to two limitations of the harness:
+// - The fill runs with the shadow image disabled, and the image is recorded afterwards by writing back everything
+//   that is reachable from the persisted state of the object (see recordObject). Thus, the image cannot expose
+//   an element that the object failed to persist, i.e. this benchmark does not check durability.
+// - The open phase mostly measures the harness itself, i.e. the sorting of the log of persist events
+//   for building the view of the image (see synchShadowBuildView), rather than the mapping of a persistent heap.
+
+/// The smallest size (in elements) of the benchmarked objects.
+#define RECOVERYBENCH_MIN_SIZE   1000
+
+enum { PBCOMB_OBJECT, PBQUEUE_OBJECT, PBSTACK_OBJECT, PBHEAP_OBJECT, NUMBER_OF_OBJECTS };
+enum { OPEN_PHASE, RECOVER_PHASE, FIRST_OP_PHASE, TOTAL_PHASE, NUMBER_OF_PHASES };
+
+static const char *object_names[NUMBER_OF_OBJECTS] = {"pbcomb", "pbqueue", "pbstack", "pbheap"};
+static const char *phase_names[NUMBER_OF_PHASES] = {"open", "recover", "first_op", "total"};
+
+PBCombStruct *pbcomb_object CACHE_ALIGN;
+PBCombQueueStruct *queue_object;
+PBCombStackStruct *stack_object;
+PBCombHeapStruct *heap_object;
+int object_type;
+uint64_t fill_size;
+SynchBarrier bar CACHE_ALIGN;
+SynchBenchArgs bench_args CACHE_ALIGN;
+
+// The state of the PBcomb object is an array of `fill_size` words; each operation increments a single word.
+inline static RetVal incrementWord(void *state, ArgVal arg, int pid) {
+    uint64_t *words = state;
+
+    return ++words[arg % fill_size];
+}
+
+inline static void *Execute(void* Arg) {
+    long id = (long) Arg;
+    uint64_t i, count = fill_size / bench_args.nthreads;
+
+    if (id == 0)
+        count += fill_size % bench_args.nthreads;
+    synchFastRandomSetSeed(id + 1);
+    if (object_type == PBCOMB_OBJECT) {
+        PBCombThreadState *th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombThreadState));
+
+        PBCombThreadStateInit(pbcomb_object, th_state, (int)id);
+        synchBarrierWait(&bar);
+        PBCombApplyOp(pbcomb_object, th_state, incrementWord, (ArgVal)id, id);
+    } else if (object_type == PBQUEUE_OBJECT) {
+        PBCombQueueThreadState *th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombQueueThreadState));
+
+        PBCombQueueThreadStateInit(queue_object, th_state, (int)id);
+        synchBarrierWait(&bar);
+        for (i = 0; i < count; i++)
+            PBCombQueueApplyEnqueue(queue_object, th_state, (ArgVal)((id << 32) | i), id);
+    } else if (object_type == PBSTACK_OBJECT) {
+        PBCombStackThreadState *th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombStackThreadState));
+
+        PBCombStackThreadStateInit(stack_object, th_state, (int)id);
+        synchBarrierWait(&bar);
+        for (i = 0; i < count; i++)
+            PBCombStackPush(stack_object, th_state, (ArgVal)((id << 32) | i), id);
+    } else {
+        PBCombHeapThreadState *th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombHeapThreadState));
+
+        PBCombHeapThreadStateInit(heap_object, th_state, (int)id);
+        synchBarrierWait(&bar);
+        for (i = 0; i < count; i++)
+            PBCombHeapInsert(heap_object, th_state, synchFastRandomRange(1, 1000000000), id);
+    }
+
+    return NULL;
+}
+
+static void createObject(void) {
+    if (object_type == PBCOMB_OBJECT) {
+        uint64_t *initial_state = malloc(fill_size * sizeof(uint64_t));
+        uint64_t i;
+
+        for (i = 0; i < fill_size; i++)
+            initial_state[i] = i;
+        pbcomb_object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombStruct));
+        PBCombStructInit(pbcomb_object, bench_args.nthreads, initial_state, fill_size * sizeof(uint64_t));
+        free(initial_state);
+    } else if (object_type == PBQUEUE_OBJECT) {
+        queue_object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombQueueStruct));
+        PBCombQueueInit(queue_object, bench_args.nthreads);
+    } else if (object_type == PBSTACK_OBJECT) {
+        stack_object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombStackStruct));
+        PBCombStackInit(stack_object, bench_args.nthreads);
+    } else {
+        heap_object = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombHeapStruct));
+        PBCombHeapInit(heap_object, bench_args.nthreads);
+    }
+}
+
+// Records the latest persisted state record of a PBcomb instance and publishes it as the `root`-th root.
+static void recordPBCombState(PBCombStruct *l, int root) {
+    synchFlushPersistentMemory((void *)l->pstate, sizeof(PBCombPersistentState));
+    synchFlushPersistentMemory((void *)l->pstate->last_state, sizeof(PBCombStateRec) + l->state_size);
+    synchShadowSetRoot(root, (void *)l->pstate);
+}
+
+// Returns the current state of a PBcomb instance, i.e. the state of its latest persisted state record.
+static void *currentPBCombState(PBCombStruct *l) {
+    return (void *)l->pstate->last_state->state;
+}
+
+// The operations of the filling phase are persisted by the objects themselves, but they are not recorded in the
+// shadow image in order to keep the log proportional to the size of the object. Thus, the recorded image of a
+// quiescent object consists of the lines that its operations have already persisted, which are written back once more.
+static void recordObject(void) {
+    volatile Node *node;
+
+    synch_persist_shadow = true;
+    if (object_type == PBCOMB_OBJECT) {
+        recordPBCombState(pbcomb_object, 0);
+    } else if (object_type == PBQUEUE_OBJECT) {
+        recordPBCombState(&queue_object->enqueue_struct, 0);
+        recordPBCombState(&queue_object->dequeue_struct, 1);
+        for (node = *(Node **)currentPBCombState(&queue_object->dequeue_struct); node != NULL; node = node->next)
+            synchFlushPersistentMemory((void *)node, sizeof(Node));
+    } else if (object_type == PBSTACK_OBJECT) {
+        recordPBCombState(&stack_object->object_struct, 0);
+        for (node = *(Node **)currentPBCombState(&stack_object->object_struct); node != NULL; node = node->next)
+            synchFlushPersistentMemory((void *)node, sizeof(Node));
+    } else {
+        recordPBCombState(&heap_object->heap, 0);
+    }
+    synchDrainPersistentMemory();
+}
+
+// Fills the object in a child process, which records the persisted image of the object and then is killed.
+static void runChild(void) {
+    pid_t pid;
+    int status;
+
+    synchShadowReset(0);
+    fflush(stdout);
+    pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    } else if (pid == 0) {
+        synch_persist_shadow = false;
+        createObject();
+        synchBarrierSet(&bar, bench_args.nthreads);
+        synchStartThreadsN(bench_args.nthreads, Execute, bench_args.fibers_per_thread);
+        synchJoinThreadsN(bench_args.nthreads - 1);
+        recordObject();
+        kill(getpid(), SIGKILL);
+        _exit(EXIT_FAILURE);
+    }
+    if (waitpid(pid, &status, 0) == -1) {
+        perror("waitpid");
+        exit(EXIT_FAILURE);
+    }
+    if (!(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL)) {
+        fprintf(stderr, "ERROR: the child process failed unexpectedly\n");
+        exit(EXIT_FAILURE);
+    }
+    if (synchShadowOverflow()) {
+        fprintf(stderr, "ERROR: the persisted image of %s does not fit in the log\n", object_names[object_type]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void recoveryFailed(const char *msg) {
+    fprintf(stderr, "ERROR: %s: size %lu: %s\n", object_names[object_type], fill_size, msg);
+    exit(EXIT_FAILURE);
+}
+
+// Reads the latest persisted state of the PBcomb instance that is published as the `root`-th root.
+static void recoverPBCombState(SynchShadowView *view, int root, void *state, size_t state_size) {
+    PBCombPersistentState ps;
+
+    if (!synchShadowRead(view, synchShadowGetRoot(root), &ps, sizeof(PBCombPersistentState)) ||
+        !synchShadowRead(view, ((char *)ps.last_state) + offsetof(PBCombStateRec, flex), state, state_size))
+        recoveryFailed("the state is not persisted");
+}
+
+// Copies the persisted list of nodes that starts at `head` and ends at `tail` (or at NULL) to nodes allocated
+// from `pool`, persists the copies, stores the first and the last of them to `first` and `last`,
+// and returns the number of copied nodes.
+static uint64_t recoverList(SynchShadowView *view, Node *head, Node *tail, SynchPoolStruct *pool, Node **first,
+                            Node **last, uint64_t max_nodes) {
+    uint64_t n = 0;
+    Node *cur = head, *node, *prev = NULL;
+
+    *first = NULL;
+    while (cur != NULL) {
+        if (n == max_nodes)
+            recoveryFailed("the list of nodes is longer than expected");
+        node = synchAllocObj(pool);
+        if (!synchShadowRead(view, cur, node, sizeof(Node)))
+            recoveryFailed("a node is not persisted");
+        if (prev != NULL)
+            prev->next = node;
+        else
+            *first = node;
+        prev = node;
+        n++;
+        if (cur == tail)
+            break;
+        cur = (Node *)node->next;
+    }
+    if (prev != NULL)
+        prev->next = NULL;
+    *last = prev;
+    for (node = *first; node != NULL; node = (Node *)node->next)
+        synchFlushPersistentMemory(node, sizeof(Node));
+    synchDrainPersistentMemory();
+
+    return n;
+}
+
+// Replaces the current state of a freshly initialized PBcomb instance with `state` and persists it.
+static void installPBCombState(PBCombStruct *l, void *state) {
+    memcpy(currentPBCombState(l), state, l->state_size);
+    synchPersistRange(currentPBCombState(l), l->state_size);
+}
+
+// Releases the copies of the state of a rebuilt PBcomb instance (see PBCombStructInit and PBCombThreadStateInit),
+// i.e. its only allocations whose size depends on the size of the state; the rest of them are leaked.
+static void releasePBCombStates(PBCombStruct *l, PBCombThreadState *th_state, void *initial_record) {
+    size_t record_size = sizeof(PBCombStateRec) + l->state_size + l->nthreads * (sizeof(RetVal) + sizeof(bool));
+    size_t stride = (record_size + CACHE_LINE_SIZE - 1) & ~((size_t)CACHE_LINE_SIZE - 1);
+
+    synchFreePersistentMemory(initial_record, record_size);
+    synchFreePersistentMemory(th_state->pool[0], PBCOMB_POOL_SIZE * stride);
+}
+
+static double elapsedMicros(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000000.0 + (end->tv_nsec - start->tv_nsec) / 1000.0;
+}
+
+// Reopens the persisted image, rebuilds the object from it (i.e. initializes a new instance for a single thread,
+// installs the recovered state and nodes and persists them) and applies its first operation through the API,
+// i.e. an increment of a word of the state, a dequeue, a pop, or a deleteMin, respectively.
+static void recoverObject(double *phase_us) {
+    struct timespec t0, t1, t2, t3;
+    SynchShadowView view;
+    uint64_t *words = NULL, n = 0;
+    Node *first = NULL, *last = NULL, *head, *tail;
+    HeapState *heap = NULL;
+    PBCombStruct *pbcomb = NULL;
+    PBCombThreadState *pbcomb_th_state = NULL;
+    PBCombQueueStruct *queue = NULL;
+    PBCombQueueThreadState *queue_th_state = NULL;
+    PBCombStackStruct *stack = NULL;
+    PBCombStackThreadState *stack_th_state = NULL;
+    PBCombHeapStruct *pbheap = NULL;
+    PBCombHeapThreadState *heap_th_state = NULL;
+    void *initial_record = NULL;
+    RetVal result, expected;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (synchShadowBuildView(&view) != 0) {
+        perror("synchShadowBuildView");
+        exit(EXIT_FAILURE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (object_type == PBCOMB_OBJECT) {
+        words = malloc(fill_size * sizeof(uint64_t));
+        recoverPBCombState(&view, 0, words, fill_size * sizeof(uint64_t));
+        pbcomb = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombStruct));
+        pbcomb_th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombThreadState));
+        PBCombStructInit(pbcomb, 1, words, fill_size * sizeof(uint64_t));
+        PBCombThreadStateInit(pbcomb, pbcomb_th_state, 0);
+        initial_record = (void *)pbcomb->pstate->last_state;
+        n = fill_size;
+        expected = words[0] + 1;
+    } else if (object_type == PBQUEUE_OBJECT) {
+        recoverPBCombState(&view, 0, &tail, sizeof(Node *));
+        recoverPBCombState(&view, 1, &head, sizeof(Node *));
+        queue = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombQueueStruct));
+        queue_th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombQueueThreadState));
+        PBCombQueueInit(queue, 1);
+        PBCombQueueThreadStateInit(queue, queue_th_state, 0);
+        // the first node is a dummy node
+        n = recoverList(&view, head, tail, &queue_th_state->pool_node, &first, &last, fill_size + 1) - 1;
+        installPBCombState(&queue->enqueue_struct, &last);
+        installPBCombState(&queue->dequeue_struct, &first);
+        queue->enqueue_struct.aux = last;
+        expected = (n > 0) ? first->next->val : -1;
+    } else if (object_type == PBSTACK_OBJECT) {
+        recoverPBCombState(&view, 0, &head, sizeof(Node *));
+        stack = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombStackStruct));
+        stack_th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombStackThreadState));
+        PBCombStackInit(stack, 1);
+        PBCombStackThreadStateInit(stack, stack_th_state, 0);
+        n = recoverList(&view, head, NULL, &stack->pool_node, &first, &last, fill_size + 1);
+        installPBCombState(&stack->object_struct, &first);
+        expected = (n > 0) ? first->val : -1;
+    } else {
+        heap = malloc(sizeof(HeapState));
+        recoverPBCombState(&view, 0, heap, sizeof(HeapState));
+        pbheap = synchGetAlignedMemory(S_CACHE_LINE_SIZE, sizeof(PBCombHeapStruct));
+        heap_th_state = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(PBCombHeapThreadState));
+        PBCombHeapInit(pbheap, 1);
+        PBCombHeapThreadStateInit(pbheap, heap_th_state, 0);
+        installPBCombState(&pbheap->heap, heap);
+        n = _SIZE_OF_HEAP_LEVEL(heap->last_used_level) - 1 + heap->last_used_level_pos;
+        expected = (n > 0) ? heap->bulk[0] : EMPTY_HEAP;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+
+    if (object_type == PBCOMB_OBJECT)
+        result = PBCombApplyOp(pbcomb, pbcomb_th_state, incrementWord, 0, 0);
+    else if (object_type == PBQUEUE_OBJECT)
+        result = PBCombQueueApplyDequeue(queue, queue_th_state, 0);
+    else if (object_type == PBSTACK_OBJECT)
+        result = PBCombStackPop(stack, stack_th_state, 0);
+    else
+        result = PBCombHeapDeleteMin(pbheap, heap_th_state, 0);
+    clock_gettime(CLOCK_MONOTONIC, &t3);
+
+    phase_us[OPEN_PHASE] = elapsedMicros(&t0, &t1);
+    phase_us[RECOVER_PHASE] = elapsedMicros(&t1, &t2);
+    phase_us[FIRST_OP_PHASE] = elapsedMicros(&t2, &t3);
+    phase_us[TOTAL_PHASE] = elapsedMicros(&t0, &t3);
+
+    if (n != fill_size)
+        recoveryFailed("the recovered object does not contain all the elements");
+    if (result != expected)
+        recoveryFailed("the first operation of the rebuilt object returned an unexpected value");
+    synchShadowFreeView(&view);
+    // the rebuilt objects are not used any more, thus their large allocations are released
+    if (object_type == PBCOMB_OBJECT) {
+        releasePBCombStates(pbcomb, pbcomb_th_state, initial_record);
+        synchFreeMemory(pbcomb_th_state, sizeof(PBCombThreadState));
+        synchFreeMemory(pbcomb, sizeof(PBCombStruct));
+    } else if (object_type == PBQUEUE_OBJECT) {
+        synchDestroyPool(&queue_th_state->pool_node);
+        synchFreeMemory(queue_th_state, sizeof(PBCombQueueThreadState));
+        synchFreeMemory(queue, sizeof(PBCombQueueStruct));
+    } else if (object_type == PBSTACK_OBJECT) {
+        synchDestroyPool(&stack->pool_node);
+        synchFreeMemory(stack_th_state, sizeof(PBCombStackThreadState));
+        synchFreeMemory(stack, sizeof(PBCombStackStruct));
+    } else {
+        synchFreeMemory(heap_th_state, sizeof(PBCombHeapThreadState));
+        synchFreeMemory(pbheap, sizeof(PBCombHeapStruct));
+    }
+    free(words);
+    free(heap);
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    double d1 = *(const double *)a, d2 = *(const double *)b;
+
+    return (d1 > d2) - (d1 < d2);
+}
+
+static double percentile(double *samples, uint32_t n, uint32_t p) {
+    return samples[((uint64_t)(n - 1) * p) / 100];
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t max_size, events;
+    double *samples[NUMBER_OF_PHASES];
+    double phase_us[NUMBER_OF_PHASES];
+    uint32_t i, phase;
+
+    synchParseArguments(&bench_args, argc, argv);
+    if (bench_args.repetitions == 0)
+        bench_args.repetitions = 1;
+    max_size = (bench_args.total_runs < RECOVERYBENCH_MIN_SIZE) ? RECOVERYBENCH_MIN_SIZE : bench_args.total_runs;
+    // each element is recorded at most once, plus the lines of the state records
+    if (synchShadowInit(max_size + sizeof(HeapState) / SYNCH_SHADOW_LINE_SIZE + 64) != 0)
+        exit(EXIT_FAILURE);
+    // the persists of the objects that the parent process rebuilds are not recorded in the shadow image
+    synch_persist_shadow = false;
+    for (phase = 0; phase < NUMBER_OF_PHASES; phase++)
+        samples[phase] = malloc(bench_args.repetitions * sizeof(double));
+
+    for (object_type = 0; object_type < NUMBER_OF_OBJECTS; object_type++) {
+        for (fill_size = RECOVERYBENCH_MIN_SIZE; fill_size <= max_size; fill_size *= 10) {
+            if (object_type == PBHEAP_OBJECT && fill_size >= INITIAL_HEAP_SIZE) {
+                fprintf(stderr, "WARNING: %s: size %lu exceeds the capacity of the heap (see INITIAL_HEAP_LEVELS)\n",
+                        object_names[object_type], fill_size);
+                break;
+            }
+            runChild();
+            events = synchShadowEvents();
+            for (i = 0; i < bench_args.repetitions; i++) {
+                recoverObject(phase_us);
+                for (phase = 0; phase < NUMBER_OF_PHASES; phase++)
+                    samples[phase][i] = phase_us[phase];
+            }
+
+            printf("object: %s\tsize: %lu\trepetitions: %u\tpersist_events: %lu", object_names[object_type], fill_size,
+                   bench_args.repetitions, events);
+            for (phase = 0; phase < NUMBER_OF_PHASES; phase++) {
+                qsort(samples[phase], bench_args.repetitions, sizeof(double), compareDoubles);
+                printf("\t%s_p50: %.2f (us)\t%s_p99: %.2f (us)", phase_names[phase],
+                       percentile(samples[phase], bench_args.repetitions, 50), phase_names[phase],
+                       percentile(samples[phase], bench_args.repetitions, 99));
+            }
+            printf("\n");
+        }
+    }
+    synchShadowDestroy();
+
+    return 0;
+}
@@ -10,20 +10,35 @@
 #include "pbcomb.h"
 #include "threadtools.h"
 
-#ifdef NUMA_SUPPORT
+#ifdef SYNCH_NUMA_SUPPORT
 #   include <numa.h>
 #endif
 
-#define COMBINING_ROUNDS                 20
+// Returns the NUMA node of the core that the thread with id `pid` is pinned to (see synchThreadPin).
+static uint32_t nodeOfThread(uint32_t pid) {
+#ifdef SYNCH_NUMA_SUPPORT
+    int node = numa_node_of_cpu(synchPreferedCoreOfThread(pid % synchGetNCores()));
 
-#ifdef NUMA_SUPPORT
+    return (node > 0) ? node : 0;
+#else
+    return 0;
+#endif
+}
+
+#ifdef SYNCH_NUMA_SUPPORT
 int compare_numa(const void *A, const void *B) {
     static uint32_t ncores = 0;
     const uint32_t *n1 = A; 
     const uint32_t *n2 = B;
+    uint32_t node_n1 = nodeOfThread(*n1);
+    uint32_t node_n2 = nodeOfThread(*n2);
     
-    int32_t prefered_core_n1 = preferedCoreOfThread(*n1);
-    int32_t prefered_core_n2 = preferedCoreOfThread(*n2);
+    int32_t prefered_core_n1 = synchPreferedCoreOfThread(*n1 % synchGetNCores());
+    int32_t prefered_core_n2 = synchPreferedCoreOfThread(*n2 % synchGetNCores());
+
+    // the threads of the same NUMA node are grouped together, so that their requests form a single segment
+    if (node_n1 != node_n2)
+        return (node_n1 < node_n2) ? -1 : 1;
 
     if (ncores == 0)
         ncores = numa_num_configured_cpus();
@@ -38,12 +53,15 @@ int compare_numa(const void *A, const void *B) {
         }
     }
     
-    return prefered_core_n1 - prefered_core_n2;
+    if (prefered_core_n1 != prefered_core_n2)
+        return prefered_core_n1 - prefered_core_n2;
+    return (*n1 > *n2) - (*n1 < *n2);
 }
 #endif
 
 void PBCombStructInit(PBCombStruct *l, uint32_t nthreads, void *initial_state, uint32_t state_size) {
-    int i;
+    uint32_t *segment_node;
+    int i, n;
 
     l->lock = 0;
     l->lock_value = 0;
@@ -52,13 +70,6 @@ void PBCombStructInit(PBCombStruct *l, uint32_t nthreads, void *initial_state, u
     l->rounds = 0;
 #endif
     l->nthreads = nthreads;
-    l->request = synchGetAlignedMemory(CACHE_LINE_SIZE, nthreads * sizeof(PBCombRequest));
-
-    for (i = 0; i < nthreads; i++) {
-        l->request[i].arg = 0;
-        l->request[i].activate = 0;
-        l->request[i].valid = 0;
-    }
 
     l->state_size = state_size;
     l->pstate = synchGetPersistentMemory(CACHE_LINE_SIZE, sizeof(PBCombPersistentState));
@@ -74,23 +85,49 @@ void PBCombStructInit(PBCombStruct *l, uint32_t nthreads, void *initial_state, u
         l->pstate->last_state->return_value[i] = 0;
         l->pstate->last_state->deactivate[i] = 0;
     }
-#ifdef NUMA_SUPPORT
-    l->numa_nodes = numa_num_task_nodes();
-#else
-    l->numa_nodes = 1;
-#endif
-
     l->numa_ids = synchGetPersistentMemory(CACHE_LINE_SIZE, nthreads * sizeof(uint32_t));
     for (i = 0; i < nthreads; i++)
         l->numa_ids[i] = i;
 
-#ifdef NUMA_SUPPORT
+#ifdef SYNCH_NUMA_SUPPORT
     qsort((void *)l->numa_ids, nthreads, sizeof(uint32_t), compare_numa);
 #endif
 
+    // The requests of the threads of each NUMA node form a segment (in the order of `numa_ids`),
+    // which is allocated on this node, so that each thread announces its requests to local memory.
+    l->segment_first = synchGetAlignedMemory(CACHE_LINE_SIZE, (nthreads + 1) * sizeof(uint32_t));
+    segment_node = synchGetAlignedMemory(CACHE_LINE_SIZE, nthreads * sizeof(uint32_t));
+    for (i = 0, n = 0; i < nthreads; i++) {
+        if (i == 0 || nodeOfThread(l->numa_ids[i]) != segment_node[n - 1]) {
+            l->segment_first[n] = i;
+            segment_node[n] = nodeOfThread(l->numa_ids[i]);
+            n++;
+        }
+    }
+    l->segment_first[n] = nthreads;
+    l->numa_nodes = n;
+    l->request = synchGetAlignedMemory(CACHE_LINE_SIZE, n * sizeof(PBCombRequest *));
+    for (n = 0; n < l->numa_nodes; n++) {
+        uint32_t size = l->segment_first[n + 1] - l->segment_first[n];
+
+        l->request[n] = synchGetAlignedMemoryOnNode(CACHE_LINE_SIZE, size * sizeof(PBCombRequest), segment_node[n]);
+        for (i = 0; i < size; i++) {
+            l->request[n][i].arg = 0;
+            l->request[n][i].activate = 0;
+            l->request[n][i].valid = 0;
+        }
+    }
+    l->last_node = (nthreads > 0) ? segment_node[0] : 0;
+    synchFreeMemory(segment_node, nthreads * sizeof(uint32_t));
+
+    // the initial state should be durable before any operation is applied
+    synchFlushPersistentMemory((void *)l->pstate->last_state->flex, state_size + nthreads * sizeof(RetVal) + nthreads * sizeof(bool));
+    synchPersistRange((void *)l->pstate, sizeof(PBCombPersistentState));
+
     l->aux = NULL;
     l->final_persist_func = NULL;
     l->after_persist_func = NULL;
+    l->replica = NULL;
     synchFullFence();
 }
 
@@ -102,10 +139,17 @@ void PBCombSetAfterPersist(PBCombStruct *l, void (*after_persist_func)(void *))
     l->after_persist_func = after_persist_func;
 }
 
+void PBCombSetReplica(PBCombStruct *l, SynchReplicaStruct *replica) {
+    l->replica = replica;
+}
+
 void PBCombThreadStateInit(PBCombStruct *l, PBCombThreadState *st_thread, int pid) {
-    int i;
+    size_t record_size = sizeof(PBCombStateRec) + l->state_size + l->nthreads * sizeof(RetVal) + l->nthreads * sizeof(bool);
+    size_t stride = (record_size + CACHE_LINE_SIZE - 1) & ~((size_t)CACHE_LINE_SIZE - 1);
+    char *records;
+    int i, n;
 
-#ifdef NUMA_SUPPORT
+#ifdef SYNCH_NUMA_SUPPORT
     for (i = 0; i < l->nthreads; i++) {
         if (l->numa_ids[i] == pid) {
             st_thread->numa_id = i;
@@ -113,97 +157,26 @@ void PBCombThreadStateInit(PBCombStruct *l, PBCombThreadState *st_thread, int pi
         }
     }
 #else
-    st_thread->numa_node = 0;
     st_thread->numa_id = pid;
 #endif
+    st_thread->numa_node = nodeOfThread(pid);
+    for (n = 0; l->segment_first[n + 1] <= st_thread->numa_id; n++)
+        ;
+    st_thread->request = &l->request[n][st_thread->numa_id - l->segment_first[n]];
 
+    // The copies of the state are allocated in bulk and pre-faulted by the calling thread (i.e. the owner),
+    // so that they reside on the NUMA node of the owner, which writes them as a combiner.
     st_thread->pool_index = 0;
+    records = synchGetPersistentMemory(CACHE_LINE_SIZE, PBCOMB_POOL_SIZE * stride);
+    synchPrefaultMemory(records, PBCOMB_POOL_SIZE * stride);
     for (i = 0; i < PBCOMB_POOL_SIZE; i++) {
-        st_thread->pool[i] = synchGetPersistentMemory(CACHE_LINE_SIZE, sizeof(PBCombStateRec) + l->state_size +
-                                                 l->nthreads * sizeof(RetVal) + l->nthreads * sizeof(bool));
+        st_thread->pool[i] = (PBCombStateRec *)(records + i * stride);
         st_thread->pool[i]->state = ((void *)st_thread->pool[i]->flex);
         st_thread->pool[i]->return_value = ((void *)st_thread->pool[i]->flex) + l->state_size;
         st_thread->pool[i]->deactivate = ((void *)st_thread->pool[i]->flex) + l->state_size + l->nthreads * sizeof(RetVal);
     }
 }
 
-RetVal PBCombApplyOp(PBCombStruct *s, PBCombThreadState *st_thread, RetVal (*sfunc)(void *, ArgVal, int), ArgVal arg, int pid) {
-    int i, j;
-
-    s->request[st_thread->numa_id].arg = arg;
-    s->request[st_thread->numa_id].activate = 1 - s->request[st_thread->numa_id].activate;
-    if (!s->request[st_thread->numa_id].valid) {
-        s->request[st_thread->numa_id].valid = 1;
-    }
-    synchFullFence();
-
-    while (true) {
-        int32_t lock_value = s->lock;
-
-        if (lock_value % 2 == 0) {
-            if (synchCAS32(&s->lock, lock_value, lock_value + 1)) {
-                break;
-            }
-            lock_value++;
-        } else {
-            while(s->lock == lock_value)
-                synchResched();
-
-            volatile PBCombStateRec *last_state = s->pstate->last_state;
-            if (last_state->deactivate[st_thread->numa_id] == s->request[st_thread->numa_id].activate) {
-                if (s->lock_value == lock_value)
-                    return last_state->return_value[st_thread->numa_id];
-                while (s->lock == lock_value+2)
-                    synchResched();
-                return last_state->return_value[st_thread->numa_id];
-            }
-        }
-    }
-
-#ifdef DEBUG
-     s->rounds += 1;
-#endif
-    volatile PBCombStateRec *new_state = st_thread->pool[st_thread->pool_index];
-    memcpy((void *)new_state->flex, (void *)s->pstate->last_state->flex, 
-           s->state_size + s->nthreads * sizeof(RetVal) + s->nthreads * sizeof(bool));
-
-    for (i=0; i < COMBINING_ROUNDS; i++) {
-        uint64_t serve_reqs = 0;
-
-        for (j = 0; j < s->nthreads; j++) {
-            if (new_state->deactivate[j] != s->request[j].activate && s->request[j].valid == 1) {
-                new_state->return_value[j] = sfunc((void *)new_state->state, s->request[j].arg, j);
-                new_state->deactivate[j] = s->request[j].activate;
-                serve_reqs++;
-#ifdef DEBUG
-                s->counter += 1;
-#endif
-            }
-        }
-        if (serve_reqs == 0)
-            break;
-    }
-
-    if (s->final_persist_func != NULL) {
-        s->final_persist_func((void *)s);
-    }
-
-    synchFlushPersistentMemory((void *)new_state->flex, s->state_size + s->nthreads * sizeof(RetVal) + s->nthreads * sizeof(bool));
-    synchDrainPersistentMemory();
-
-    s->lock_value = s->lock;
-    s->pstate->last_state = new_state;
-
-    synchFlushPersistentMemory((void *)s->pstate, sizeof(PBCombPersistentState));
-    synchDrainPersistentMemory();
-
-    if (s->after_persist_func != NULL) {
-        s->after_persist_func((void *)s);
-    }
-
-    st_thread->pool_index = (st_thread->pool_index + 1) % PBCOMB_POOL_SIZE;
-    s->lock += 1;
-    synchFullFence();
-
-    return new_state->return_value[st_thread->numa_id];
+RetVal PBCombApplyOp(PBCombStruct *l, PBCombThreadState *st_thread, RetVal (*sfunc)(void *, ArgVal, int), ArgVal arg, int pid) {
+    return PBCombApplyOpTemplate(l, st_thread, sfunc, l->final_persist_func, l->after_persist_func, l->state_size, arg, pid);
 }
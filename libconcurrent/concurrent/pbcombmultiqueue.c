@@ -0,0 +1,67 @@
+#include <pbcombmultiqueue.h>
+
+void PBCombMultiQueueInit(PBCombMultiQueueStruct *queue, uint32_t nthreads, uint32_t nheaps, uint32_t choices) {
+    int i;
+
+    if (nheaps == 0)
+        nheaps = 1;
+    if (choices == 0)
+        choices = 1;
+    queue->nheaps = nheaps;
+    queue->choices = (choices > nheaps) ? nheaps : choices;
+    queue->heaps = synchGetAlignedMemory(S_CACHE_LINE_SIZE, nheaps * sizeof(PBCombHeapStruct));
+    for (i = 0; i < nheaps; i++)
+        PBCombHeapInit(&queue->heaps[i], nthreads);
+    synchFullFence();
+}
+
+void PBCombMultiQueueThreadStateInit(PBCombMultiQueueStruct *queue, PBCombMultiQueueThreadState *lobject_struct, int pid) {
+    int i;
+
+    lobject_struct->heaps = synchGetAlignedMemory(CACHE_LINE_SIZE, queue->nheaps * sizeof(PBCombHeapThreadState));
+    for (i = 0; i < queue->nheaps; i++)
+        PBCombHeapThreadStateInit(&queue->heaps[i], &lobject_struct->heaps[i], pid);
+}
+
+RetVal PBCombMultiQueueInsert(PBCombMultiQueueStruct *queue, PBCombMultiQueueThreadState *lobject_struct, HeapElement arg, int pid) {
+    uint32_t i, heap = synchFastRandom32() % queue->nheaps;
+
+    for (i = 0; i < queue->nheaps; i++, heap = (heap + 1 == queue->nheaps) ? 0 : heap + 1) {
+        if (PBCombHeapInsert(&queue->heaps[heap], &lobject_struct->heaps[heap], arg, pid) == HEAP_INSERT_SUCCESS)
+            return HEAP_INSERT_SUCCESS;
+    }
+
+    return HEAP_INSERT_FAIL;
+}
+
+HeapElement PBCombMultiQueueDeleteMin(PBCombMultiQueueStruct *queue, PBCombMultiQueueThreadState *lobject_struct, int pid) {
+    uint32_t i, heap, best = synchFastRandom32() % queue->nheaps;
+    // EMPTY_HEAP is larger than any valid element, when both are compared as HeapElements
+    HeapElement min, best_min = PBCombHeapPeekMin(&queue->heaps[best]);
+    HeapElement ret;
+
+    for (i = 1; i < queue->choices; i++) {
+        heap = synchFastRandom32() % queue->nheaps;
+        min = PBCombHeapPeekMin(&queue->heaps[heap]);
+        if (min < best_min) {
+            best = heap;
+            best_min = min;
+        }
+    }
+    if (best_min != EMPTY_HEAP) {
+        ret = PBCombHeapDeleteMin(&queue->heaps[best], &lobject_struct->heaps[best], pid);
+        if (ret != EMPTY_HEAP)
+            return ret;
+    }
+
+    // All sampled heaps are empty (or the chosen one was emptied concurrently), thus the rest of the heaps are probed.
+    for (i = 0, heap = best; i < queue->nheaps; i++, heap = (heap + 1 == queue->nheaps) ? 0 : heap + 1) {
+        if (PBCombHeapPeekMin(&queue->heaps[heap]) == EMPTY_HEAP)
+            continue;
+        ret = PBCombHeapDeleteMin(&queue->heaps[heap], &lobject_struct->heaps[heap], pid);
+        if (ret != EMPTY_HEAP)
+            return ret;
+    }
+
+    return EMPTY_HEAP;
+}
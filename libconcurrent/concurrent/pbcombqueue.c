@@ -1,41 +1,45 @@
 #include <pbcombqueue.h>
 
-static const uint64_t NVMEM_CACHE_LINE_SIZE = 64;
-static const uint64_t NEG_NVMEM_CACHE_LINE_SIZE = ~(64 - 1);
-
 inline static RetVal serialEnqueue(void *state, ArgVal arg, int pid);
 inline static RetVal serialDequeue(void *state, ArgVal arg, int pid);
 inline static void clPersist_enqueued_nodes(void *state);
 
 static const int GUARD = INT_MIN;
-static __thread SynchPoolStruct pool_node CACHE_ALIGN;
-static __thread Node **clNewItems;
-static __thread uint64_t clNewItems_size = 0;
-static __thread Node *Tail = NULL;
-static __thread PBCombStruct *enqueue_struct;
-static __thread uint64_t enqueue_counter = 0;
+// The local state of the thread that currently applies an operation, i.e. of the combiner while it serves requests.
+static __thread PBCombQueueThreadState *combiner_state;
 
 inline static void clPersist_enqueued_nodes(void *state) {
-    int i;
-
-    for (i = 0; i < clNewItems_size; i++) {
-        synchFlushPersistentMemory((void *)clNewItems[i], NVMEM_CACHE_LINE_SIZE);
-    }
+    synchLineSetFlush(&combiner_state->new_lines);
 }
 
 inline static void updateAuxField(void *state) {
-    if (enqueue_counter > 0) {
-        ((PBCombStruct *)state)->aux = Tail;
+    if (combiner_state->enqueue_counter > 0) {
+        ((PBCombStruct *)state)->aux = combiner_state->tail;
         synchFullFence();
     }
 }
 
+// A removed node is recycled only after the new state of the dequeue object is persisted, since it may be
+// reused by its owner at once, while a crash before the persistence would recover it as the first node.
+inline static void recycleDequeuedNodes(void *state) {
+    int i;
+
+    for (i = 0; i < combiner_state->free_list_size; i++) {
+        synchRecycleObj(&combiner_state->pool_node, combiner_state->free_list[i]);
+    }
+    synchPoolFlushRemote(&combiner_state->pool_node);
+}
+
+PBCOMB_DEFINE_OBJECT(enqueue, Node *, serialEnqueue, clPersist_enqueued_nodes, updateAuxField)
+PBCOMB_DEFINE_OBJECT(dequeue, Node *, serialDequeue, NULL, recycleDequeuedNodes)
+
 
 void PBCombQueueInit(PBCombQueueStruct *queue_object_struct, uint32_t nthreads) {
     queue_object_struct->guard.val = GUARD;
     queue_object_struct->guard.next = NULL;
     queue_object_struct->first = &queue_object_struct->guard;
     queue_object_struct->last = &queue_object_struct->guard;
+    synchPersistRange(&queue_object_struct->guard, sizeof(Node));
 
     PBCombStructInit(&queue_object_struct->enqueue_struct, nthreads, (void *)&queue_object_struct->last, sizeof(Node *));
     queue_object_struct->enqueue_struct.aux = &queue_object_struct->guard;
@@ -43,6 +47,7 @@ void PBCombQueueInit(PBCombQueueStruct *queue_object_struct, uint32_t nthreads)
     PBCombSetAfterPersist(&queue_object_struct->enqueue_struct, updateAuxField);
 
     PBCombStructInit(&queue_object_struct->dequeue_struct, nthreads, (void *)&queue_object_struct->first, sizeof(Node *));
+    PBCombSetAfterPersist(&queue_object_struct->dequeue_struct, recycleDequeuedNodes);
     synchFullFence();
 }
 
@@ -51,39 +56,33 @@ void PBCombQueueThreadStateInit(PBCombQueueStruct *object_struct, PBCombQueueThr
 
     PBCombThreadStateInit(&object_struct->enqueue_struct, &lobject_struct->enqueue_thread_state, (int)pid);
     PBCombThreadStateInit(&object_struct->dequeue_struct, &lobject_struct->dequeue_thread_state, (int)pid);
-    synchInitPoolPersistent(&pool_node, sizeof(Node));
-    clNewItems = synchGetAlignedMemory(CACHE_LINE_SIZE, object_struct->enqueue_struct.nthreads * sizeof(Node **));
-    for (i = 0; i < object_struct->enqueue_struct.nthreads; i++) {
-        clNewItems[i] = NULL;
+    synchInitPoolPersistent(&lobject_struct->pool_node, sizeof(Node));
+    synchPoolSetLinePacking(&lobject_struct->pool_node, true);
+    synchPoolPrefault(&lobject_struct->pool_node, SYNCH_POOL_PREFAULT_OBJECTS);
+    synchLineSetInit(&lobject_struct->new_lines, object_struct->enqueue_struct.nthreads + 1);
+    lobject_struct->enqueue_counter = 0;
+    lobject_struct->tail = NULL;
+    lobject_struct->free_list = synchGetAlignedMemory(CACHE_LINE_SIZE, object_struct->dequeue_struct.nthreads * sizeof(Node *));
+    for (i = 0; i < object_struct->dequeue_struct.nthreads; i++) {
+        lobject_struct->free_list[i] = NULL;
     }
-    clNewItems_size = 0;
-    Tail = NULL;
-    enqueue_struct = &object_struct->enqueue_struct;
+    lobject_struct->free_list_size = 0;
+    lobject_struct->queue = object_struct;
 }
 
 inline static RetVal serialEnqueue(void *state, ArgVal arg, int pid) {
-    uint64_t new_item_ptr;
     volatile Node *last = *((Node **)state);
-    volatile Node *node = synchAllocObj(&pool_node);
-    bool found = false;
-    int i;
+    volatile Node *node = synchAllocObj(&combiner_state->pool_node);
 
-    enqueue_counter++;
+    combiner_state->enqueue_counter++;
     node->next = NULL;
     node->val = arg;
-    Tail = (Node *)node;
+    combiner_state->tail = (Node *)node;
     last->next = node;
-    new_item_ptr = ((uint64_t)node) & NEG_NVMEM_CACHE_LINE_SIZE;
-    for (i = 0; i < clNewItems_size; i++) {
-        if (new_item_ptr == (uint64_t)clNewItems[i]) {
-            found = true;
-            break;
-        }
-    }
-    if (!found) {
-        clNewItems[clNewItems_size] = (void *)(new_item_ptr);
-        clNewItems_size++;
-    }
+    // the first enqueue of a round links the last node of the previous round, which should be persisted again
+    if (combiner_state->enqueue_counter == 1)
+        synchLineSetInsert(&combiner_state->new_lines, last);
+    synchLineSetInsert(&combiner_state->new_lines, node);
 
     *((volatile Node **)state) = node;
     return -1;
@@ -94,12 +93,13 @@ inline static RetVal serialDequeue(void *state, ArgVal arg, int pid) {
     volatile Node *node;
     RetVal ret = -1;
 
-    if (first != enqueue_struct->aux) {
+    if (first != combiner_state->queue->enqueue_struct.aux) {
         node = first;
         first = first->next;
         *((volatile Node **)state) = first;
         ret = first->val;
-        synchRecycleObj(&pool_node, (void *)node);
+        combiner_state->free_list[combiner_state->free_list_size] = (Node *)node;
+        combiner_state->free_list_size++;
         return ret;
     } else {
         return ret;
@@ -107,12 +107,14 @@ inline static RetVal serialDequeue(void *state, ArgVal arg, int pid) {
 }
 
 void PBCombQueueApplyEnqueue(PBCombQueueStruct *object_struct, PBCombQueueThreadState *lobject_struct, ArgVal arg, int pid) {
-    clNewItems_size = 0;
-    enqueue_counter = 0;
-    PBCombApplyOp(&object_struct->enqueue_struct, &lobject_struct->enqueue_thread_state, serialEnqueue, (ArgVal) arg, pid);
+    combiner_state = lobject_struct;
+    synchLineSetReset(&combiner_state->new_lines);
+    combiner_state->enqueue_counter = 0;
+    enqueueApplyOp(&object_struct->enqueue_struct, &lobject_struct->enqueue_thread_state, (ArgVal) arg, pid);
 }
 
 RetVal PBCombQueueApplyDequeue(PBCombQueueStruct *object_struct, PBCombQueueThreadState *lobject_struct, int pid) {
-    clNewItems_size = 0;
-    return PBCombApplyOp(&object_struct->dequeue_struct, &lobject_struct->dequeue_thread_state, serialDequeue, (ArgVal) pid, pid);
+    combiner_state = lobject_struct;
+    combiner_state->free_list_size = 0;
+    return dequeueApplyOp(&object_struct->dequeue_struct, &lobject_struct->dequeue_thread_state, (ArgVal) pid, pid);
 }
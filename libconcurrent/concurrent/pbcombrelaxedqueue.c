@@ -0,0 +1,141 @@
+#include <pbcombrelaxedqueue.h>
+
+// Returns true in case that sequence number `a` is older than sequence number `b`, taking into account wrap-arounds.
+inline static bool olderSequence(uint64_t a, uint64_t b) {
+    return (int64_t)((a - b) << (64 - PBCOMB_RELAXED_QUEUE_SEQ_BITS)) < 0;
+}
+
+// Returns the sequence number of a new element of `lane`. The counter of the lane never falls behind the global epoch,
+// which is advanced only after the lane has taken PBCOMB_RELAXED_QUEUE_SEQ_EPOCH sequence numbers beyond it. Thus,
+// enqueues rarely write the epoch, while the sequence numbers of the active lanes stay roughly aligned.
+inline static uint64_t nextSequence(PBCombRelaxedQueueStruct *queue, PBCombRelaxedQueueLane *lane) {
+    uint64_t epoch = queue->epoch;
+    uint64_t seq, next;
+
+    do {
+        seq = lane->sequence;
+        next = ((seq > epoch) ? seq : epoch) + 1;
+    } while (!synchCAS64(&lane->sequence, seq, next));
+    if (next - epoch >= PBCOMB_RELAXED_QUEUE_SEQ_EPOCH)
+        synchCAS64(&queue->epoch, epoch, next);
+
+    return next;
+}
+
+// Returns an estimation of the number of elements of `lane`; `dequeues` is read first, so the estimation
+// does not miss elements inserted by completed enqueues.
+inline static int64_t laneSize(PBCombRelaxedQueueLane *lane) {
+    uint64_t dequeues = lane->dequeues;
+
+    return (int64_t)(lane->enqueues - dequeues);
+}
+
+// Returns true in case that lane `a` is a better candidate for a dequeue than lane `b`.
+inline static bool betterLane(PBCombRelaxedQueueStruct *queue, PBCombRelaxedQueueLane *a, PBCombRelaxedQueueLane *b) {
+    int64_t a_size = laneSize(a), b_size = laneSize(b);
+
+    if (queue->sequenced) {
+        if (a_size <= 0 || b_size <= 0)
+            return a_size > b_size;
+        return olderSequence(a->head_seq, b->head_seq);
+    }
+
+    return a_size > b_size;
+}
+
+void PBCombRelaxedQueueInit(PBCombRelaxedQueueStruct *queue, uint32_t nthreads, uint32_t nlanes, uint32_t choices,
+                            uint32_t policy, bool sequenced) {
+    int i;
+
+    if (nlanes == 0)
+        nlanes = 1;
+    if (choices == 0)
+        choices = 1;
+    queue->nlanes = nlanes;
+    queue->choices = (choices > nlanes) ? nlanes : choices;
+    queue->policy = policy;
+    queue->sequenced = sequenced;
+    queue->epoch = 0;
+    queue->lanes = synchGetAlignedMemory(S_CACHE_LINE_SIZE, nlanes * sizeof(PBCombRelaxedQueueLane));
+    for (i = 0; i < nlanes; i++) {
+        PBCombQueueInit(&queue->lanes[i].queue, nthreads);
+        queue->lanes[i].enqueues = 0;
+        queue->lanes[i].dequeues = 0;
+        queue->lanes[i].sequence = 0;
+        queue->lanes[i].head_seq = 0;
+    }
+    synchFullFence();
+}
+
+void PBCombRelaxedQueueThreadStateInit(PBCombRelaxedQueueStruct *queue, PBCombRelaxedQueueThreadState *lobject_struct, int pid) {
+    int i;
+
+    lobject_struct->lanes = synchGetAlignedMemory(CACHE_LINE_SIZE, queue->nlanes * sizeof(PBCombQueueThreadState));
+    for (i = 0; i < queue->nlanes; i++)
+        PBCombQueueThreadStateInit(&queue->lanes[i].queue, &lobject_struct->lanes[i], pid);
+    lobject_struct->next_lane = pid % queue->nlanes;
+    lobject_struct->enqueues = synchGetAlignedMemory(CACHE_LINE_SIZE, queue->nlanes * sizeof(uint64_t));
+}
+
+void PBCombRelaxedQueueApplyEnqueue(PBCombRelaxedQueueStruct *queue, PBCombRelaxedQueueThreadState *lobject_struct, ArgVal arg, int pid) {
+    uint32_t lane;
+
+    if (queue->policy == PBCOMB_RELAXED_QUEUE_ROUND_ROBIN) {
+        lane = lobject_struct->next_lane;
+        lobject_struct->next_lane = (lane + 1 == queue->nlanes) ? 0 : lane + 1;
+    } else {
+        lane = pid % queue->nlanes;
+    }
+    if (queue->sequenced) {
+        uint64_t seq = nextSequence(queue, &queue->lanes[lane]) & PBCOMB_RELAXED_QUEUE_SEQ_MASK;
+
+        // Only the PBCOMB_RELAXED_QUEUE_VAL_BITS (i.e. 40) least significant bits of `arg` are stored, thus
+        // negative values and values wider than 40 bits are silently truncated.
+        arg = (ArgVal)((seq << PBCOMB_RELAXED_QUEUE_VAL_BITS) | (arg & PBCOMB_RELAXED_QUEUE_VAL_MASK));
+    }
+    PBCombQueueApplyEnqueue(&queue->lanes[lane].queue, &lobject_struct->lanes[lane], arg, pid);
+    synchFAA64(&queue->lanes[lane].enqueues, 1);
+}
+
+RetVal PBCombRelaxedQueueApplyDequeue(PBCombRelaxedQueueStruct *queue, PBCombRelaxedQueueThreadState *lobject_struct, int pid) {
+    uint32_t best = synchFastRandom32() % queue->nlanes;
+    uint32_t i, lane, pass;
+    RetVal ret;
+
+    for (i = 1; i < queue->choices; i++) {
+        lane = synchFastRandom32() % queue->nlanes;
+        if (betterLane(queue, &queue->lanes[lane], &queue->lanes[best]))
+            best = lane;
+    }
+
+    // The lanes that seem to be non-empty are probed first, starting from the chosen one. Since elements may be
+    // inserted while the first pass is in progress, a second pass probes the lanes that have completed enqueues
+    // since the first pass read their `enqueues` counter. A lane that the first pass found empty although its
+    // estimated size was positive is probed again only if its estimated size is still positive, since the dequeue
+    // that emptied it may have not updated `dequeues` yet, or (as the tail of a PBqueue lane is published after
+    // the combiner releases its lock) the elements of the last completed enqueues may have not been visible yet.
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0, lane = best; i < queue->nlanes; i++, lane = (lane + 1 == queue->nlanes) ? 0 : lane + 1) {
+            if (pass == 0) {
+                uint64_t dequeues = queue->lanes[lane].dequeues;
+
+                lobject_struct->enqueues[lane] = queue->lanes[lane].enqueues;
+                if ((int64_t)(lobject_struct->enqueues[lane] - dequeues) <= 0)
+                    continue;
+            } else if (queue->lanes[lane].enqueues == lobject_struct->enqueues[lane] && laneSize(&queue->lanes[lane]) <= 0) {
+                continue;
+            }
+            ret = PBCombQueueApplyDequeue(&queue->lanes[lane].queue, &lobject_struct->lanes[lane], pid);
+            if (ret != PBCOMB_RELAXED_QUEUE_EMPTY) {
+                synchFAA64(&queue->lanes[lane].dequeues, 1);
+                if (queue->sequenced) {
+                    queue->lanes[lane].head_seq = ((uint64_t)ret) >> PBCOMB_RELAXED_QUEUE_VAL_BITS;
+                    ret &= PBCOMB_RELAXED_QUEUE_VAL_MASK;
+                }
+                return ret;
+            }
+        }
+    }
+
+    return PBCOMB_RELAXED_QUEUE_EMPTY;
+}
@@ -1,17 +1,11 @@
 #include <pwfcomb.h>
 #include <pwfcombqueue.h>
-#include <numa.h>
+#include <lineset.h>
 
 static const int LOCAL_POOL_SIZE = _SIM_PERSISTENT_LOCAL_POOL_SIZE_;
 
-static const uint64_t NVMEM_CACHE_LINE_SIZE = 64;
-static const uint64_t NEG_NVMEM_CACHE_LINE_SIZE = ~(64 - 1);
-
-static __thread int fad_division_enqueue = -1;
-static __thread int fad_division_dequeue = -1;
-
-static __thread Node **clNewItems;
-static __thread uint64_t clNewItems_size;
+// The cache lines of the nodes created by the current enqueue round of the thread, which should be persisted.
+static __thread SynchLineSet new_lines;
 
 static inline void EnqStateCopy(PWFCombQueueEnqRec *dest, PWFCombQueueEnqRec *src);
 static inline void DeqStateCopy(PWFCombQueueDeqState *dest, PWFCombQueueDeqState *src);
@@ -30,89 +24,171 @@ inline static void DeqLinkQueue(PWFCombQueueStruct *queue, PWFCombQueueDeqState
     pointer_t ES;
     PWFCombQueueEnqRec *enq_pst;
 
-    ES.raw_data = queue->Epstate->S.raw_data;
+    ES = PWFCombLoadPointer(&queue->Epstate->S);
     enq_pst = queue->EState[ES.struct_data.index];
 
     if (pst->head->next == NULL) {
         volatile Node *last = enq_pst->last;
         volatile Node *first = enq_pst->first;
         synchFullFence();
-        if (first != NULL && last != NULL && ES.raw_data == queue->Epstate->S.raw_data) {
+        if (first != NULL && last != NULL && PWFCombEqualPointers(ES, &queue->Epstate->S)) {
             synchCASPTR(&first->next, NULL, last);
             synchFlushPersistentMemory((void *)&first->next, sizeof(Node *));
         }
     }
 }
 
+inline static void recycleList(SynchPoolStruct *pool, Node *head, uint32_t items) {
+    while (items > 0) {
+        Node *node = head;
+        head = (Node *)head->next;
+        items--;
+        synchRecycleObj(pool, node);
+    }
+}
+
+inline static void recycleBatch(PWFCombQueueStruct *queue, PWFCombQueueThreadState *th_state, PWFCombQueueRetiredBatch *batch) {
+    Node *node = batch->first;
+
+    while (node != batch->stop) {
+        Node *next = (Node *)node->next;
+        // the guard node is the initial head of the queue and it does not belong to any pool
+        if (node != &queue->guard)
+            synchRecycleObj(&th_state->pool_node, node);
+        node = next;
+    }
+}
+
+static void reclaimRetiredNodes(PWFCombQueueStruct *queue, PWFCombQueueThreadState *th_state, int pid) {
+    uint64_t enq_seq, epoch, min_epoch = PWFCOMB_QUEUE_QUIESCENT;
+    PWFCombQueueRetiredBatch *batch;
+    uint32_t i;
+
+    // A batch is tagged only if its nodes could not be the `first` node of the current enqueue state.
+    // A thread that observes an epoch larger than the tag reads the queue's states after the batch was tagged,
+    // and thus it could not access any node of the batch. Since the batches are retired in order of `enq_seq`,
+    // the tagged batches are always a prefix of the ring buffer.
+    enq_seq = PWFCombLoadPointer(&queue->Epstate->S).struct_data.seq;
+    epoch = synchFAA64(&queue->reclaim_epoch, 1);
+    for (; th_state->retired_tagged < th_state->retired_size; th_state->retired_tagged++) {
+        batch = &th_state->retired[(th_state->retired_head + th_state->retired_tagged) % th_state->retired_capacity];
+        if (batch->enq_seq >= enq_seq)
+            break;
+        batch->epoch = epoch;
+    }
+    // the calling thread has completed its combining round, so its own reservation is ignored
+    for (i = 0; i < queue->nthreads; i++) {
+        if (i != pid && queue->reservations[i].epoch < min_epoch)
+            min_epoch = queue->reservations[i].epoch;
+    }
+    while (th_state->retired_tagged > 0 && th_state->retired[th_state->retired_head].epoch < min_epoch) {
+        recycleBatch(queue, th_state, &th_state->retired[th_state->retired_head]);
+        th_state->retired_head = (th_state->retired_head + 1) % th_state->retired_capacity;
+        th_state->retired_size--;
+        th_state->retired_tagged--;
+    }
+}
+
+static void growRetiredBatches(PWFCombQueueThreadState *th_state) {
+    uint32_t i, capacity = 2 * th_state->retired_capacity;
+    PWFCombQueueRetiredBatch *retired = synchGetAlignedMemory(CACHE_LINE_SIZE, capacity * sizeof(PWFCombQueueRetiredBatch));
+
+    for (i = 0; i < th_state->retired_size; i++)
+        retired[i] = th_state->retired[(th_state->retired_head + i) % th_state->retired_capacity];
+    synchFreeMemory(th_state->retired, th_state->retired_capacity * sizeof(PWFCombQueueRetiredBatch));
+    th_state->retired = retired;
+    th_state->retired_capacity = capacity;
+    th_state->retired_head = 0;
+}
+
+inline static void retireNodes(PWFCombQueueStruct *queue, PWFCombQueueThreadState *th_state, Node *first, Node *stop, int pid) {
+    PWFCombQueueRetiredBatch *batch = NULL;
+
+    // A round that continues the latest batch of the thread just extends it. The latest batch is not extended
+    // after an attempt to recycle nodes, so that it could be tagged by the next attempt.
+    if (th_state->retired_size > th_state->retired_tagged && th_state->retired_rounds % PWFCOMB_QUEUE_RECLAIM_THRESHOLD != 0) {
+        batch = &th_state->retired[(th_state->retired_head + th_state->retired_size - 1) % th_state->retired_capacity];
+        if (batch->stop == first)
+            batch->stop = stop;
+        else
+            batch = NULL;
+    }
+    if (batch == NULL) {
+        if (th_state->retired_size == th_state->retired_capacity)
+            growRetiredBatches(th_state);
+        batch = &th_state->retired[(th_state->retired_head + th_state->retired_size) % th_state->retired_capacity];
+        batch->first = first;
+        batch->stop = stop;
+        batch->epoch = PWFCOMB_QUEUE_QUIESCENT;
+        th_state->retired_size++;
+    }
+    batch->enq_seq = PWFCombLoadPointer(&queue->Epstate->S).struct_data.seq;
+    th_state->retired_rounds++;
+    if (th_state->retired_rounds % PWFCOMB_QUEUE_RECLAIM_THRESHOLD == 0)
+        reclaimRetiredNodes(queue, th_state, pid);
+}
+
 static inline void EnqStateCopy(PWFCombQueueEnqRec *dest, PWFCombQueueEnqRec *src) {
-    // copy everything except 'deactivate' and 'index' fields
-    memcpy(&dest->first, &src->first, PWFCombQueueEnqStateSize(src->deactivate.nthreads) - 2 * sizeof(ToggleVector));
+    // copy everything except 'deactivate' field
+    memcpy(&dest->first, &src->first, PWFCombQueueEnqStateSize(src->deactivate.nthreads) - sizeof(ToggleVector));
 }
 
 static inline void DeqStateCopy(PWFCombQueueDeqState *dest, PWFCombQueueDeqState *src) {
-    // copy everything except 'deactivate', 'index' and 'return_val' fields
-    memcpy(&dest->head, &src->head, PWFCombQueueDeqStateSize(src->deactivate.nthreads) - 2 * sizeof(ToggleVector) - sizeof(RetVal *));
+    // copy everything except 'deactivate' and 'return_val' fields
+    memcpy(&dest->head, &src->head, PWFCombQueueDeqStateSize(src->deactivate.nthreads) - sizeof(ToggleVector) - sizeof(RetVal *));
 }
 
 void PWFCombQueueThreadStateInit(PWFCombQueueStruct *queue, PWFCombQueueThreadState *th_state, int pid) {
-    int i;
-    
     TVEC_INIT(&th_state->mask, queue->nthreads);
     TVEC_INIT(&th_state->deq_index, queue->nthreads);
     TVEC_INIT(&th_state->enq_index, queue->nthreads);
     TVEC_INIT(&th_state->diffs, queue->nthreads);
     TVEC_INIT(&th_state->l_activate, queue->nthreads);
-    TVEC_INIT(&th_state->diffs_copy, queue->nthreads);
 
     TVEC_SET_BIT(&th_state->mask, pid);
     TVEC_NEGATIVE(&th_state->enq_index, &th_state->mask);
     synchInitPoolPersistent(&th_state->pool_node, sizeof(Node));
+    synchPoolSetLinePacking(&th_state->pool_node, true);
+    synchPoolPrefault(&th_state->pool_node, SYNCH_POOL_PREFAULT_OBJECTS);
 
     TVEC_SET_ZERO(&th_state->mask);
     TVEC_SET_BIT(&th_state->mask, pid);
     TVEC_NEGATIVE(&th_state->deq_index, &th_state->mask);
-    th_state->backoff = 1;
-
-    clNewItems = synchGetAlignedMemory(CACHE_LINE_SIZE, queue->nthreads * sizeof(Node **));
-    for (i = 0; i < queue->nthreads; i++) {
-        clNewItems[i] = NULL;
-    }
-    clNewItems_size = 0;
+    th_state->deq_local_index = 0;
+    th_state->enq_local_index = 0;
+    th_state->fad_division = -1;
+    th_state->retired_capacity = PWFCOMB_QUEUE_RETIRED_BATCHES;
+    th_state->retired = synchGetAlignedMemory(CACHE_LINE_SIZE, th_state->retired_capacity * sizeof(PWFCombQueueRetiredBatch));
+    th_state->retired_head = 0;
+    th_state->retired_size = 0;
+    th_state->retired_tagged = 0;
+    th_state->retired_rounds = 0;
+
+    if (new_lines.lines == NULL)
+        synchLineSetInit(&new_lines, queue->nthreads);
 }
 
-void PWFCombQueueInit(PWFCombQueueStruct *queue, uint32_t nthreads, int max_backoff) {
+void PWFCombQueueInit(PWFCombQueueStruct *queue, uint32_t nthreads, uint32_t numa_nodes, int max_backoff) {
     pointer_t tmp_sp;
     int i;
 
     queue->nthreads = nthreads;
     queue->ERequest = synchGetAlignedMemory(CACHE_LINE_SIZE, nthreads * sizeof(PWFCombRequestRec));
-    queue->Ecomb_round = synchGetAlignedMemory(CACHE_LINE_SIZE, nthreads * sizeof(uint64_t *));
     for (i = 0; i < nthreads; i++) {
         queue->ERequest[i].arg = 0;
         queue->ERequest[i].valid = false;
-        queue->Ecomb_round[i] = synchGetAlignedMemory(CACHE_LINE_SIZE, nthreads * sizeof(uint64_t));
-        int j;
-        for (j = 0; j < nthreads; j++) {
-            queue->Ecomb_round[i][j] = 0;
-        }
     }
     queue->DRequest = synchGetAlignedMemory(CACHE_LINE_SIZE, nthreads * sizeof(PWFCombRequestRec));
-    queue->Dcomb_round = synchGetAlignedMemory(CACHE_LINE_SIZE, nthreads * sizeof(uint64_t *));
     for (i = 0; i < nthreads; i++) {
         queue->DRequest[i].arg = 0;
         queue->DRequest[i].valid = false;
-        queue->Dcomb_round[i] = synchGetAlignedMemory(CACHE_LINE_SIZE, nthreads * sizeof(uint64_t));
-        int j;
-        for (j = 0; j < nthreads; j++) {
-            queue->Dcomb_round[i][j] = 0;
-        }
-    }
-    for (i = 0; i < _SIM_PERSISTENT_FAD_DIVISIONS_; i++) {
-        TVEC_INIT_AT((ToggleVector *)&queue->activate_enq[i], nthreads, synchGetPersistentMemory(CACHE_LINE_SIZE, _TVEC_VECTOR_SIZE(nthreads)));
-        TVEC_SET_ZERO((ToggleVector *)&queue->activate_enq[i]);
-        TVEC_INIT_AT((ToggleVector *)&queue->activate_deq[i], nthreads, synchGetPersistentMemory(CACHE_LINE_SIZE, _TVEC_VECTOR_SIZE(nthreads)));
-        TVEC_SET_ZERO((ToggleVector *)&queue->activate_deq[i]);                     
     }
+    queue->reservations = synchGetAlignedMemory(CACHE_LINE_SIZE, nthreads * sizeof(PWFCombQueueReservation));
+    for (i = 0; i < nthreads; i++)
+        queue->reservations[i].epoch = PWFCOMB_QUEUE_QUIESCENT;
+    queue->reclaim_epoch = 0;
+    queue->activate_enq = PWFCombActivateInit(nthreads, numa_nodes, &queue->fad_divisions);
+    queue->activate_deq = PWFCombActivateInit(nthreads, numa_nodes, &queue->fad_divisions);
 
     queue->Epstate = synchGetPersistentMemory(S_CACHE_LINE_SIZE, sizeof(PWFCombQueuePersistentState));
     queue->Dpstate = synchGetPersistentMemory(2*S_CACHE_LINE_SIZE, sizeof(PWFCombQueuePersistentState));
@@ -121,40 +197,35 @@ void PWFCombQueueInit(PWFCombQueueStruct *queue, uint32_t nthreads, int max_back
     queue->Epstate->S = tmp_sp;
     queue->Dpstate->S = tmp_sp;
 
+    queue->Erounds = PWFCombRoundsInit(nthreads, LOCAL_POOL_SIZE * nthreads + 1);
+    queue->Drounds = PWFCombRoundsInit(nthreads, LOCAL_POOL_SIZE * nthreads + 1);
     queue->EState = synchGetPersistentMemory(CACHE_LINE_SIZE, (LOCAL_POOL_SIZE * nthreads + 1) * sizeof(PWFCombQueueEnqRec *));
     queue->DState = synchGetPersistentMemory(CACHE_LINE_SIZE, (LOCAL_POOL_SIZE * nthreads + 1) * sizeof(PWFCombQueueDeqState *));
+    PWFCombRecordsInit((void **)queue->EState, LOCAL_POOL_SIZE * nthreads + 1, PWFCombQueueEnqStateSize(nthreads), true);
+    PWFCombRecordsInit((void **)queue->DState, LOCAL_POOL_SIZE * nthreads + 1, PWFCombQueueDeqStateSize(nthreads), true);
     
     for (i = 0; i < LOCAL_POOL_SIZE * nthreads + 1; i++) {
-        queue->EState[i] = synchGetPersistentMemory(CACHE_LINE_SIZE, PWFCombQueueEnqStateSize(nthreads));
-        queue->DState[i] = synchGetPersistentMemory(CACHE_LINE_SIZE, PWFCombQueueDeqStateSize(nthreads));
-
         TVEC_INIT_AT(&queue->EState[i]->deactivate, nthreads, ((void *)queue->EState[i]->__flex));
-        TVEC_INIT_AT(&queue->EState[i]->index, nthreads, ((void *)queue->EState[i]->__flex) + _TVEC_VECTOR_SIZE(nthreads));
 
         TVEC_INIT_AT(&queue->DState[i]->deactivate, nthreads, ((void *)queue->DState[i]->__flex));
-        TVEC_INIT_AT(&queue->DState[i]->index, nthreads, ((void *)queue->DState[i]->__flex) + _TVEC_VECTOR_SIZE(nthreads));
-        queue->DState[i]->return_val = ((void *)queue->DState[i]->__flex) + 2 * _TVEC_VECTOR_SIZE(nthreads);
+        queue->DState[i]->return_val = ((void *)queue->DState[i]->__flex) + _TVEC_VECTOR_SIZE(nthreads);
     }
 
     queue->Eflush = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(uint64_t *) * (nthreads + 1));
     queue->Dflush = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(uint64_t *) * (nthreads + 1));
-    for (i = 0; i < nthreads + 1; i++) {
-        queue->Eflush[i] = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(uint64_t));
-        queue->Dflush[i] = synchGetAlignedMemory(CACHE_LINE_SIZE, sizeof(uint64_t));
-    }
+    PWFCombRecordsInit((void **)queue->Eflush, nthreads + 1, sizeof(uint64_t), false);
+    PWFCombRecordsInit((void **)queue->Dflush, nthreads + 1, sizeof(uint64_t), false);
     // Initializing queue's state
     // --------------------------
     queue->guard.val = GUARD_VALUE;
     queue->guard.next = NULL;
     *queue->Eflush[nthreads] = 0;
     TVEC_SET_ZERO((ToggleVector *) &queue->EState[LOCAL_POOL_SIZE * nthreads]->deactivate);
-    TVEC_SET_ZERO((ToggleVector *) &queue->EState[LOCAL_POOL_SIZE * nthreads]->index);
     queue->EState[LOCAL_POOL_SIZE * nthreads]->tail = &queue->guard;
     queue->EState[LOCAL_POOL_SIZE * nthreads]->first = NULL;
     queue->EState[LOCAL_POOL_SIZE * nthreads]->last = NULL;
     *queue->Dflush[nthreads] = 0;
     TVEC_SET_ZERO((ToggleVector *) &queue->DState[LOCAL_POOL_SIZE * nthreads]->deactivate);
-    TVEC_SET_ZERO((ToggleVector *) &queue->DState[LOCAL_POOL_SIZE * nthreads]->index);
     queue->DState[LOCAL_POOL_SIZE * nthreads]->head = &queue->guard;
 #ifdef DEBUG
     queue->EState[LOCAL_POOL_SIZE * nthreads]->counter = 0L;
@@ -175,59 +246,51 @@ void PWFCombQueueEnqueue(PWFCombQueueStruct *queue, PWFCombQueueThreadState *th_
     int curr_pool_index;
     uint64_t l_val;
 
-    if (fad_division_enqueue == -1) {
-        fad_division_enqueue = numa_node_of_cpu(synchGetPreferedCore()) % _SIM_PERSISTENT_FAD_DIVISIONS_;
-        if (fad_division_enqueue == -1) fad_division_enqueue = 0;
+    if (th_state->fad_division == -1) {                                                   // the first operation of the thread
+        th_state->fad_division = PWFCombFADDivisionOfThread(queue->fad_divisions);
+        synchInitTimedBackoff(&th_state->backoff, queue->MAX_BACK);
     }
+    synchTimedBackoffTune(&th_state->backoff);
 
     queue->ERequest[pid].arg = arg;
     queue->ERequest[pid].valid = true;
+    queue->reservations[pid].epoch = queue->reclaim_epoch;
     synchFullFence();
 
     int mybank = TVEC_GET_BANK_OF_BIT(pid, queue->nthreads);
     TVEC_NEGATIVE_BANK(&th_state->enq_index, &th_state->enq_index, mybank);
-    TVEC_ATOMIC_ADD_BANK(&queue->activate_enq[fad_division_enqueue], &th_state->enq_index, mybank);            // toggle pid's bit in activate_enq, Fetch&Add acts as a full write-barrier
+    TVEC_ATOMIC_ADD_BANK(&queue->activate_enq[th_state->fad_division], &th_state->enq_index, mybank);            // toggle pid's bit in activate_enq, Fetch&Add acts as a full write-barrier
 
     if (!synchIsSystemOversubscribed()) { 
-        volatile int k;
-        int backoff_limit;
-
         if (synchFastRandomRange(1, queue->nthreads) > 1) {
-            backoff_limit = synchFastRandomRange(th_state->backoff >> 1, th_state->backoff);
-            for (k = 0; k < backoff_limit; k++)
-                ;
+            synchTimedBackoffDelay(&th_state->backoff);
         }
     } else if (synchFastRandomRange(1, queue->nthreads) > 4) {
         synchResched();    
     }
 
     for (j = 0; j < 2; j++) {
-        old_sp = queue->Epstate->S;
+        old_sp = PWFCombLoadPointer(&queue->Epstate->S);
         sp_data = queue->EState[old_sp.struct_data.index];
-        TVEC_XOR_BANKS(diffs, &queue->activate_enq[fad_division_enqueue], &sp_data->deactivate, mybank);                               // determine the set of active processes
+        TVEC_XOR_BANKS(diffs, &queue->activate_enq[th_state->fad_division], &sp_data->deactivate, mybank);                               // determine the set of active processes
         l_val = *queue->Eflush[old_sp.struct_data.index/LOCAL_POOL_SIZE]; 
-        if (old_sp.raw_data != queue->Epstate->S.raw_data)
+        if (!PWFCombEqualPointers(old_sp, &queue->Epstate->S))
             continue;
         if (!TVEC_IS_SET(diffs, pid))                                                           // if the operation has already been deactivate return
             break;
 
-        uint64_t local_index = pid * LOCAL_POOL_SIZE + TVEC_IS_SET(&sp_data->index, pid);
+        uint64_t local_index = PWFCombNextLocalIndex(&th_state->enq_local_index, pid, old_sp.struct_data.index);
         lsp_data = queue->EState[local_index];
         EnqStateCopy(lsp_data, sp_data);
 
-        TVEC_SET_ZERO(l_activate);
-        for (i = 0; i < _SIM_PERSISTENT_FAD_DIVISIONS_; i++) {
-            TVEC_OR(l_activate, l_activate, (ToggleVector *)&queue->activate_enq[i]);                // This is an atomic read, since activate_enq is volatile
-        }
+        TVEC_OR_REDUCE(l_activate, (ToggleVector *)queue->activate_enq, queue->fad_divisions);                // This is an atomic read, since activate_enq is volatile
 
-        if (old_sp.raw_data != queue->Epstate->S.raw_data)
+        if (!PWFCombEqualPointers(old_sp, &queue->Epstate->S))
             continue;
 
-        for (i = 0; i < queue->nthreads; i++) {
-            clNewItems[i] = NULL;
-        }
+        synchLineSetReset(&new_lines);
         TVEC_XOR(diffs, &lsp_data->deactivate, l_activate);
-        TVEC_COPY(&th_state->diffs_copy, diffs);
+        TVEC_COPY(&queue->Erounds[local_index]->served, diffs);
         EnqLinkQueue(queue, lsp_data);
         enq_counter = 1;
         node = synchAllocObj(&th_state->pool_node);                                                    
@@ -235,12 +298,12 @@ void PWFCombQueueEnqueue(PWFCombQueueStruct *queue, PWFCombQueueThreadState *th_
         node->val = arg;
         llist = node;
         TVEC_REVERSE_BIT(diffs, pid);
-        clNewItems[0] = (void *)(node);
-        clNewItems_size = 1;
+        synchLineSetInsert(&new_lines, node);
 #ifdef DEBUG
         lsp_data->counter += 1;
 #endif
-        for (i = 0, prefix = 0; i < diffs->tvec_cells; i++, prefix += _TVEC_BIWORD_SIZE_) {
+        for (i = TVEC_NEXT_CELL(diffs, 0); i < TVEC_CELLS(diffs); i = TVEC_NEXT_CELL(diffs, i + 1)) {
+            prefix = i * _TVEC_BIWORD_SIZE_;
             while (diffs->cell[i] != 0L) {
                 register int pos, proc_id;
 
@@ -259,23 +322,7 @@ void PWFCombQueueEnqueue(PWFCombQueueStruct *queue, PWFCombQueueThreadState *th_
                 node = (Node *)node->next;
                 node->next = NULL;
                 node->val = queue->ERequest[proc_id].arg;
-
-                uint64_t new_item_ptr;
-                bool found = false;
-                int k;
-
-                new_item_ptr = (uint64_t)node & NEG_NVMEM_CACHE_LINE_SIZE;
-                for (k = 0; k < clNewItems_size; k++) {
-                    if (new_item_ptr == (uint64_t)clNewItems[k]) {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found) {
-                    clNewItems[clNewItems_size] = (void *)(new_item_ptr);
-                    clNewItems_size++;
-                }
-
+                synchLineSetInsert(&new_lines, node);
             }
         }
 
@@ -283,60 +330,51 @@ void PWFCombQueueEnqueue(PWFCombQueueStruct *queue, PWFCombQueueThreadState *th_
         lsp_data->last = llist;
         lsp_data->tail = node;
         TVEC_COPY(&lsp_data->deactivate, l_activate);
-        TVEC_REVERSE_BIT(&lsp_data->index, pid);
 
         new_sp.struct_data.seq = old_sp.struct_data.seq + 1;
         new_sp.struct_data.index = local_index;
 
-        for (i = 0; i < clNewItems_size; i++) {
-            if (old_sp.raw_data != queue->Epstate->S.raw_data)
+        for (i = 0; i < new_lines.size; i++) {
+            if (!PWFCombEqualPointers(old_sp, &queue->Epstate->S))
                 break;
-            synchFlushPersistentMemory((void *)clNewItems[i], NVMEM_CACHE_LINE_SIZE);
+            synchFlushPersistentMemory((void *)new_lines.lines[i], SYNCH_LINESET_LINE_SIZE);
         }
         
-        if (old_sp.raw_data == queue->Epstate->S.raw_data) {
-            synchFlushPersistentMemory(lsp_data, PWFCombQueueEnqStateSize(queue->nthreads));
-            synchDrainPersistentMemory();
+        if (PWFCombEqualPointers(old_sp, &queue->Epstate->S)) {
+            synchPersistRange(lsp_data, PWFCombQueueEnqStateSize(queue->nthreads));
 
-            if (!l_val%2) {
+            // an odd epoch indicates that the pointer to lsp_data is not yet persisted
+            if (l_val % 2 == 0)
                 l_val++;
-            } 
-            else {
-                l_val+=2;
-            }
+            else
+                l_val += 2;
+            queue->Erounds[local_index]->epoch = l_val;
             *queue->Eflush[new_sp.struct_data.index/LOCAL_POOL_SIZE] = l_val;
 
-            for (i = 0, prefix = 0; i < th_state->diffs_copy.tvec_cells; i++, prefix += _TVEC_BIWORD_SIZE_) {
-                while (th_state->diffs_copy.cell[i] != 0L) {
-                    register int pos, proc_id;
-                    pos = synchBitSearchFirst(th_state->diffs_copy.cell[i]);
-                    proc_id = prefix + pos;
-                    th_state->diffs_copy.cell[i] ^= ((bitword_t)1) << pos;
-                    queue->Ecomb_round[pid][proc_id] = l_val;
-                }
-            }
-
-            if (old_sp.raw_data == queue->Epstate->S.raw_data && synchCAS64(&queue->Epstate->S, old_sp.raw_data, new_sp.raw_data)) {
+            if (PWFCombEqualPointers(old_sp, &queue->Epstate->S) && PWFCombCASPointer(&queue->Epstate->S, old_sp, new_sp)) {
                 EnqLinkQueue(queue, lsp_data);
-                synchFlushPersistentMemory((void *)&queue->Epstate->S, sizeof(uint64_t));
-                synchDrainPersistentMemory();
+                synchPersistRange((void *)&queue->Epstate->S, sizeof(pointer_t));
                 synchCAS64(queue->Eflush[new_sp.struct_data.index/LOCAL_POOL_SIZE], l_val, l_val+1);
-                th_state->backoff = (th_state->backoff >> 1) | 1;
+                queue->reservations[pid].epoch = PWFCOMB_QUEUE_QUIESCENT;
                 return;
             }
-        } else {
-            if (th_state->backoff < queue->MAX_BACK) th_state->backoff <<= 1;
-            synchRollback(&th_state->pool_node, enq_counter);
         }
+        // the nodes of an unsuccessful combining round were never reachable by any other thread
+#ifdef SYNCH_POOL_NODE_RECYCLING_DISABLE
+        synchRollback(&th_state->pool_node, enq_counter);
+#else
+        recycleList(&th_state->pool_node, llist, enq_counter);
+#endif
     }
 
     curr_pool_index = queue->Epstate->S.struct_data.index;
     l_val = *queue->Eflush[curr_pool_index/LOCAL_POOL_SIZE];
-    if (l_val%2 == 1 && l_val == queue->Ecomb_round[curr_pool_index/LOCAL_POOL_SIZE][pid]) {
-        synchFlushPersistentMemory((void *)&queue->Epstate->S, sizeof(uint64_t));
-        synchDrainPersistentMemory();
+    // persist the pointer only if the round that served this thread has not persisted it yet
+    if (l_val%2 == 1 && l_val == queue->Erounds[curr_pool_index]->epoch && TVEC_IS_SET(&queue->Erounds[curr_pool_index]->served, pid)) {
+        synchPersistRange((void *)&queue->Epstate->S, sizeof(pointer_t));
         synchCAS64(queue->Eflush[curr_pool_index/LOCAL_POOL_SIZE], l_val, l_val+1);
     }
+    queue->reservations[pid].epoch = PWFCOMB_QUEUE_QUIESCENT;
 
     return;
 }
@@ -348,62 +386,64 @@ RetVal PWFCombQueueDequeue(PWFCombQueueStruct *queue, PWFCombQueueThreadState *t
     int i, j, prefix;
     pointer_t old_sp, new_sp;
     volatile Node *node;
+#ifndef SYNCH_POOL_NODE_RECYCLING_DISABLE
+    Node *old_head;
+#endif
     int curr_pool_index;
     uint64_t l_val;
+    RetVal ret;
 
-    if (fad_division_dequeue == -1) {
-        fad_division_dequeue = numa_node_of_cpu(synchGetPreferedCore()) % _SIM_PERSISTENT_FAD_DIVISIONS_;
-        if (fad_division_dequeue == -1) fad_division_dequeue = 0;
+    if (th_state->fad_division == -1) {                                                   // the first operation of the thread
+        th_state->fad_division = PWFCombFADDivisionOfThread(queue->fad_divisions);
+        synchInitTimedBackoff(&th_state->backoff, queue->MAX_BACK);
     }
+    synchTimedBackoffTune(&th_state->backoff);
 
     if (!queue->DRequest[pid].valid) {
         queue->DRequest[pid].valid = 1;
     }
+    queue->reservations[pid].epoch = queue->reclaim_epoch;
     synchFullFence();                             
 
     int mybank = TVEC_GET_BANK_OF_BIT(pid, queue->nthreads);
     TVEC_NEGATIVE_BANK(&th_state->deq_index, &th_state->deq_index, mybank);
-    TVEC_ATOMIC_ADD_BANK(&queue->activate_deq[fad_division_dequeue], &th_state->deq_index, mybank); // toggle pid's bit in activate_deq, Fetch&Add acts as a full write-barrier
+    TVEC_ATOMIC_ADD_BANK(&queue->activate_deq[th_state->fad_division], &th_state->deq_index, mybank); // toggle pid's bit in activate_deq, Fetch&Add acts as a full write-barrier
 
     if (!synchIsSystemOversubscribed()) { 
-        volatile int k;
-        int backoff_limit;
-
         if (synchFastRandomRange(1, queue->nthreads) > 1) {
-            backoff_limit =  synchFastRandomRange(th_state->backoff >> 1, th_state->backoff);
-            for (k = 0; k < backoff_limit; k++)
-                ;
+            synchTimedBackoffDelay(&th_state->backoff);
         }
     } else if (synchFastRandomRange(1, queue->nthreads) > 4) {
         synchResched();
     }
 
     for (j = 0; j < 2; j++) {
-        old_sp = queue->Dpstate->S;
+        old_sp = PWFCombLoadPointer(&queue->Dpstate->S);
         sp_data = queue->DState[old_sp.struct_data.index];
-        TVEC_XOR_BANKS(diffs, &queue->activate_deq[fad_division_dequeue], &sp_data->deactivate, mybank);                               // determine the set of active processes
+        TVEC_XOR_BANKS(diffs, &queue->activate_deq[th_state->fad_division], &sp_data->deactivate, mybank);                               // determine the set of active processes
         l_val = *queue->Dflush[old_sp.struct_data.index/LOCAL_POOL_SIZE]; 
-        if (old_sp.raw_data != queue->Dpstate->S.raw_data)
+        if (!PWFCombEqualPointers(old_sp, &queue->Dpstate->S))
             continue;
         if (!TVEC_IS_SET(diffs, pid))                                                           // if the operation has already been deactivate return
             break;
 
-        uint64_t local_index = pid * LOCAL_POOL_SIZE + TVEC_IS_SET(&sp_data->index, pid);
+        uint64_t local_index = PWFCombNextLocalIndex(&th_state->deq_local_index, pid, old_sp.struct_data.index);
         lsp_data = queue->DState[local_index];
         DeqStateCopy(lsp_data, sp_data);
+#ifndef SYNCH_POOL_NODE_RECYCLING_DISABLE
+        old_head = lsp_data->head;
+#endif
 
-        TVEC_SET_ZERO(l_activate);
-        for (i = 0; i < _SIM_PERSISTENT_FAD_DIVISIONS_; i++) {
-            TVEC_OR(l_activate, l_activate, (ToggleVector *)&queue->activate_deq[i]);            // This is an atomic read, since activate_deq is volatile
-        }
+        TVEC_OR_REDUCE(l_activate, (ToggleVector *)queue->activate_deq, queue->fad_divisions);            // This is an atomic read, since activate_deq is volatile
 
-        if (old_sp.raw_data != queue->Dpstate->S.raw_data)
+        if (!PWFCombEqualPointers(old_sp, &queue->Dpstate->S))
             continue;
 
         TVEC_XOR(diffs, &lsp_data->deactivate, l_activate);
-        TVEC_COPY(&th_state->diffs_copy, diffs);
+        TVEC_COPY(&queue->Drounds[local_index]->served, diffs);
         DeqLinkQueue(queue, lsp_data);
-        for (i = 0, prefix = 0; i < diffs->tvec_cells; i++, prefix += _TVEC_BIWORD_SIZE_) {
+        for (i = TVEC_NEXT_CELL(diffs, 0); i < TVEC_CELLS(diffs); i = TVEC_NEXT_CELL(diffs, i + 1)) {
+            prefix = i * _TVEC_BIWORD_SIZE_;
             while (diffs->cell[i] != 0L) {
                 register int pos, proc_id;
 
@@ -427,51 +467,44 @@ RetVal PWFCombQueueDequeue(PWFCombQueueStruct *queue, PWFCombQueueThreadState *t
             }
         }
         TVEC_COPY(&lsp_data->deactivate, l_activate);
-        TVEC_REVERSE_BIT(&lsp_data->index, pid);
 
         new_sp.struct_data.seq = old_sp.struct_data.seq + 1;
         new_sp.struct_data.index = local_index;
 
-        if (old_sp.raw_data == queue->Dpstate->S.raw_data) {
-            synchFlushPersistentMemory(lsp_data, PWFCombQueueDeqStateSize(queue->nthreads));
-            synchDrainPersistentMemory();
+        if (PWFCombEqualPointers(old_sp, &queue->Dpstate->S)) {
+            synchPersistRange(lsp_data, PWFCombQueueDeqStateSize(queue->nthreads));
 
-            if (!l_val%2) {
+            // an odd epoch indicates that the pointer to lsp_data is not yet persisted
+            if (l_val % 2 == 0)
                 l_val++;
-            } 
-            else {
-                l_val+=2;
-            }
+            else
+                l_val += 2;
+            queue->Drounds[local_index]->epoch = l_val;
             *queue->Dflush[new_sp.struct_data.index/LOCAL_POOL_SIZE] = l_val;
 
-            for (i = 0, prefix = 0; i < th_state->diffs_copy.tvec_cells; i++, prefix += _TVEC_BIWORD_SIZE_) {
-                while (th_state->diffs_copy.cell[i] != 0L) {
-                    register int pos, proc_id;
-                    pos = synchBitSearchFirst(th_state->diffs_copy.cell[i]);
-                    proc_id = prefix + pos;
-                    th_state->diffs_copy.cell[i] ^= ((bitword_t)1) << pos;
-                    queue->Dcomb_round[pid][proc_id] = l_val;
-                }
-            }            
-
-            if (old_sp.raw_data == queue->Dpstate->S.raw_data && synchCAS64(&queue->Dpstate->S, old_sp.raw_data, new_sp.raw_data)) {                    // try to change stack->S to the value mod_dw
-                synchFlushPersistentMemory((void *)&queue->Dpstate->S, sizeof(uint64_t));
-                synchDrainPersistentMemory();
+            if (PWFCombEqualPointers(old_sp, &queue->Dpstate->S) && PWFCombCASPointer(&queue->Dpstate->S, old_sp, new_sp)) {                    // try to change stack->S to the value mod_dw
+                synchPersistRange((void *)&queue->Dpstate->S, sizeof(pointer_t));
                 synchCAS64(queue->Dflush[new_sp.struct_data.index/LOCAL_POOL_SIZE], l_val, l_val+1);
-                th_state->backoff = (th_state->backoff >> 1) | 1;
-                return lsp_data->return_val[pid];
+                ret = lsp_data->return_val[pid];
+                queue->reservations[pid].epoch = PWFCOMB_QUEUE_QUIESCENT;
+#ifndef SYNCH_POOL_NODE_RECYCLING_DISABLE
+                if (old_head != lsp_data->head)
+                    retireNodes(queue, th_state, old_head, lsp_data->head, pid);
+#endif
+                return ret;
             }
-        } else if (th_state->backoff < queue->MAX_BACK) th_state->backoff <<= 1;
+        }
     }
 
     curr_pool_index = queue->Dpstate->S.struct_data.index;
     l_val = *queue->Dflush[curr_pool_index/LOCAL_POOL_SIZE];
-    if (l_val%2 == 1 && l_val == queue->Dcomb_round[curr_pool_index/LOCAL_POOL_SIZE][pid]) {
-        synchFlushPersistentMemory((void *)&queue->Dpstate->S, sizeof(uint64_t));
-        synchDrainPersistentMemory();
+    // persist the pointer only if the round that served this thread has not persisted it yet
+    if (l_val%2 == 1 && l_val == queue->Drounds[curr_pool_index]->epoch && TVEC_IS_SET(&queue->Drounds[curr_pool_index]->served, pid)) {
+        synchPersistRange((void *)&queue->Dpstate->S, sizeof(pointer_t));
         synchCAS64(queue->Dflush[curr_pool_index/LOCAL_POOL_SIZE], l_val, l_val+1);
     }
+    ret = queue->DState[curr_pool_index]->return_val[pid];
+    queue->reservations[pid].epoch = PWFCOMB_QUEUE_QUIESCENT;
 
-
-    return queue->DState[curr_pool_index]->return_val[pid];
+    return ret;
 }
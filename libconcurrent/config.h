@@ -71,6 +71,37 @@
 /// By default, this flag is disabled.
 //#define SYNCH_POOL_NODE_RECYCLING_DISABLE
 
+/// @brief By enabling this definition, the memory areas of at least `SYNCH_HUGE_PAGE_SIZE` bytes allocated by
+/// synchGetAlignedMemory and synchGetAlignedMemoryOnNode (e.g. the blocks of the pools) are backed by huge pages,
+/// which reduces the misses of the data TLB. Explicit huge pages (i.e. MAP_HUGETLB) are used in case that they have
+/// been reserved (e.g. through /proc/sys/vm/nr_hugepages); otherwise, transparent huge pages are requested using madvise.
+/// Moreover, the persistent memory of each thread is mapped from a file of `SYNCH_PERSISTENT_DEV_PATH` at an address
+/// aligned to `SYNCH_HUGE_PAGE_SIZE`, so that a DAX file system is able to use PMD mappings. The amount of memory that
+/// is backed by huge pages is reported by synchPrintStats. Smaller allocations (e.g. announcement arrays) are served
+/// by malloc; for backing them with huge pages, the `glibc.malloc.hugetlb=1` tunable of glibc could be used.
+/// By default, this flag is disabled.
+//#define SYNCH_HUGE_PAGES
+
+/// @brief The size (in bytes) of a huge page.
+#define SYNCH_HUGE_PAGE_SIZE               (2 * 1024 * 1024)    // 2MB
+
+/// @brief The size (in bytes) of the first block of objects that each pool allocates (see pool.h). The size of each
+/// next block of a pool is doubled, until it reaches `SYNCH_POOL_MAX_BLOCK_SIZE`. Both sizes could be overridden
+/// per pool using synchPoolSetBlockSizes. In case that `SYNCH_HUGE_PAGES` is enabled, each block occupies
+/// at least a huge page.
+#ifdef SYNCH_HUGE_PAGES
+#    define SYNCH_POOL_FIRST_BLOCK_SIZE    SYNCH_HUGE_PAGE_SIZE
+#else
+#    define SYNCH_POOL_FIRST_BLOCK_SIZE    (64 * 1024)          // 64KB
+#endif
+#define SYNCH_POOL_MAX_BLOCK_SIZE          (32 * 1024 * 1024)   // 32MB
+
+/// @brief The number of nodes that the persistent objects (e.g. PBqueue, PWFqueue, PWFstack) pre-fault in the pool
+/// of each thread during its ThreadStateInit function (see synchPoolPrefault). Since each thread pre-faults its own pool,
+/// the pages are faulted in parallel and on the NUMA node of the thread, and the first operations of the object
+/// do not suffer page faults. Setting this definition to 0 disables pre-faulting.
+#define SYNCH_POOL_PREFAULT_OBJECTS        4096
+
 /// @brief By enabling this definition, the Performance Application Programming Interface (PAPI library) is used for
 /// getting performance counters during the execution of benchmarks. In this case, the PAPI library (i.e. libpapi)
 /// should be install and appropriately configured.
@@ -112,10 +143,30 @@
 /// By default, this flag is disabled.
 //#define SYNCH_DISABLE_PSYNCS
 
+/// @brief By default, the PWB and PSYNC operations of the persistent objects are implemented in-tree on x86_64 processors
+/// (see persist.h): the clwb, clflushopt or clflush instruction is selected at startup using CPUID and the write-back loops
+/// are inlined, so libpmem is not needed. By enabling this flag, the pmem_flush and pmem_drain functions of libpmem are used instead.
+/// On architectures other than x86_64, libpmem is always used. By default, this flag is disabled.
+//#define SYNCH_PERSIST_USE_LIBPMEM
+
 /// @brief This flag indicates to the Synch framework to keep statistics on the amount of PWB operations. This flag may add 
 /// some overhead to persistent data-structures. By default, this flag is enabled.
 //#define SYNCH_COUNT_PWBS
 
+/// @brief By defining this constant, the toggle vectors (see tvec.h) used by PWFcomb, PWFqueue and PWFstack are specialized
+/// at compile time for at most `SYNCH_TVEC_MAX_THREADS` threads: the number of words of each vector becomes a compile-time
+/// constant, so the loops over the words of the vectors are fully unrolled, and for 64 threads or less each vector is a
+/// single word and the bank of each thread is always 0. Initializing a toggle vector for more threads is a fatal error.
+/// Typical values are 64, 128 and 256. By default, this constant is not defined and the width of the vectors is set at runtime.
+//#define SYNCH_TVEC_MAX_THREADS 64
+
+/// @brief By default, PWFcomb, PWFqueue and PWFstack point to the most recent copy of their state using a single 64-bit word
+/// that consists of a 40-bit sequence number and a 24-bit index. In case that this flag is enabled, a 128-bit pointer that
+/// consists of a 64-bit sequence number and a 64-bit index is used instead and it is updated using a 128-bit CAS (i.e. cmpxchg16b).
+/// This lifts the limit on the size of the pools of state copies and the sequence number practically never wraps around,
+/// at the cost of a slightly more expensive CAS. By default, this flag is disabled.
+//#define SYNCH_PWFCOMB_WIDE_POINTERS
+
 
 //#define _EMULATE_FAA_
 //#define _EMULATE_SWAP_
@@ -5,9 +5,27 @@
 /// Proceedings of the fifteenth annual ACM symposium on Principles of distributed computing, 1996.
 /// Examples of usage could be found in the lock-free stack and queue implementations 
 /// (i.e. libconcurrent/concurrent/lfstack.c and libconcurrent/concurrent/msqueue.c respectively).
+///
+/// This file also exposes a time-based backoff scheme, where delays are measured in cycles of the time-stamp counter
+/// (calibrated once against the system's clock), and thus they do not depend on the frequency of the processor.
+/// The delay of the time-based scheme is tuned automatically by a simple hill-climbing controller: for each window of
+/// SYNCH_BACKOFF_TUNE_WINDOW operations, the controller measures the average cost per operation and keeps moving the
+/// delay towards the same direction as long as the cost is reduced. For combining objects, this converges to a delay that
+/// balances the combining degree against the latency that the delay adds to each operation.
 #ifndef _BACKOFF_H_
 #define _BACKOFF_H_
 
+#include <stdint.h>
+
+/// @brief The number of operations of each tuning window of the time-based backoff scheme.
+#define SYNCH_BACKOFF_TUNE_WINDOW  128
+
+/// @brief The minimum delay (in nanoseconds) of the time-based backoff scheme.
+#define SYNCH_BACKOFF_MIN_NS       20
+
+/// @brief The maximum delay (in nanoseconds) of the time-based backoff scheme, in case that no upper bound is provided.
+#define SYNCH_BACKOFF_AUTO_MAX_NS  10000
+
 /// @brief SynchBackoffStruct stores the state of an instance of the a backoff object.
 /// SynchBackoffStruct should be initialized using the synchInitBackoff function.
 typedef struct SynchBackoffStruct {
@@ -25,6 +43,20 @@ typedef struct SynchBackoffStruct {
     unsigned backoff_cap;
     /// @brief The step of the backoff scheme is 2^backoff_shift_bits - 1.
     unsigned backoff_addend;
+    /// @brief The current delay (in cycles of the time-stamp counter) of the time-based backoff scheme.
+    uint64_t delay;
+    /// @brief The minimum delay (in cycles of the time-stamp counter) of the time-based backoff scheme.
+    uint64_t delay_min;
+    /// @brief The maximum delay (in cycles of the time-stamp counter) of the time-based backoff scheme.
+    uint64_t delay_max;
+    /// @brief The direction of the next adjustment of the delay, i.e. 1 for increasing and -1 for decreasing the delay.
+    int direction;
+    /// @brief The number of operations performed in the current tuning window.
+    uint32_t window_ops;
+    /// @brief The value of the time-stamp counter at the beginning of the current tuning window.
+    uint64_t window_start;
+    /// @brief The average cost per operation (in cycles of the time-stamp counter) of the previous tuning window.
+    uint64_t last_cost;
 } SynchBackoffStruct;
 
 /// @brief This function initializes an instance of a backoff object. 
@@ -59,4 +91,28 @@ void synchBackoffReduce(SynchBackoffStruct *b);
 /// @param b A pointer to an instance of the backoff object.
 void synchBackoffIncrease(SynchBackoffStruct *b);
 
+/// @brief This function returns the number of cycles of the time-stamp counter per microsecond.
+/// The time-stamp counter is calibrated against the system's monotonic clock during the first call.
+///
+/// @return The number of cycles of the time-stamp counter per microsecond.
+uint64_t synchBackoffCyclesPerMicrosecond(void);
+
+/// @brief This function initializes an instance of the time-based backoff scheme.
+/// Each thread should use a different instance of this object for each concurrent data-structure that it accesses.
+///
+/// @param b A pointer to an instance of the backoff object.
+/// @param max_ns The maximum delay in nanoseconds. In case that max_ns is equal to 0, SYNCH_BACKOFF_AUTO_MAX_NS is used.
+void synchInitTimedBackoff(SynchBackoffStruct *b, uint64_t max_ns);
+
+/// @brief This function spins for the current delay of the time-based backoff scheme.
+///
+/// @param b A pointer to an instance of the backoff object.
+void synchTimedBackoffDelay(SynchBackoffStruct *b);
+
+/// @brief This function should be called once per completed operation. At the end of each tuning window, it adjusts
+/// the delay of the time-based backoff scheme according to the average cost per operation of the window.
+///
+/// @param b A pointer to an instance of the backoff object.
+void synchTimedBackoffTune(SynchBackoffStruct *b);
+
 #endif
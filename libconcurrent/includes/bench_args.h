@@ -5,6 +5,7 @@
 #define _BENCH_ARGS_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /// @brief BenchArgs stores the values of the command-line arguments used by the benchmarks provided by the Synch framework.
 /// BenchArgs should be initialized using the synchParseArguments function. For the default values, see the config.h file.
@@ -32,6 +33,28 @@ typedef struct SynchBenchArgs {
     uint16_t backoff_low;
     /// @brief The upper backoff bound used in the experiment.
     uint16_t backoff_high;
+    /// @brief The emulated cost (in nanoseconds) of writing back a cache line to NVM (see synchSetNVMEmulation).
+    uint32_t pwb_ns;
+    /// @brief The emulated cost (in nanoseconds) of a PSYNC per outstanding cache line (see synchSetNVMEmulation).
+    uint32_t psync_ns;
+    /// @brief The bandwidth (in MB/s) of the emulated NVM channel, or 0 for unlimited bandwidth (see synchSetNVMEmulation).
+    uint32_t nvm_bandwidth;
+    /// @brief The number of crash points tested by crash-injection benchmarks, or 0 for testing every persist event.
+    uint32_t crash_points;
+    /// @brief The number of times that recovery benchmarks recover each object, i.e. the number of samples per percentile.
+    uint32_t repetitions;
+    /// @brief The number of lanes (i.e. sub-objects) of relaxed objects, e.g. PBrelaxedqueue.
+    uint32_t lanes;
+    /// @brief The number of lanes that each removal samples in relaxed objects (2 for the power-of-two-choices heuristic).
+    uint32_t choices;
+    /// @brief True in case that relaxed objects should order their elements by global sequence numbers.
+    bool sequenced;
+    /// @brief The number of threads that only insert elements in queue benchmarks, while the rest of the threads only remove elements.
+    /// A zero value means that each thread executes pairs of insertions and removals.
+    uint32_t producers;
+    /// @brief True in case that the benchmarks of persistent combining objects should replicate the state of the object
+    /// to a mirror file (see `replica.h`).
+    bool replica;
 } SynchBenchArgs;
 
 /// @brief This function parses the command-line arguments and stores them in an BenchArgs structure.
@@ -30,9 +30,13 @@
 #define _HEAP_GET_MIN_OP       0x3000000000000000ULL
 #define _HEAP_OP_MASK          0x7000000000000000ULL
 #define _HEAP_VAL_MASK         (~(_HEAP_OP_MASK))
+// The levels of the heap are stored contiguously in the `bulk` array. Since the state does not contain any pointer
+// to itself, copies of the state (e.g. the copies maintained by persistent combining objects) are self-contained.
+#define _HEAP_LEVEL(H, L)      (&(H)->bulk[_SIZE_OF_HEAP_LEVEL(L) - 1])
 
 /// @brief HeapState stores the state of an instance of the serial heap implementation. 
-/// This heap data-structure is implemented using an array of fixed size.
+/// This heap data-structure is implemented using an array of fixed size, where the i-th level of the heap
+/// starts at position 2^i - 1 (see _HEAP_LEVEL).
 /// This struct should be initiliazed using the heapInit function.
 typedef struct HeapState {
     /// @brief The number of levels that the heap consists of.
@@ -43,8 +47,6 @@ typedef struct HeapState {
     volatile uint32_t last_used_level_pos;
     /// @brief The size of heap's last level.
     volatile uint32_t last_used_level_size;
-    /// @brief The i-th element of the array points to the i-th level of the heap.
-    HeapElement *heap_arrays[INITIAL_HEAP_LEVELS];
     /// @brief The array that stores the elements of the heap,
     HeapElement bulk[INITIAL_HEAP_SIZE];
 } HeapState;
@@ -97,17 +99,15 @@ inline static void heapInit(HeapState *heap_state) {
     heap_state->last_used_level_size = 1;
     for (i = 0; i < INITIAL_HEAP_SIZE; i++)
         heap_state->bulk[i] = EMPTY_HEAP_NODE;
-    for (i = 0; i < INITIAL_HEAP_LEVELS; i++)
-        heap_state->heap_arrays[i] = &heap_state->bulk[(1ULL << i) - 1];
 }
 
 inline static void serialCorrectDownHeap(HeapState *heap_state, uint32_t level, uint32_t pos) {
     while (level > 0) {
         uint32_t pos_div_2 = pos / 2;
-        if (heap_state->heap_arrays[level][pos] < heap_state->heap_arrays[level - 1][pos_div_2]) {
-            HeapElement tmp = heap_state->heap_arrays[level - 1][pos_div_2];
-            heap_state->heap_arrays[level - 1][pos_div_2] = heap_state->heap_arrays[level][pos];
-            heap_state->heap_arrays[level][pos] = tmp;
+        if (_HEAP_LEVEL(heap_state, level)[pos] < _HEAP_LEVEL(heap_state, level - 1)[pos_div_2]) {
+            HeapElement tmp = _HEAP_LEVEL(heap_state, level - 1)[pos_div_2];
+            _HEAP_LEVEL(heap_state, level - 1)[pos_div_2] = _HEAP_LEVEL(heap_state, level)[pos];
+            _HEAP_LEVEL(heap_state, level)[pos] = tmp;
         } else {
             break;
         }
@@ -123,17 +123,17 @@ inline static void serialCorrectUpHeap(HeapState *heap_state) {
     while (level < heap_state->last_used_level) {
         uint32_t pos_left = 2 * pos;
         uint32_t pos_right = 2 * pos + 1;
-        if (heap_state->heap_arrays[level][pos] > heap_state->heap_arrays[level + 1][pos_left] || heap_state->heap_arrays[level][pos] > heap_state->heap_arrays[level + 1][pos_right]) {
+        if (_HEAP_LEVEL(heap_state, level)[pos] > _HEAP_LEVEL(heap_state, level + 1)[pos_left] || _HEAP_LEVEL(heap_state, level)[pos] > _HEAP_LEVEL(heap_state, level + 1)[pos_right]) {
 
-            if (heap_state->heap_arrays[level + 1][pos_left] > heap_state->heap_arrays[level + 1][pos_right]) {  // Go to the right
-                HeapElement tmp = heap_state->heap_arrays[level + 1][pos_right];
-                heap_state->heap_arrays[level + 1][pos_right] = heap_state->heap_arrays[level][pos];
-                heap_state->heap_arrays[level][pos] = tmp;
+            if (_HEAP_LEVEL(heap_state, level + 1)[pos_left] > _HEAP_LEVEL(heap_state, level + 1)[pos_right]) {  // Go to the right
+                HeapElement tmp = _HEAP_LEVEL(heap_state, level + 1)[pos_right];
+                _HEAP_LEVEL(heap_state, level + 1)[pos_right] = _HEAP_LEVEL(heap_state, level)[pos];
+                _HEAP_LEVEL(heap_state, level)[pos] = tmp;
                 pos = pos_right;
             } else {  // Go to the left
-                HeapElement tmp = heap_state->heap_arrays[level + 1][pos_left];
-                heap_state->heap_arrays[level + 1][pos_left] = heap_state->heap_arrays[level][pos];
-                heap_state->heap_arrays[level][pos] = tmp;
+                HeapElement tmp = _HEAP_LEVEL(heap_state, level + 1)[pos_left];
+                _HEAP_LEVEL(heap_state, level + 1)[pos_left] = _HEAP_LEVEL(heap_state, level)[pos];
+                _HEAP_LEVEL(heap_state, level)[pos] = tmp;
                 pos = pos_left;
             }
         } else {
@@ -147,19 +147,17 @@ inline static HeapElement serialDeleteMin(HeapState *heap_state) {
     HeapElement ret = serialGetMin(heap_state);
 
     if (ret != EMPTY_HEAP) {
-        if (heap_state->last_used_level_pos > 0) {
-            heap_state->last_used_level_pos -= 1;
-            heap_state->heap_arrays[0][0] = heap_state->heap_arrays[heap_state->last_used_level][heap_state->last_used_level_pos];
-            serialCorrectUpHeap(heap_state);
-        } else if (heap_state->last_used_level > 0) {
+        // In case that the last used level is empty, the previous level is full and becomes the last used level
+        if (heap_state->last_used_level_pos == 0) {
             heap_state->last_used_level -= 1;
             heap_state->last_used_level_size = _SIZE_OF_HEAP_LEVEL(heap_state->last_used_level);
-            heap_state->last_used_level_pos = heap_state->last_used_level_size - 2;
-            heap_state->heap_arrays[0][0] = heap_state->heap_arrays[heap_state->last_used_level][heap_state->last_used_level_pos];
-            serialCorrectUpHeap(heap_state);
-        } else if (heap_state->last_used_level == 0) {
-            heap_state->last_used_level_pos = 0;
+            heap_state->last_used_level_pos = heap_state->last_used_level_size;
         }
+        heap_state->last_used_level_pos -= 1;
+        _HEAP_LEVEL(heap_state, 0)[0] = _HEAP_LEVEL(heap_state, heap_state->last_used_level)[heap_state->last_used_level_pos];
+        // unused positions hold EMPTY_HEAP_NODE, so they are never moved upwards by serialCorrectUpHeap
+        _HEAP_LEVEL(heap_state, heap_state->last_used_level)[heap_state->last_used_level_pos] = EMPTY_HEAP_NODE;
+        serialCorrectUpHeap(heap_state);
     }
 
     return ret;
@@ -168,7 +166,7 @@ inline static HeapElement serialDeleteMin(HeapState *heap_state) {
 inline static HeapElement serialInsert(HeapState *heap_state, HeapElement el) {
     // Check if there is enough space inside the last level
     if (heap_state->last_used_level_pos < heap_state->last_used_level_size) {
-        heap_state->heap_arrays[heap_state->last_used_level][heap_state->last_used_level_pos] = el;
+        _HEAP_LEVEL(heap_state, heap_state->last_used_level)[heap_state->last_used_level_pos] = el;
         heap_state->last_used_level_pos += 1;
         serialCorrectDownHeap(heap_state, heap_state->last_used_level, heap_state->last_used_level_pos - 1);
         return HEAP_INSERT_SUCCESS;
@@ -176,7 +174,7 @@ inline static HeapElement serialInsert(HeapState *heap_state, HeapElement el) {
         heap_state->last_used_level_size *= 2;
         heap_state->last_used_level += 1;
         heap_state->last_used_level_pos = 1;
-        heap_state->heap_arrays[heap_state->last_used_level][0] = el;
+        _HEAP_LEVEL(heap_state, heap_state->last_used_level)[0] = el;
         serialCorrectDownHeap(heap_state, heap_state->last_used_level, heap_state->last_used_level_pos - 1);
         return HEAP_INSERT_SUCCESS;
     } else {  // out of space, we need to allocate more levels
@@ -188,7 +186,7 @@ inline static HeapElement serialInsert(HeapState *heap_state, HeapElement el) {
 }
 
 inline static HeapElement serialGetMin(HeapState *heap_state) {
-    if (heap_state->last_used_level != 0 && heap_state->last_used_level_pos != 0) return heap_state->heap_arrays[0][0];
+    if (heap_state->last_used_level != 0 || heap_state->last_used_level_pos != 0) return _HEAP_LEVEL(heap_state, 0)[0];
     return EMPTY_HEAP;
 }
 
@@ -198,7 +196,7 @@ inline static void serialDisplay(HeapState *heap_state) {
 
     for (i = 0; i <= heap_state->last_used_level; i++) {
         for (j = 0; j < _SIZE_OF_HEAP_LEVEL(i); j++) {
-            if (heap_state->heap_arrays[i][j] >= 0) printf("  %ld  ", heap_state->heap_arrays[i][j]);
+            if (_HEAP_LEVEL(heap_state, i)[j] >= 0) printf("  %ld  ", _HEAP_LEVEL(heap_state, i)[j]);
         }
         printf("\n");
     }
@@ -0,0 +1,119 @@
+/// @file lineset.h
+/// @brief This file exposes a small set of cache lines that is used by the combiners of the persistent objects for
+/// deduplicating the write-backs (PWBs) of the nodes that they create during a combining round.
+/// Each line of the set has a counter of the nodes of the round that it contains and are still part of the object;
+/// a line whose counter drops to 0 is not written back (e.g. in case that a node pushed by a round is popped by the same round).
+/// The lines are kept in insertion order in a dense array, while an open-addressed hash table maps each line
+/// to its entry of the array. Thus, insertions, look-ups and removals cost O(1), while resetting, iterating and
+/// flushing the set cost O(k), where k is the number of lines of the set.
+#ifndef _LINESET_H_
+#define _LINESET_H_
+
+#include <stdint.h>
+#include <primitives.h>
+
+/// @brief The size (in bytes) of the cache lines that are written back to persistent memory.
+#define SYNCH_LINESET_LINE_SIZE 64
+
+/// @brief SynchLineSet stores an instance of a set of cache lines.
+/// SynchLineSet should be initialized using the synchLineSetInit function.
+typedef struct SynchLineSet {
+    /// @brief The lines of the set in insertion order, i.e. lines[0], ..., lines[size - 1].
+    uintptr_t *lines;
+    /// @brief counts[i] is the number of nodes that line lines[i] contains.
+    int64_t *counts;
+    /// @brief slots[i] is the slot of `table` that points to lines[i].
+    uint32_t *slots;
+    /// @brief An open-addressed hash table with `capacity` slots; each slot stores the index of a line plus 1, or 0 in case that it is empty.
+    uint32_t *table;
+    /// @brief The number of lines of the set.
+    uint32_t size;
+    /// @brief The maximum number of lines that the set stores before it is expanded.
+    uint32_t max_lines;
+    /// @brief The number of slots of `table`, which is a power of 2 and at least twice as large as `max_lines`.
+    uint32_t capacity;
+} SynchLineSet;
+
+/// @brief This function initializes a set of cache lines.
+/// @param set A pointer to the set.
+/// @param max_lines The expected maximum number of lines of the set, e.g. the maximum number of nodes that a combining round creates.
+/// The set is expanded in case that more lines are inserted.
+void synchLineSetInit(SynchLineSet *set, uint32_t max_lines);
+
+/// @brief This function doubles the maximum number of lines of a set. It is called by synchLineSetInsert whenever the set is full.
+/// @param set A pointer to the set.
+void synchLineSetExpand(SynchLineSet *set);
+
+/// @brief This function frees the memory allocated by a set of cache lines.
+/// @param set A pointer to the set.
+void synchLineSetDestroy(SynchLineSet *set);
+
+inline static uint32_t _synchLineSetHash(SynchLineSet *set, uintptr_t line) {
+    return (uint32_t)(((line / SYNCH_LINESET_LINE_SIZE) * 0x9E3779B97F4A7C15ULL) >> 32) & (set->capacity - 1);
+}
+
+/// @brief This function removes all the lines of a set.
+/// @param set A pointer to the set.
+static inline void synchLineSetReset(SynchLineSet *set) {
+    uint32_t i;
+
+    for (i = 0; i < set->size; i++)
+        set->table[set->slots[i]] = 0;
+    set->size = 0;
+}
+
+/// @brief This function inserts the cache line of `ptr` to a set, and increases the counter of the line by 1.
+/// @param set A pointer to the set.
+/// @param ptr A pointer to a node.
+static inline void synchLineSetInsert(SynchLineSet *set, volatile void *ptr) {
+    uintptr_t line = (uintptr_t)ptr & ~((uintptr_t)SYNCH_LINESET_LINE_SIZE - 1);
+    uint32_t slot, index;
+
+    for (slot = _synchLineSetHash(set, line); set->table[slot] != 0; slot = (slot + 1) & (set->capacity - 1)) {
+        index = set->table[slot] - 1;
+        if (set->lines[index] == line) {
+            set->counts[index]++;
+            return;
+        }
+    }
+    if (set->size == set->max_lines) {
+        synchLineSetExpand(set);
+        synchLineSetInsert(set, ptr);
+        return;
+    }
+    index = set->size++;
+    set->lines[index] = line;
+    set->counts[index] = 1;
+    set->slots[index] = slot;
+    set->table[slot] = index + 1;
+}
+
+/// @brief This function decreases by 1 the counter of the cache line of `ptr`, in case that this line is part of the set.
+/// @param set A pointer to the set.
+/// @param ptr A pointer to a node.
+static inline void synchLineSetRelease(SynchLineSet *set, volatile void *ptr) {
+    uintptr_t line = (uintptr_t)ptr & ~((uintptr_t)SYNCH_LINESET_LINE_SIZE - 1);
+    uint32_t slot, index;
+
+    for (slot = _synchLineSetHash(set, line); set->table[slot] != 0; slot = (slot + 1) & (set->capacity - 1)) {
+        index = set->table[slot] - 1;
+        if (set->lines[index] == line) {
+            set->counts[index]--;
+            return;
+        }
+    }
+}
+
+/// @brief This function writes back (PWB) all the lines of a set with a positive counter.
+/// The write-backs are not guaranteed to be completed before a subsequent synchDrainPersistentMemory.
+/// @param set A pointer to the set.
+static inline void synchLineSetFlush(SynchLineSet *set) {
+    uint32_t i;
+
+    for (i = 0; i < set->size; i++) {
+        if (set->counts[i] > 0)
+            synchFlushPersistentMemory((void *)set->lines[i], SYNCH_LINESET_LINE_SIZE);
+    }
+}
+
+#endif
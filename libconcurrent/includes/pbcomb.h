@@ -10,12 +10,23 @@
 #ifndef _PBCOMB_H_
 #define _PBCOMB_H_
 
+#include <string.h>
+
 #include "config.h"
 #include "primitives.h"
+#include "replica.h"
+#include "threadtools.h"
 
 /// @brief The size of a pool of states that each running thread maintains.
 #define PBCOMB_POOL_SIZE  2
 
+/// @brief The maximum number of passes over the announced requests that a combiner performs in a single combining round.
+#define PBCOMB_COMBINING_ROUNDS  20
+
+/// @brief The number of pause iterations (see synchPause) that a thread running on a different NUMA node than the latest
+/// combiner waits before trying to become the combiner, so that a thread of the node where the latest state resides is preferred.
+#define PBCOMB_REMOTE_ELECTION_SPINS  64
+
 /// @brief This struct describes a request (i.e.) to be applied to the PBcomb object.
 typedef struct PBCombRequest {
     /// @brief The arguments of the operation.
@@ -49,20 +60,28 @@ typedef struct PBCombPersistentState{
 /// @brief PBCombStruct stores the state of an instance of the a PBcomb persistent combining object.
 /// PBCombStruct should be initialized using the PBCombStructInit function.
 typedef struct PBCombStruct {
-    volatile PBCombRequest *request;
+    /// @brief An array of `numa_nodes` segments of requests. Segment n stores the requests of the threads that run on
+    /// the n-th NUMA node (in the order of `numa_ids`) and it is allocated on this node.
+    volatile PBCombRequest **request;
+    /// @brief An array of `numa_nodes + 1` integers; the requests of segment n correspond to the entries
+    /// `segment_first[n]`, ..., `segment_first[n + 1] - 1` of `numa_ids`.
+    uint32_t *segment_first;
     /// @brief A pointer to a function that may execute persistent operations 
     /// just before the releasing of the lock by the combiner (i.e. releasing the `lock` of `PBCombStruct`).
     void (*final_persist_func)(void *);
     /// @param after_persist_func A pointer to a function that may execute persistent operations
     /// just after the releasing of the lock by the combiner (i.e. releasing the `lock` of `PBCombStruct`).
     void (*after_persist_func)(void *);
+    /// @brief A pointer to an optional replication object (see `replica.h`). In case that it is not NULL,
+    /// the combiner publishes the committed state of each combining round to this object.
+    SynchReplicaStruct *replica;
     /// @brief This is an array of size `n`, where `n` is the number of runnning threads.
     /// The first entry of corresponds to thread with id 0, while the second entry corresponds to thread with 1, etc.
     /// Each entry contains the id of the numa node that the corresponding thread runs on.
     volatile uint32_t *numa_ids;
     /// @brief The number of threads that will use the PBcomb object.
     volatile uint32_t nthreads;
-    /// @brief The number of NUMA nodes that the system is equipped of.
+    /// @brief The number of NUMA nodes that the threads run on, i.e. the number of segments of `request`.
     volatile uint32_t numa_nodes;
     /// @brief The number of running threads per NUMA node.
     volatile uint32_t threads_per_node;
@@ -71,6 +90,8 @@ typedef struct PBCombStruct {
     /// @brief This is an integer lock that allows a single combiner to serve requests at each point in time.
     volatile uint32_t lock CACHE_ALIGN;
     volatile uint64_t lock_value CACHE_ALIGN;
+    /// @brief The NUMA node of the latest combiner, i.e. the node where the latest state resides.
+    volatile uint32_t last_node;
     /// @brief A pointer to the latest valid, persisted state of the simulated object.
     /// For performance reasons, we use a pool of PBCOMB_POOL_SIZE * `n` such states instead of 2 in the paper
     /// (`n` is the number of threads).
@@ -87,8 +108,10 @@ typedef struct PBCombStruct {
 typedef struct PBCombThreadState {
     /// @brief The NUMA node of the current thread.
     uint32_t numa_node;
-    /// @brief The id of the NUMA node of the current thread.
+    /// @brief The index of the current thread in the order of `numa_ids`, i.e. the entry of the thread in the arrays of the state.
     uint32_t numa_id;
+    /// @brief A pointer to the request of the current thread in the segment of its NUMA node.
+    volatile PBCombRequest *request;
     /// @brief An index to the latest copy of the object's state used by this thread (as a combiner).
     uint32_t pool_index;                           // Bit MIndex
     /// @brief A pool PBCOMB_POOL_SIZE states per thread. This pool is used whenever this thread acts as a combiner.
@@ -127,6 +150,16 @@ void PBCombSetFinalPersist(PBCombStruct *l, void (*final_persist_func)(void *));
 /// just after the releasing of the lock by the combiner (i.e. releasing the `lock` of `PBCombStruct`).
 void PBCombSetAfterPersist(PBCombStruct *l, void (*after_persist_func)(void *));
 
+/// @brief This function attaches a replication object (see `replica.h`) to an instance of PBcomb.
+/// After each committed combining round and after releasing object's lock, the combiner publishes
+/// a copy of the `state_size` bytes of the new state to the replication object. The shipper thread
+/// of the replication object applies the published states to a mirror object asynchronously.
+///
+/// @param l A pointer to an instance of the PBcomb persistent combining object.
+/// @param replica A pointer to an initialized replication object with state size equal to `state_size` of PBcomb,
+/// or NULL for disabling replication.
+void PBCombSetReplica(PBCombStruct *l, SynchReplicaStruct *replica);
+
 /// @brief This function should be called once before the thread applies any operation to the PBcomb object.
 ///
 /// @param l A pointer to an instance of the PBcomb persistent combining object.
@@ -144,4 +177,135 @@ void PBCombThreadStateInit(PBCombStruct *l, PBCombThreadState *st_thread, int pi
 /// @return RetVal The return value of the applied request.
 RetVal PBCombApplyOp(PBCombStruct *l, PBCombThreadState *st_thread, RetVal (*sfunc)(void *, ArgVal, int), ArgVal arg, int pid);
 
+/// @brief This function contains the actual implementation of PBCombApplyOp. It is always inlined, thus in case that
+/// the serial function, the persist functions and the state size are compile-time constants, the compiler calls the serial
+/// and the persist functions directly (or inlines them) and constant-folds the sizes of the copies and flushes of the state.
+/// It should not be called directly; PBCombApplyOp and the functions generated by PBCOMB_DEFINE_OBJECT are built on top of it.
+///
+/// @param s A pointer to an instance of the PBcomb persistent combining object.
+/// @param st_thread A pointer to thread's local state for a specific instance of PBcomb object.
+/// @param sfunc A serial function that the PBcomb instance should execute, while applying requests announced by active threads.
+/// @param final_persist_func A function that is called just before releasing object's lock, or NULL.
+/// @param after_persist_func A function that is called just after persisting the new state, or NULL.
+/// @param state_size The size (in bytes) of simulated object's state; it should be equal to `state_size` of `s`.
+/// @param arg The argument of the request that the thread wants to apply.
+/// @param pid The pid of the calling thread.
+/// @return RetVal The return value of the applied request.
+static inline __attribute__((always_inline)) RetVal PBCombApplyOpTemplate(PBCombStruct *s, PBCombThreadState *st_thread,
+                                                                          RetVal (*sfunc)(void *, ArgVal, int),
+                                                                          void (*final_persist_func)(void *),
+                                                                          void (*after_persist_func)(void *),
+                                                                          uint32_t state_size, ArgVal arg, int pid) {
+    int i, j, k, n;
+    uint64_t round;
+    bool deferred = false;
+
+    st_thread->request->arg = arg;
+    st_thread->request->activate = 1 - st_thread->request->activate;
+    if (!st_thread->request->valid) {
+        st_thread->request->valid = 1;
+    }
+    synchFullFence();
+
+    while (true) {
+        int32_t lock_value = s->lock;
+
+        if (lock_value % 2 == 0) {
+            // a combiner of the NUMA node of the latest state copies and updates it locally, thus it is preferred
+            if (!deferred && st_thread->numa_node != s->last_node) {
+                deferred = true;
+                for (k = 0; k < PBCOMB_REMOTE_ELECTION_SPINS && s->lock == lock_value; k++)
+                    synchPause();
+                continue;
+            }
+            if (synchCAS32(&s->lock, lock_value, lock_value + 1)) {
+                break;
+            }
+            lock_value++;
+        } else {
+            while(s->lock == lock_value)
+                synchResched();
+
+            volatile PBCombStateRec *last_state = s->pstate->last_state;
+            if (last_state->deactivate[st_thread->numa_id] == st_thread->request->activate) {
+                if (s->lock_value == lock_value)
+                    return last_state->return_value[st_thread->numa_id];
+                while (s->lock == lock_value+2)
+                    synchResched();
+                return last_state->return_value[st_thread->numa_id];
+            }
+        }
+    }
+
+#ifdef DEBUG
+     s->rounds += 1;
+#endif
+    volatile PBCombStateRec *new_state = st_thread->pool[st_thread->pool_index];
+    memcpy((void *)new_state->flex, (void *)s->pstate->last_state->flex, 
+           state_size + s->nthreads * sizeof(RetVal) + s->nthreads * sizeof(bool));
+
+    for (i=0; i < PBCOMB_COMBINING_ROUNDS; i++) {
+        uint64_t serve_reqs = 0;
+
+        for (n = 0, j = 0; n < s->numa_nodes; n++) {
+            volatile PBCombRequest *request = s->request[n];
+
+            for (k = 0; j < s->segment_first[n + 1]; j++, k++) {
+                if (new_state->deactivate[j] != request[k].activate && request[k].valid == 1) {
+                    new_state->return_value[j] = sfunc((void *)new_state->state, request[k].arg, j);
+                    new_state->deactivate[j] = request[k].activate;
+                    serve_reqs++;
+#ifdef DEBUG
+                    s->counter += 1;
+#endif
+                }
+            }
+        }
+        if (serve_reqs == 0)
+            break;
+    }
+
+    if (final_persist_func != NULL) {
+        final_persist_func((void *)s);
+    }
+
+    synchPersistRange((void *)new_state->flex, state_size + s->nthreads * sizeof(RetVal) + s->nthreads * sizeof(bool));
+
+    s->lock_value = s->lock;
+    s->last_node = st_thread->numa_node;
+    s->pstate->last_state = new_state;
+
+    synchPersistRange((void *)s->pstate, sizeof(PBCombPersistentState));
+
+    if (after_persist_func != NULL) {
+        after_persist_func((void *)s);
+    }
+
+    st_thread->pool_index = (st_thread->pool_index + 1) % PBCOMB_POOL_SIZE;
+    round = (s->lock + 1) / 2;
+    s->lock += 1;
+    synchFullFence();
+
+    // new_state is not reused before this thread acts twice more as a combiner,
+    // thus it is safe to replicate it after releasing the lock.
+    if (s->replica != NULL) {
+        synchReplicaAppend(s->replica, round, (void *)new_state->state);
+    }
+
+    return new_state->return_value[st_thread->numa_id];
+}
+
+/// @brief This macro generates a function named `name##ApplyOp` that applies operations to a PBcomb instance
+/// whose state is of type `state_t` and is modified by the serial function `sfunc`. The generated function has the same
+/// semantics as PBCombApplyOp, but `sfunc`, `final_persist_func` and `after_persist_func` are not called through the function
+/// pointers stored in PBCombStruct and the size of the state is known at compile time. The persist functions may be NULL;
+/// in this case, the persist functions set by PBCombSetFinalPersist and PBCombSetAfterPersist are ignored.
+/// The generated function has the following prototype:
+/// `static RetVal name##ApplyOp(PBCombStruct *l, PBCombThreadState *st_thread, ArgVal arg, int pid)`.
+/// The PBcomb instance should be initialized by PBCombStructInit with `state_size` equal to `sizeof(state_t)`.
+#define PBCOMB_DEFINE_OBJECT(name, state_t, sfunc, final_persist_func, after_persist_func)                                    \
+    static RetVal name##ApplyOp(PBCombStruct *l, PBCombThreadState *st_thread, ArgVal arg, int pid) {                       \
+        return PBCombApplyOpTemplate(l, st_thread, sfunc, final_persist_func, after_persist_func, sizeof(state_t), arg, pid);\
+    }
+
 #endif
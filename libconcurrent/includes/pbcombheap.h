@@ -54,7 +54,8 @@ void PBCombHeapThreadStateInit(PBCombHeapStruct *heap_struct, PBCombHeapThreadSt
 ///  @param lobject_struct A pointer to thread's local state of PBheap.
 ///  @param arg The value of the element that will be inserted in the heap.
 ///  @param pid The pid of the calling thread.
-void PBCombHeapInsert(PBCombHeapStruct *heap_struct, PBCombHeapThreadState *lobject_struct, HeapElement arg, int pid);
+///  @return HEAP_INSERT_SUCCESS in case that the element is inserted, or HEAP_INSERT_FAIL in case that the heap is full.
+RetVal PBCombHeapInsert(PBCombHeapStruct *heap_struct, PBCombHeapThreadState *lobject_struct, HeapElement arg, int pid);
 
 ///  @brief This function removes the element of the heap that has the minimum value.
 ///  
@@ -72,4 +73,12 @@ HeapElement PBCombHeapDeleteMin(PBCombHeapStruct *heap_struct, PBCombHeapThreadS
 ///  @return The value of the minimum element contained in the heap. In case that the heap is empty `EMPTY_HEAP` is returned. 
 HeapElement PBCombHeapGetMin(PBCombHeapStruct *heap_struct, PBCombHeapThreadState *lobject_struct, int pid);
 
+///  @brief This function returns the minimum value of the latest persisted state of the heap without applying an operation,
+///  i.e. it does not announce a request and it does not write to shared memory. The returned value may be stale,
+///  since the state may change concurrently, thus this function is only a cheap hint (e.g. for choosing among several heaps).
+///  
+///  @param heap_struct A pointer to an instance of the PBheap persistent heap implementation.
+///  @return The value of the minimum element of the heap, or `EMPTY_HEAP` in case that the heap seems to be empty.
+HeapElement PBCombHeapPeekMin(PBCombHeapStruct *heap_struct);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+/// @file pbcombmultiqueue.h
+/// @brief This file exposes the API of the PBmultiqueue, which is a persistent priority queue with relaxed semantics
+/// in the style of MultiQueues. The priority queue consists of a number of PBheap instances (see `pbcombheap.h`),
+/// usually a small multiple of the number of threads. Since each heap has its own combiner, operations on different
+/// heaps are served in parallel.
+///
+/// An insert adds its element to a heap chosen at random. A delete-min samples `choices` heaps at random
+/// (the power-of-two-choices heuristic for `choices` equal to 2), compares their minimum elements using
+/// PBCombHeapPeekMin, which only reads the latest persisted state of a heap, and removes the minimum element
+/// of the heap with the smallest one. Thus, a delete-min does not always return the minimum element of the
+/// priority queue, but an element of small rank. The capacity of each heap is fixed (see `INITIAL_HEAP_LEVELS`),
+/// so the capacity of the priority queue is `nheaps` times the capacity of a PBheap.
+///
+/// For a more detailed description of MultiQueues see:
+/// Hamza Rihani, Peter Sanders, and Roman Dementiev. "MultiQueues: Simple Relaxed Concurrent Priority Queues".
+/// ACM Symposium on Parallelism in Algorithms and Architectures (SPAA) 2015.
+/// An example of use of this API is provided in benchmarks/pbcombmultiqueuebench.c file.
+#ifndef _PBCOMBMULTIQUEUE_H_
+#define _PBCOMBMULTIQUEUE_H_
+
+#include <pbcombheap.h>
+#include <config.h>
+#include <primitives.h>
+#include <fastrand.h>
+
+/// @brief PBCombMultiQueueStruct stores the state of an instance of the PBmultiqueue persistent priority queue implementation.
+/// PBCombMultiQueueStruct should be initialized using the PBCombMultiQueueInit function.
+typedef struct PBCombMultiQueueStruct {
+    /// @brief An array of `nheaps` instances of PBheap.
+    PBCombHeapStruct *heaps;
+    /// @brief The number of heaps.
+    uint32_t nheaps;
+    /// @brief The number of heaps sampled by each delete-min.
+    uint32_t choices;
+} PBCombMultiQueueStruct;
+
+/// @brief PBCombMultiQueueThreadState stores each thread's local state for a single instance of PBmultiqueue.
+/// For each instance of PBmultiqueue, a discrete instance of PBCombMultiQueueThreadState should be used.
+typedef struct PBCombMultiQueueThreadState {
+    /// @brief An array of `nheaps` PBCombHeapThreadState structs, one for each heap.
+    PBCombHeapThreadState *heaps;
+} PBCombMultiQueueThreadState;
+
+/// @brief This function initializes an instance of the PBmultiqueue persistent priority queue implementation.
+/// This function should be called once (by a single thread) before any other thread tries to
+/// apply any operation on the priority queue.
+///
+/// @param queue A pointer to an instance of the PBmultiqueue persistent priority queue implementation.
+/// @param nthreads The number of threads that will use the PBmultiqueue persistent priority queue implementation.
+/// @param nheaps The number of heaps (i.e. instances of PBheap).
+/// @param choices The number of heaps sampled by each delete-min; it is limited to `nheaps`.
+void PBCombMultiQueueInit(PBCombMultiQueueStruct *queue, uint32_t nthreads, uint32_t nheaps, uint32_t choices);
+
+/// @brief This function should be called once by every thread before it applies any operation to the PBmultiqueue
+/// persistent priority queue implementation.
+///
+/// @param queue A pointer to an instance of the PBmultiqueue persistent priority queue implementation.
+/// @param lobject_struct A pointer to thread's local state of PBmultiqueue.
+/// @param pid The pid of the calling thread.
+void PBCombMultiQueueThreadStateInit(PBCombMultiQueueStruct *queue, PBCombMultiQueueThreadState *lobject_struct, int pid);
+
+/// @brief This function inserts a new element with value `arg` to a heap chosen at random. In case that this heap is full,
+/// the rest of the heaps are tried.
+///
+/// @param queue A pointer to an instance of the PBmultiqueue persistent priority queue implementation.
+/// @param lobject_struct A pointer to thread's local state of PBmultiqueue.
+/// @param arg The value of the element that will be inserted in the priority queue.
+/// @param pid The pid of the calling thread.
+/// @return HEAP_INSERT_SUCCESS in case that the element is inserted, or HEAP_INSERT_FAIL in case that all heaps are full.
+RetVal PBCombMultiQueueInsert(PBCombMultiQueueStruct *queue, PBCombMultiQueueThreadState *lobject_struct, HeapElement arg, int pid);
+
+/// @brief This function removes an element of small value (i.e. the minimum element of the best of `choices` heaps chosen at random).
+///
+/// @param queue A pointer to an instance of the PBmultiqueue persistent priority queue implementation.
+/// @param lobject_struct A pointer to thread's local state of PBmultiqueue.
+/// @param pid The pid of the calling thread.
+/// @return The value of the removed element. In case that all heaps are found empty, `EMPTY_HEAP` is returned.
+HeapElement PBCombMultiQueueDeleteMin(PBCombMultiQueueStruct *queue, PBCombMultiQueueThreadState *lobject_struct, int pid);
+
+#endif
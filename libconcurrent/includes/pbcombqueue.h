@@ -7,14 +7,15 @@
 /// Panagiota Fatourou, Nikolaos D. Kallimanis, and Eleftherios Kosmas. "The Performance Power of Software Combining in Persistence".
 /// ACM SIGPLAN Notices. Principles and Practice of Parallel Programming (PPoPP) 2022.
 ///  @copyright Copyright (c) 2021
-#ifndef _PERSTACK_H_
-#define _PERSTACK_H_
+#ifndef _PBCOMBQUEUE_H_
+#define _PBCOMBQUEUE_H_
 
 #include <pbcomb.h>
 #include <config.h>
 #include <primitives.h>
 #include <fastrand.h>
 #include <pool.h>
+#include <lineset.h>
 #include <queue-stack.h>
 
 /// @brief PBCombQueueStruct stores the state of an instance of the PBqueue persistent queue implementation.
@@ -34,11 +35,26 @@ typedef struct PBCombQueueStruct {
 
 /// @brief PBCombQueueThreadState stores each thread's local state for a single instance of PBqueue.
 /// For each instance of PBqueue, a discrete instance of PBCombQueueThreadState should be used.
+/// A thread may use any number of PBqueue instances, since it keeps no state for them outside of these structs.
 typedef struct PBCombQueueThreadState {
     /// @brief A PBCombThreadState struct for the instance of PBcomb that serves the enqueue operations.
     PBCombThreadState enqueue_thread_state;
     /// @brief A PBCombThreadState struct for the instance of PBcomb that serves the dequeue operations.
     PBCombThreadState dequeue_thread_state;
+    /// @brief A pointer to the instance of PBqueue that this state belongs to.
+    PBCombQueueStruct *queue;
+    /// @brief A pool of nodes that the thread uses whenever it acts as a combiner.
+    SynchPoolStruct pool_node;
+    /// @brief The cache lines modified by the current combining round of enqueues, which should be persisted.
+    SynchLineSet new_lines;
+    /// @brief The number of enqueues applied by the current combining round.
+    uint64_t enqueue_counter;
+    /// @brief The last node inserted by the current combining round.
+    Node *tail;
+    /// @brief The nodes removed by the current combining round of dequeues, which are recycled after the round is persisted.
+    Node **free_list;
+    /// @brief The number of entries of `free_list`.
+    uint64_t free_list_size;
 } PBCombQueueThreadState;
 
 /// @brief This function initializes an instance of the PBqueue persistent queue implementation.
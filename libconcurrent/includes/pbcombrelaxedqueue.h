@@ -0,0 +1,134 @@
+/// @file pbcombrelaxedqueue.h
+/// @brief This file exposes the API of the PBrelaxedqueue, which is a persistent queue with relaxed FIFO semantics.
+/// The queue consists of a number of lanes, where each lane is an instance of PBqueue (see `pbcombqueue.h`).
+/// Since each lane has its own combiners, enqueues and dequeues of different lanes are served in parallel,
+/// and thus the throughput of the queue scales with the number of lanes.
+///
+/// An enqueue inserts its element to a single lane, chosen either by the affinity of the calling thread
+/// (i.e. thread with id `pid` always uses lane `pid % nlanes`) or in a round-robin fashion.
+/// A dequeue samples `choices` lanes at random (the power-of-two-choices heuristic for `choices` equal to 2)
+/// and removes the front element of the most promising one, i.e. the lane with the most elements or,
+/// in case that the queue is sequenced, the lane whose front element is expected to be the oldest.
+/// A dequeue returns PBCOMB_RELAXED_QUEUE_EMPTY only in case that it finds all lanes empty.
+///
+/// In case that the queue is sequenced, each element carries a sequence number of PBCOMB_RELAXED_QUEUE_SEQ_BITS bits
+/// that is stored durably together with the element. The sequence numbers are taken from a per-lane counter,
+/// which is kept close to the counters of the other lanes through a coarse global epoch, so that enqueues
+/// of different lanes do not contend on a single counter. In this case, the values of the elements should be
+/// non-negative and fit in PBCOMB_RELAXED_QUEUE_VAL_BITS bits; any other value is silently truncated.
+/// Larger values of `choices` lead to an order closer to FIFO (for `choices` equal to the number of lanes,
+/// each dequeue removes the element with the smallest sequence number among the front elements of the lanes
+/// in most cases), while smaller values lead to higher throughput.
+/// An example of use of this API is provided in benchmarks/pbcombrelaxedqueuebench.c file.
+#ifndef _PBCOMBRELAXEDQUEUE_H_
+#define _PBCOMBRELAXEDQUEUE_H_
+
+#include <pbcombqueue.h>
+#include <config.h>
+#include <primitives.h>
+#include <fastrand.h>
+
+/// @brief The value returned by a dequeue in case that all lanes are empty.
+#define PBCOMB_RELAXED_QUEUE_EMPTY          -1
+
+/// @brief An enqueue inserts its element to lane `pid % nlanes`, where `pid` is the id of the calling thread.
+#define PBCOMB_RELAXED_QUEUE_AFFINITY       0
+/// @brief Each thread inserts its elements to the lanes in a round-robin fashion.
+#define PBCOMB_RELAXED_QUEUE_ROUND_ROBIN    1
+
+/// @brief The number of bits of the value of each element of a sequenced queue.
+#define PBCOMB_RELAXED_QUEUE_VAL_BITS       40
+/// @brief The number of bits of the sequence number of each element of a sequenced queue.
+/// The sequence numbers wrap around, thus they are compared modulo 2^PBCOMB_RELAXED_QUEUE_SEQ_BITS.
+/// The most significant bit of a stored element is always zero, so a stored element is never equal to PBCOMB_RELAXED_QUEUE_EMPTY.
+#define PBCOMB_RELAXED_QUEUE_SEQ_BITS       23
+#define PBCOMB_RELAXED_QUEUE_VAL_MASK       ((1ULL << PBCOMB_RELAXED_QUEUE_VAL_BITS) - 1)
+#define PBCOMB_RELAXED_QUEUE_SEQ_MASK       ((1ULL << PBCOMB_RELAXED_QUEUE_SEQ_BITS) - 1)
+/// @brief The global epoch of a sequenced queue is advanced once a lane has taken this number of sequence numbers
+/// beyond it. Larger values make enqueues update the epoch more rarely, but let the sequence numbers of different lanes
+/// drift further apart.
+#define PBCOMB_RELAXED_QUEUE_SEQ_EPOCH      64
+
+/// @brief This struct describes a lane of PBrelaxedqueue.
+typedef struct PBCombRelaxedQueueLane {
+    /// @brief The PBqueue instance of the lane.
+    PBCombQueueStruct queue;
+    /// @brief The number of completed enqueues of the lane. The difference between `enqueues` and `dequeues`
+    /// is an estimation of the number of elements of the lane, i.e. these counters are not persisted.
+    volatile uint64_t enqueues CACHE_ALIGN;
+    /// @brief The number of completed dequeues of the lane that removed an element.
+    volatile uint64_t dequeues;
+    /// @brief The counter that provides the sequence numbers of the elements of the lane (only for sequenced queues).
+    volatile uint64_t sequence;
+    /// @brief The sequence number of the latest element dequeued from the lane (only for sequenced queues).
+    volatile uint64_t head_seq;
+} PBCombRelaxedQueueLane;
+
+/// @brief PBCombRelaxedQueueStruct stores the state of an instance of the PBrelaxedqueue persistent queue implementation.
+/// PBCombRelaxedQueueStruct should be initialized using the PBCombRelaxedQueueInit function.
+typedef struct PBCombRelaxedQueueStruct {
+    /// @brief An array of `nlanes` lanes.
+    PBCombRelaxedQueueLane *lanes;
+    /// @brief The number of lanes.
+    uint32_t nlanes;
+    /// @brief The number of lanes sampled by each dequeue.
+    uint32_t choices;
+    /// @brief The policy that enqueues use for choosing a lane, i.e. PBCOMB_RELAXED_QUEUE_AFFINITY or PBCOMB_RELAXED_QUEUE_ROUND_ROBIN.
+    uint32_t policy;
+    /// @brief True in case that each element carries a sequence number.
+    bool sequenced;
+    /// @brief The coarse global epoch that the sequence numbers of all lanes follow (only for sequenced queues).
+    volatile uint64_t epoch CACHE_ALIGN;
+} PBCombRelaxedQueueStruct;
+
+/// @brief PBCombRelaxedQueueThreadState stores each thread's local state for a single instance of PBrelaxedqueue.
+/// For each instance of PBrelaxedqueue, a discrete instance of PBCombRelaxedQueueThreadState should be used.
+typedef struct PBCombRelaxedQueueThreadState {
+    /// @brief An array of `nlanes` PBCombQueueThreadState structs, one for each lane.
+    PBCombQueueThreadState *lanes;
+    /// @brief The lane where the next enqueue of the thread inserts its element (only for PBCOMB_RELAXED_QUEUE_ROUND_ROBIN).
+    uint32_t next_lane;
+    /// @brief An array of `nlanes` values of the `enqueues` counters of the lanes, as read by the first pass of a dequeue.
+    uint64_t *enqueues;
+} PBCombRelaxedQueueThreadState;
+
+/// @brief This function initializes an instance of the PBrelaxedqueue persistent queue implementation.
+/// This function should be called once (by a single thread) before any other thread tries to
+/// apply any enqueue or dequeue operation.
+///
+/// @param queue A pointer to an instance of the PBrelaxedqueue persistent queue implementation.
+/// @param nthreads The number of threads that will use the PBrelaxedqueue persistent queue implementation.
+/// @param nlanes The number of lanes (i.e. instances of PBqueue).
+/// @param choices The number of lanes sampled by each dequeue; it is limited to `nlanes`.
+/// @param policy The policy that enqueues use for choosing a lane, i.e. PBCOMB_RELAXED_QUEUE_AFFINITY or PBCOMB_RELAXED_QUEUE_ROUND_ROBIN.
+/// @param sequenced In case that it is true, each element carries a sequence number.
+void PBCombRelaxedQueueInit(PBCombRelaxedQueueStruct *queue, uint32_t nthreads, uint32_t nlanes, uint32_t choices,
+                            uint32_t policy, bool sequenced);
+
+/// @brief This function should be called once before the thread applies any operation to the PBrelaxedqueue persistent queue implementation.
+///
+/// @param queue A pointer to an instance of the PBrelaxedqueue persistent queue implementation.
+/// @param lobject_struct A pointer to thread's local state of PBrelaxedqueue.
+/// @param pid The pid of the calling thread.
+void PBCombRelaxedQueueThreadStateInit(PBCombRelaxedQueueStruct *queue, PBCombRelaxedQueueThreadState *lobject_struct, int pid);
+
+/// @brief This function adds (i.e. enqueues) a new element to the back of a lane of the queue.
+/// This element has a value equal with arg.
+///
+/// @param queue A pointer to an instance of the PBrelaxedqueue persistent queue implementation.
+/// @param lobject_struct A pointer to thread's local state of PBrelaxedqueue.
+/// @param arg The enqueue operation will insert a new element to the queue with value equal to arg.
+/// In case that the queue is sequenced, only the PBCOMB_RELAXED_QUEUE_VAL_BITS least significant bits of arg are stored,
+/// thus negative values and values wider than PBCOMB_RELAXED_QUEUE_VAL_BITS bits are silently truncated.
+/// @param pid The pid of the calling thread.
+void PBCombRelaxedQueueApplyEnqueue(PBCombRelaxedQueueStruct *queue, PBCombRelaxedQueueThreadState *lobject_struct, ArgVal arg, int pid);
+
+/// @brief This function removes (i.e. dequeues) an element from the front of a lane of the queue and returns its value.
+///
+/// @param queue A pointer to an instance of the PBrelaxedqueue persistent queue implementation.
+/// @param lobject_struct A pointer to thread's local state of PBrelaxedqueue.
+/// @param pid The pid of the calling thread.
+/// @return The value of the removed element, or PBCOMB_RELAXED_QUEUE_EMPTY in case that all lanes are empty.
+RetVal PBCombRelaxedQueueApplyDequeue(PBCombRelaxedQueueStruct *queue, PBCombRelaxedQueueThreadState *lobject_struct, int pid);
+
+#endif
@@ -7,13 +7,14 @@
 /// Panagiota Fatourou, Nikolaos D. Kallimanis, and Eleftherios Kosmas. "The Performance Power of Software Combining in Persistence".
 /// ACM SIGPLAN Notices. Principles and Practice of Parallel Programming (PPoPP) 2022.
 ///  @copyright Copyright (c) 2021
-#ifndef _PERSTACK_H_
-#define _PERSTACK_H_
+#ifndef _PBCOMBSTACK_H_
+#define _PBCOMBSTACK_H_
 
 #include <pbcomb.h>
 #include <config.h>
 #include <primitives.h>
 #include <pool.h>
+#include <lineset.h>
 #include <queue-stack.h>
 
 /// @brief PBCombStackStruct stores the state of an instance of the PBstack concurrent stack implementation.
@@ -29,9 +30,21 @@ typedef struct PBCombStackStruct {
 
 /// @brief PBCombStackThreadState stores each thread's local state for a single instance of PBstack.
 /// For each instance of PBstack, a discrete instance of PBCombStackThreadState should be used.
+/// A thread may use any number of PBstack instances, since it keeps no state for them outside of these structs.
 typedef struct PBCombStackThreadState {
     /// @brief A PBCombStackThreadState struct for the instance of PBcomb that serves both push and pop operations.
     PBCombThreadState th_state;
+    /// @brief A pointer to the instance of PBstack that this state belongs to.
+    PBCombStackStruct *stack;
+    /// @brief The nodes popped by the current combining round, which are recycled after the round is persisted.
+    Node **free_list;
+    /// @brief The number of entries of `free_list`.
+    uint64_t free_list_size;
+    /// @brief The cache lines of the nodes pushed by the current combining round, which should be persisted,
+    /// together with the number of these nodes that are still in the stack per line.
+    SynchLineSet new_lines;
+    /// @brief The number of push and pop operations applied by the current combining round.
+    uint64_t push_counter, pop_counter;
 } PBCombStackThreadState;
 
 ///  @brief This function initializes an instance of the PBstack persistent stack implementation.
@@ -0,0 +1,147 @@
+/// @file persist.h
+/// @brief This file provides the persistence instructions (i.e. PWB and PSYNC operations) used by the persistent objects.
+/// On x86_64 processors, an in-tree backend is used: the instruction that writes back a cache line is chosen at startup
+/// using CPUID (i.e. clwb, clflushopt or clflush, in this order of preference) and the loop that writes back a memory
+/// range is inlined in the caller, so no call to an external library is made. In case that `SYNCH_PERSIST_USE_LIBPMEM`
+/// is defined in libconcurrent/config.h or the architecture is not x86_64, the pmem_flush and pmem_drain functions of
+/// libpmem are used instead.
+///
+/// For machines that are not equipped with NVDIMMs, this file also provides an emulation of the latency of NVM
+/// (see synchSetNVMEmulation). Whenever it is enabled, each written-back cache line costs `pwb_ns` nanoseconds,
+/// each PSYNC waits `psync_ns` nanoseconds per cache line written back by the calling thread since its previous PSYNC,
+/// and optionally, the write-backs of all threads share an emulated memory channel of limited bandwidth.
+/// The emulated delays are added on top of the cost of the actual instructions.
+/// Finally, the PWB and PSYNC operations may be recorded to a shadow image for crash-injection testing (see shadow.h).
+#ifndef _PERSIST_H_
+#define _PERSIST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <config.h>
+#include <shadow.h>
+
+#if defined(SYNCH_PERSIST_USE_LIBPMEM) || !(defined(__GNUC__) && (defined(__amd64__) || defined(__x86_64__)))
+#    define SYNCH_PERSIST_LIBPMEM
+#    include <libpmem.h>
+#endif
+
+/// @brief Cache lines are written back using the clflush instruction.
+#define SYNCH_PWB_CLFLUSH     0x0
+/// @brief Cache lines are written back using the clflushopt instruction.
+#define SYNCH_PWB_CLFLUSHOPT  0x1
+/// @brief Cache lines are written back using the clwb instruction.
+#define SYNCH_PWB_CLWB        0x2
+/// @brief Cache lines are written back using the pmem_flush function of libpmem.
+#define SYNCH_PWB_LIBPMEM     0x3
+
+/// @brief The size (in bytes) of the unit written back by a single PWB instruction.
+#define SYNCH_PWB_LINE_SIZE   64
+
+/// @brief The instruction used for writing back cache lines (i.e. any of SYNCH_PWB_CLFLUSH, SYNCH_PWB_CLFLUSHOPT,
+/// SYNCH_PWB_CLWB or SYNCH_PWB_LIBPMEM). It is set once at startup, before main is called.
+extern int synch_pwb_method;
+
+/// @brief This flag is true in case that the emulation of the latency of NVM is enabled (see synchSetNVMEmulation).
+extern bool synch_nvm_emulation;
+
+#ifdef SYNCH_COUNT_PWBS
+extern __thread int64_t __executed_pwb;
+#endif
+
+/// @brief This function adds the emulated cost of writing back a memory range to the calling thread.
+/// It is called by synchFlushPersistentMemory whenever the emulation of the latency of NVM is enabled.
+///
+/// @param ptr A pointer to the memory range.
+/// @param size The size (in bytes) of the memory range.
+void synchEmulatePWB(void *ptr, size_t size);
+
+/// @brief This function adds the emulated cost of a PSYNC to the calling thread.
+/// It is called by synchDrainPersistentMemory whenever the emulation of the latency of NVM is enabled.
+void synchEmulatePSync(void);
+
+/// @brief This function writes back to persistent memory all the cache lines that contain a part of a memory range (PWB).
+/// The write-backs are not guaranteed to be completed before a subsequent synchDrainPersistentMemory.
+///
+/// @param ptr A pointer to the memory range.
+/// @param size The size (in bytes) of the memory range.
+static inline void synchFlushPersistentMemory(void *ptr, size_t size) {
+#ifdef SYNCH_COUNT_PWBS
+    __executed_pwb += (!size%64)?size/64:size/64+1;
+#endif
+
+#ifndef SYNCH_DISABLE_PWBS
+    if (synch_nvm_emulation)
+        synchEmulatePWB(ptr, size);
+    if (synch_persist_shadow)
+        synchShadowPWB(ptr, size);
+#   ifdef SYNCH_PERSIST_LIBPMEM
+    pmem_flush(ptr, size);
+#   else
+    uintptr_t line = (uintptr_t)ptr & ~((uintptr_t)SYNCH_PWB_LINE_SIZE - 1);
+    uintptr_t end = (uintptr_t)ptr + size;
+
+    switch (synch_pwb_method) {
+        case SYNCH_PWB_CLWB:
+            for (; line < end; line += SYNCH_PWB_LINE_SIZE)
+                asm volatile("clwb %0" : "+m"(*(volatile char *)line));
+            break;
+        case SYNCH_PWB_CLFLUSHOPT:
+            for (; line < end; line += SYNCH_PWB_LINE_SIZE)
+                asm volatile("clflushopt %0" : "+m"(*(volatile char *)line));
+            break;
+        default:
+            for (; line < end; line += SYNCH_PWB_LINE_SIZE)
+                asm volatile("clflush %0" : "+m"(*(volatile char *)line));
+            break;
+    }
+#   endif
+#endif
+}
+
+/// @brief This function waits until all the previous write-backs issued by synchFlushPersistentMemory are completed (PSYNC).
+static inline void synchDrainPersistentMemory(void) {
+#ifndef SYNCH_DISABLE_PSYNCS
+#   ifdef SYNCH_PERSIST_LIBPMEM
+    pmem_drain();
+#   else
+    // clflush is ordered with respect to stores, but clwb and clflushopt need a store fence
+    if (synch_pwb_method != SYNCH_PWB_CLFLUSH)
+        asm volatile("sfence" ::: "memory");
+    else
+        asm volatile("" ::: "memory");
+#   endif
+    if (synch_nvm_emulation)
+        synchEmulatePSync();
+    if (synch_persist_shadow)
+        synchShadowPSync();
+#endif
+}
+
+/// @brief This function writes back a memory range to persistent memory and waits until the write-backs are completed,
+/// i.e. it is equivalent to a call of synchFlushPersistentMemory followed by a call of synchDrainPersistentMemory.
+///
+/// @param ptr A pointer to the memory range.
+/// @param size The size (in bytes) of the memory range.
+static inline void synchPersistRange(void *ptr, size_t size) {
+    synchFlushPersistentMemory(ptr, size);
+    synchDrainPersistentMemory();
+}
+
+/// @brief This function returns a human readable name of the instruction used for writing back cache lines.
+///
+/// @return A string, e.g. "clwb", "clflushopt", "clflush" or "libpmem".
+const char *synchPersistBackendName(void);
+
+/// @brief This function enables (or disables) the emulation of the latency of NVM. It should be called once
+/// (by a single thread) before any thread applies operations to a persistent object. In case that all the
+/// parameters are equal to 0, the emulation is disabled.
+///
+/// @param pwb_ns The cost (in nanoseconds) of writing back a single cache line.
+/// @param psync_ns The cost (in nanoseconds) of a PSYNC per cache line that is still outstanding,
+/// i.e. written back by the calling thread since its previous PSYNC.
+/// @param bandwidth_mbs The bandwidth (in MB/s) of the emulated memory channel that is shared by all threads.
+/// In case that it is equal to 0, the bandwidth is not limited.
+void synchSetNVMEmulation(uint32_t pwb_ns, uint32_t psync_ns, uint32_t bandwidth_mbs);
+
+#endif
@@ -3,7 +3,9 @@
 /// This pool object gives user the ability to allocate small chunks of memory (e.g. allocatting nodes for using them in an queue or stack implementation)
 /// in a fast and efficient way. The main purpose of this pool implentation is to add minimal overheads while benchmarking concurrent data structures,
 /// such as stacks. queues, etc. This object does not provide thread-safe methods for accessing, and thus each of the running threads should use its own
-/// instance without directely accessing the pool of any other thread.
+/// instance without directely accessing the pool of any other thread. The only exception is that an object could be recycled through
+/// the pool of any thread: an object that belongs to another pool is returned to its owner pool in batches of SYNCH_POOL_REMOTE_BATCH objects,
+/// using a lock-free list that the owner drains whenever its own list of recycled objects is empty.
 #ifndef _POOL_H_
 #define _POOL_H_
 
@@ -30,6 +32,10 @@ typedef struct SynchPoolBlockMetadata {
     struct SynchPoolBlock *next;
     /// @brief The previous block of objects.
     struct SynchPoolBlock *back;
+    /// @brief The size of the block (in bytes), including its metadata.
+    uint64_t size;
+    /// @brief The metadata occupy a whole cache line, so that the objects of the block are aligned to cache lines.
+    uint64_t pad[3];
 } SynchPoolBlockMetadata;
 
 /// @brief This struct stores the metadata of the block and all the objects of the block.
@@ -40,12 +46,50 @@ typedef struct SynchPoolBlock {
     char heap[];
 } SynchPoolBlock;
 
+/// @brief The number of objects of another pool that are gathered by a pool before they are returned to their owner pool.
+#define SYNCH_POOL_REMOTE_BATCH       64
+
+/// @brief The granularity (in bytes) of the cache lines, in which a pool in line-packing mode groups its recycled objects
+/// (see synchPoolSetLinePacking).
+#define SYNCH_POOL_LINE_SIZE          64
+/// @brief The number of cache lines, whose recycled objects are gathered concurrently by a pool in line-packing mode.
+/// It should be a power of two and not larger than 64.
+#define SYNCH_POOL_LINE_SLOTS         16
+#define SYNCH_POOL_LINE_SLOTS_MASK    ((SYNCH_POOL_LINE_SLOTS == 64) ? ~0ULL : (1ULL << SYNCH_POOL_LINE_SLOTS) - 1)
+
+/// @brief This struct gathers the recycled objects of a single cache line.
+typedef struct SynchPoolLineSlot {
+    /// @brief The address of the cache line.
+    uintptr_t line;
+    /// @brief A list with the gathered objects of the cache line.
+    SynchBlockObject *head;
+    /// @brief The last object of `head`.
+    SynchBlockObject *tail;
+    /// @brief The number of objects in `head`.
+    uint64_t count;
+} SynchPoolLineSlot;
+
+/// @brief SynchPoolStats stores process-wide statistics about the memory reserved by all pools.
+typedef struct SynchPoolStats {
+    /// @brief The number of blocks that are currently allocated.
+    uint64_t blocks;
+    /// @brief The amount of memory (in bytes) of the blocks that are currently allocated.
+    uint64_t bytes;
+    /// @brief The maximum value of `bytes` during the execution.
+    uint64_t peak_bytes;
+    /// @brief The part of `bytes` that is allocated from persistent memory.
+    uint64_t persistent_bytes;
+} SynchPoolStats;
+
 /// @brief PoolStruct stores an instance of the pool object.
 typedef struct SynchPoolStruct {
     /// @brief The size of the stored object (in bytes).
     uint32_t obj_size;
-    /// @brief The number of objects that each block of the pool contains.
-    uint32_t entries_per_block;
+    /// @brief The size (in bytes) of the next block that the pool allocates. The size of each block is twice the size
+    /// of the previous one, starting from SYNCH_POOL_FIRST_BLOCK_SIZE, up to `max_block_size`.
+    uint64_t next_block_size;
+    /// @brief The maximum size (in bytes) of a block of the pool.
+    uint64_t max_block_size;
     /// @brief A list with the recycled items.
     SynchBlockObject *recycle_list;
     /// @brief The head of the list of blocks, where each block stores a specific amount of objects.
@@ -53,6 +97,24 @@ typedef struct SynchPoolStruct {
     /// @brief The latest allocated block of objects.
     SynchPoolBlock *cur_block;
     bool is_persistent;
+    /// @brief The number of objects in `remote_batch`.
+    uint32_t remote_batch_size;
+    /// @brief A batch of recycled objects that belong to the pool `remote_batch_owner`.
+    SynchBlockObject *remote_batch;
+    /// @brief The last object of `remote_batch`.
+    SynchBlockObject *remote_batch_tail;
+    struct SynchPoolStruct *remote_batch_owner;
+    /// @brief In line-packing mode, an array of SYNCH_POOL_LINE_SLOTS slots, where the recycled objects are grouped
+    /// by cache line. Otherwise, it is NULL.
+    SynchPoolLineSlot *line_slots;
+    /// @brief A bitmap with the non-empty slots of `line_slots`.
+    uint64_t line_slots_used;
+    /// @brief The slot that is released next, in case that all slots of `line_slots` are non-empty.
+    uint32_t line_slots_victim;
+    /// @brief The number of objects that fit in a cache line.
+    uint32_t objs_per_line;
+    /// @brief A lock-free list with the objects of this pool that were recycled through the pools of other threads.
+    SynchBlockObject * volatile remote_list CACHE_ALIGN;
 } SynchPoolStruct;
 
 /// @brief This is returned in case of error while calling synchInitPool.
@@ -63,7 +125,8 @@ typedef struct SynchPoolStruct {
 #define SYNCH_POOL_OBJECT_ALLOC_ERROR NULL
 
 
-/// @brief This function initializes a pool with objects of size obj_size.
+/// @brief This function initializes a pool with objects of size obj_size. No memory is allocated until the first
+/// call of synchAllocObj, where the first block of SYNCH_POOL_FIRST_BLOCK_SIZE bytes is allocated.
 /// @param pool A pointer to the pool of objects.
 /// @param obj_size The size of objects that the pool contains.
 /// @return In case of success, synchInitPool returns SYNCH_POOL_INIT_SUCC. In case of error, synchInitPool returns SYNCH_POOL_INIT_ERROR.
@@ -71,22 +134,72 @@ int synchInitPool(SynchPoolStruct *pool, uint32_t obj_size);
 
 int synchInitPoolPersistent(SynchPoolStruct *pool, uint32_t obj_size);
 
+/// @brief This function overrides the default sizes of the blocks of a pool (see SYNCH_POOL_FIRST_BLOCK_SIZE and
+/// SYNCH_POOL_MAX_BLOCK_SIZE). The sizes are rounded up to multiples of 64KB. The size of the first block
+/// is taken into account only in case that the pool has not allocated any block yet.
+/// @param pool A pointer to the pool of objects.
+/// @param first_block_size The size (in bytes) of the first block of the pool.
+/// @param max_block_size The maximum size (in bytes) of a block of the pool.
+void synchPoolSetBlockSizes(SynchPoolStruct *pool, uint64_t first_block_size, uint64_t max_block_size);
+
+/// @brief This function enables or disables the line-packing mode of a pool. In this mode, the recycled objects are
+/// grouped by the cache line (see SYNCH_POOL_LINE_SIZE) they belong to, and the objects of a cache line are handed out
+/// consecutively by synchAllocObj. Thus, the objects allocated in a short period of time (e.g. the nodes created
+/// by a combining round) share a small number of cache lines, even after many objects are recycled in arbitrary order,
+/// and they are persisted with a small number of PWBs. The mode is not enabled in case that the size of objects does not
+/// divide SYNCH_POOL_LINE_SIZE, or that a cache line fits a single object.
+/// @param pool A pointer to the pool of objects.
+/// @param enable True for enabling the line-packing mode, false for disabling it.
+void synchPoolSetLinePacking(SynchPoolStruct *pool, bool enable);
+
+/// @brief This function allocates the blocks of a pool that are needed for `nobjs` objects (in case that they have not
+/// been allocated yet) and pre-faults the objects that have never been handed out, so that the first allocations of the pool
+/// do not suffer page faults. In case that the pool has not allocated any block yet, its first block is sized to fit
+/// `nobjs` objects (up to the maximum block size). This function should be called by the thread that owns the pool
+/// (e.g. in a ThreadStateInit function), so that the threads pre-fault their pools in parallel and on their own NUMA node.
+/// @param pool A pointer to the pool of objects.
+/// @param nobjs The number of objects that should be ready for allocation.
+void synchPoolPrefault(SynchPoolStruct *pool, uint64_t nobjs);
+
 /// @brief This function initializes a pool with objects of size obj_size.
 /// @param pool A pointer to the pool of objects.
 /// @return On success, a pointer to a free object is returned. Otherwise, SYNCH_POOL_OBJECT_ALLOC_ERROR is returned.
 void *synchAllocObj(SynchPoolStruct *pool);
 
-/// @brief This function recycles the obj object for future use.
+/// @brief This function recycles the obj object for future use. In case that obj was allocated by another pool,
+/// it is returned to its owner pool (see SYNCH_POOL_REMOTE_BATCH).
 /// @param pool A pointer to the pool of objects.
 /// @param obj A pointer to the object that should be recycled.
 void synchRecycleObj(SynchPoolStruct *pool, void *obj);
 
+/// @brief This function returns to their owner pool the objects of another pool that were recycled through `pool`
+/// and have not been returned yet.
+/// @param pool A pointer to the pool of objects.
+void synchPoolFlushRemote(SynchPoolStruct *pool);
+
 /// @brief This function cancels the last num_objs consecutive object allocations. Note that no synchRecycleObj operation 
 /// should have been called for any of the last num_objs consecutive object allocations.
 /// @param pool A pointer to the pool of objects.
 /// @param num_objs The number of consecutive allocations that should be canceled.
 void synchRollback(SynchPoolStruct *pool, uint32_t num_objs);
 
+/// @brief This function returns the amount of memory (in bytes) occupied by the objects that were ever handed out
+/// by the pool, i.e. the high-water mark of the pool, which includes the objects that are currently in use
+/// and the recycled ones.
+/// @param pool A pointer to the pool of objects.
+/// @return The amount of memory occupied by the objects of the pool.
+uint64_t synchPoolFootprint(SynchPoolStruct *pool);
+
+/// @brief This function returns to the system the trailing blocks of the pool that have never handed out an object
+/// (e.g. after a synchRollback). The recycled objects are not affected.
+/// @param pool A pointer to the pool of objects.
+void synchPoolTrim(SynchPoolStruct *pool);
+
+/// @brief This function returns process-wide statistics about the memory reserved by all pools.
+/// These statistics are also printed by synchPrintStats.
+/// @param stats A pointer to a SynchPoolStats struct, where the statistics are stored.
+void synchPoolGetStats(SynchPoolStats *stats);
+
 /// @brief This function frees all the memory allocated by the pool object.
 /// @param pool A pointer to the pool of objects.
 void synchDestroyPool(SynchPoolStruct *pool);
@@ -10,6 +10,7 @@
 #include <config.h>
 #include <system.h>
 #include <stats.h>
+#include <persist.h>
 #include <stddef.h>
 
 /// @brief The vendor of the processor is unknown.
@@ -104,6 +105,15 @@ inline void *synchGetMemory(size_t size);
 /// @return In case of error, NULL is returned. In case of success a pointer to the allocated memory area is returned.
 inline void *synchGetAlignedMemory(size_t align, size_t size);
 
+/// @brief This function allocates a memory area of size bytes on a specific NUMA node. The returned address is aligned to an offset equal to align bytes.
+/// In case that SYNCH_NUMA_SUPPORT is not defined in libconcurrent/config.h, this function behaves as synchGetAlignedMemory.
+///
+/// @param align The alignment size.
+/// @param size The size of the memory area.
+/// @param node The NUMA node where the memory area should be allocated.
+/// @return In case of error, NULL is returned. In case of success a pointer to the allocated memory area is returned.
+inline void *synchGetAlignedMemoryOnNode(size_t align, size_t size, uint32_t node);
+
 /// @brief This function frees memory allocated with either getMemory() or synchGetAlignedMemory() functions.
 ///
 /// @param ptr A pointer to the memory area to be freed.
@@ -112,14 +122,26 @@ inline void synchFreeMemory(void *ptr, size_t size);
 
 inline void *synchGetPersistentMemory(size_t align, size_t size);
 inline void synchFreePersistentMemory(void *ptr, size_t size);
-inline void synchFlushPersistentMemory(void *ptr, size_t size);
-inline void synchDrainPersistentMemory(void);
+
+/// @brief This function pre-faults the pages of a memory area, so that the first accesses to the area do not cause
+/// page faults. The contents of the area are not modified. It should be called by the thread that is going to use
+/// the area, since in case that SYNCH_NUMA_SUPPORT is enabled, the pages are usually placed on its NUMA node.
+///
+/// @param ptr A pointer to the memory area.
+/// @param size The size of the memory area.
+void synchPrefaultMemory(void *ptr, size_t size);
 
 /// @brief This function returns the current system's time in milliseconds.
 ///
 /// @return System's time in milliseconds.
 inline int64_t synchGetTimeMillis(void);
 
+/// @brief This function returns the current value of the time-stamp counter of the processor.
+/// In case that the processor does not provide a time-stamp counter, the system's monotonic time in nanoseconds is returned.
+///
+/// @return The current value of the time-stamp counter.
+inline uint64_t synchGetTSC(void);
+
 /// @brief This function returns the vendor of the processor that it runs on.
 /// The current version of the Synch framework returns any of the following codes:
 /// - AMD_X86_MACHINE
@@ -11,15 +11,31 @@
 #define _SIM_PERSISTENT_H_
 
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 #include <config.h>
 #include <primitives.h>
 #include <tvec.h>
 #include <fastrand.h>
 #include <threadtools.h>
-#include <fam.h>
+#include <replica.h>
+#include <backoff.h>
 
-#define _SIM_PERSISTENT_LOCAL_POOL_SIZE_ 2
-#define _SIM_PERSISTENT_FAD_DIVISIONS_   2
+/// @brief The number of copies of object's state that each thread owns (i.e. the depth of each thread's pool of copies).
+/// A combiner never overwrites the copy that is currently pointed by `S`, while the rest copies are used in a round-robin fashion.
+/// Deeper pools reduce the probability that a thread reads a copy that is concurrently overwritten (and thus retries),
+/// at the cost of more persistent memory. Without SYNCH_PWFCOMB_WIDE_POINTERS, the total amount of copies should not
+/// exceed 2^24 (i.e. the range of the index of the pointer). This value could be overridden at compile time.
+#ifndef _SIM_PERSISTENT_LOCAL_POOL_SIZE_
+#    define _SIM_PERSISTENT_LOCAL_POOL_SIZE_ 2
+#endif
+
+/// @brief Whenever the `numa_nodes` argument of the initialization functions of PWFcomb, PWFqueue and PWFstack is equal to
+/// _SIM_PERSISTENT_AUTO_FAD_DIVISIONS_, the number of `activate` divisions (i.e. the toggle vectors where threads announce their
+/// requests with Fetch&Add) is equal to the number of NUMA nodes detected by the runtime. Otherwise, the given number of
+/// divisions is used (e.g. by setting the `--numa_nodes` option in benchmarks). In any case, the number of divisions does not
+/// exceed the number of detected NUMA nodes, since threads are mapped to divisions according to the NUMA node they run on.
+#define _SIM_PERSISTENT_AUTO_FAD_DIVISIONS_ 0
 
 #if _SIM_PERSISTENT_LOCAL_POOL_SIZE_ < 2
 #    error PWFcomb persistent combining object is improperly configured
@@ -31,22 +47,70 @@ typedef struct PWFCombStateRec {
     RetVal *return_val;
     /// @brief A vector of toggles, one per running thread. This toggle indicates if the corresponding running thread has a peding request or not.
     ToggleVector deactivate;
-    ToggleVector index;
-    /// @brief The actual data of the simulated object's state.
-    ObjectState st;
+    /// @brief The actual data of the simulated object's state, which is a pointer that points to the flex field.
+    void *state;
 #ifdef DEBUG
     int counter;
     int rounds;
 #endif
+    /// @brief A dummy field, the `deactivate` toggles, the array of return values and the data of state follow.
     uint64_t __flex[1];
 } PWFCombStateRec;
 
-/// @brief A macro for calculating the size of the PWFCombStateRec struct for a specific amount of threads.
-#define PWFCombObjectStateSize(nthreads) (sizeof(PWFCombStateRec) + 2 * _TVEC_VECTOR_SIZE(nthreads) + (nthreads) * sizeof(RetVal))
+/// @brief A macro for calculating the size of the PWFCombStateRec struct for a specific amount of threads and size of state.
+#define PWFCombObjectStateSize(nthreads, state_size) (sizeof(PWFCombStateRec) + _TVEC_VECTOR_SIZE(nthreads) + (nthreads) * sizeof(RetVal) + (state_size))
+
+/// @brief This struct stores volatile information about the combining round that produced a copy of the simulated object's state.
+/// PWFcomb, PWFqueue and PWFstack keep one such struct per copy of the state in volatile memory. A helped thread uses it for deciding
+/// whether it should persist the pointer to the most recent copy, i.e. in case that the combining round that served it has not yet
+/// persisted this pointer. Thus, each helped thread reads O(1) words instead of a per-combiner row of an O(n^2) matrix.
+typedef struct PWFCombRoundRec {
+    /// @brief The epoch of the combining round, i.e. the value that the combiner stored to its `flush` entry.
+    /// An odd epoch indicates that the pointer to the produced copy may not be persisted yet.
+    volatile uint64_t epoch;
+    /// @brief A vector of toggles, one per running thread. It indicates the threads served by the combining round.
+    ToggleVector served;
+    uint64_t __flex[1];
+} PWFCombRoundRec;
 
+#ifdef SYNCH_PWFCOMB_WIDE_POINTERS
+/// @brief pointer_t should not used directely by user. This struct is used by PWFcomb for pointing to the 
+/// most rescent and valid copy of the simulated object's state. It also contains a 64-bit sequence number
+/// for avoiding the ABA problem. Since SYNCH_PWFCOMB_WIDE_POINTERS is enabled, it occupies 128 bits.
+typedef union pointer_t {
+    struct StructData{
+        uint64_t seq;
+        uint64_t index;
+    } struct_data;
+    uint64_t raw_data[2];
+} __attribute__((aligned(16))) pointer_t;
+
+/// @brief This function reads a consistent snapshot of a 128-bit pointer. Since the sequence number is increased
+/// by each successful CAS, the snapshot is consistent whenever the sequence number has not changed while reading the index.
+static inline pointer_t PWFCombLoadPointer(volatile pointer_t *ptr) {
+    pointer_t res;
+
+    do {
+        res.struct_data.seq = ptr->struct_data.seq;
+        synchNonTSOFence();
+        res.struct_data.index = ptr->struct_data.index;
+        synchNonTSOFence();
+    } while (res.struct_data.seq != ptr->struct_data.seq);
+
+    return res;
+}
+
+static inline bool PWFCombEqualPointers(pointer_t p1, volatile pointer_t *ptr) {
+    return p1.struct_data.seq == ptr->struct_data.seq && p1.struct_data.index == ptr->struct_data.index;
+}
+
+static inline bool PWFCombCASPointer(volatile pointer_t *ptr, pointer_t old_value, pointer_t new_value) {
+    return synchCAS128(ptr, old_value.raw_data[0], old_value.raw_data[1], new_value.raw_data[0], new_value.raw_data[1]);
+}
+#else
 /// @brief pointer_t should not used directely by user. This struct is used by PWFcomb for pointing to the 
 /// most rescent and valid copy of the simulated object's state. It also contains a 40-bit sequence number
-/// for avoiding the ABA problem.
+/// for avoiding the ABA problem. See also SYNCH_PWFCOMB_WIDE_POINTERS in config.h.
 typedef union pointer_t {
     struct StructData{
         int64_t seq : 40;
@@ -55,6 +119,50 @@ typedef union pointer_t {
     int64_t raw_data;
 } pointer_t;
 
+static inline pointer_t PWFCombLoadPointer(volatile pointer_t *ptr) {
+    pointer_t res;
+
+    res.raw_data = ptr->raw_data;
+    return res;
+}
+
+static inline bool PWFCombEqualPointers(pointer_t p1, volatile pointer_t *ptr) {
+    return p1.raw_data == ptr->raw_data;
+}
+
+static inline bool PWFCombCASPointer(volatile pointer_t *ptr, pointer_t old_value, pointer_t new_value) {
+    return synchCAS64(&ptr->raw_data, old_value.raw_data, new_value.raw_data);
+}
+#endif
+
+/// @brief This function returns the copy of object's state (i.e. an index to the array of copies) that thread `pid`
+/// should use in its next combining attempt. The copies of each thread are used in a round-robin fashion,
+/// skipping the copy that is currently pointed by `S`.
+///
+/// @param local_index A pointer to the thread's position in its pool of copies.
+/// @param pid The pid of the calling thread.
+/// @param curr_index The index of the copy that is currently pointed by `S`.
+/// @return The index of the copy that the thread should use.
+static inline uint64_t PWFCombNextLocalIndex(int *local_index, int pid, uint64_t curr_index) {
+    uint64_t index;
+
+    do {
+        index = (uint64_t)pid * _SIM_PERSISTENT_LOCAL_POOL_SIZE_ + *local_index;
+        *local_index = (*local_index + 1) % _SIM_PERSISTENT_LOCAL_POOL_SIZE_;
+    } while (index == curr_index);
+
+    return index;
+}
+
+/// @brief This struct stores per-thread counters of the work that is wasted by failed combining attempts.
+typedef struct PWFCombWasteStats {
+    /// @brief The number of copies of object's state that were never pointed by `S`.
+    uint64_t copies;
+    /// @brief The number of copies of object's state that were persisted, but they were never pointed by `S` (i.e. the CAS failed).
+    uint64_t flushes;
+    uint64_t pad[6];
+} PWFCombWasteStats;
+
 /// @brief PWFCombThreadState stores each thread's local state for a single instance of PWFcomb.
 /// For each instance of PWFcomb, a discrete instance of PWFCombThreadState should be used.
 typedef struct PWFCombThreadState {
@@ -62,9 +170,12 @@ typedef struct PWFCombThreadState {
     ToggleVector index;
     ToggleVector diffs;
     ToggleVector l_activate;
-    ToggleVector diffs_copy;
-    /// @brief Current backoff value.
-    int backoff;
+    /// @brief The position of the thread in its pool of copies of object's state.
+    int local_index;
+    /// @brief The `activate` division where the thread announces its requests.
+    int fad_division;
+    /// @brief The time-based backoff scheme of the thread (see backoff.h), initialized during thread's first operation.
+    SynchBackoffStruct backoff;
 } PWFCombThreadState;
 
 typedef struct PWFCombRequestRec {
@@ -83,18 +194,29 @@ typedef struct PWFCombPersistentState{
 /// PWFCombStruct should be initialized using the PWFCombStructInit function.
 typedef struct PWFCombStruct {
     volatile PWFCombPersistentState *pstate;
-    /// @brief A vector of toggle bits, one toggle per NUMA node. The object could also work fine with a single such toggle.
-    /// However, by using one toggle per NUMA node, the performance is increased substantially.
-    ToggleVector activate[_SIM_PERSISTENT_FAD_DIVISIONS_] CACHE_ALIGN;
+    /// @brief An array of toggle vectors, one vector per NUMA node (i.e. per `activate` division). The object could also work
+    /// fine with a single such vector. However, by using one vector per NUMA node, the performance is increased substantially.
+    /// Each vector is allocated on the NUMA node of the threads that use it.
+    ToggleVector *activate CACHE_ALIGN;
+    /// @brief The number of `activate` divisions.
+    uint32_t fad_divisions;
     /// @brief An array of pools (one pool per thread) of PWFCombStateRec structs.
     PWFCombStateRec ** volatile mem_state;
     volatile uint64_t ** flush;
     /// @brief Pointer to an array, where threads announce the requests that want to perform to the object.
     PWFCombRequestRec * volatile request;
-    volatile uint64_t ** comb_round;
+    /// @brief An array of PWFCombRoundRec structs, one for each PWFCombStateRec struct of `mem_state`.
+    PWFCombRoundRec ** rounds;
+    /// @brief A pointer to an optional replication object (see `replica.h`). In case that it is not NULL,
+    /// each successful combiner publishes the committed state to this object.
+    SynchReplicaStruct *replica;
+    /// @brief An array of per-thread counters of wasted copies and flushes (see PWFCombGetWasteStats).
+    PWFCombWasteStats *waste;
     /// @brief The number of threads that use this instance of PWFcomb.
     uint32_t nthreads;
-    /// @brief The maximum backoff value that could be used by this instance of PWFcomb.
+    /// @brief The size (in bytes) of simulated object's state.
+    uint32_t state_size;
+    /// @brief The maximum backoff delay (in nanoseconds) that could be used by this instance of PWFcomb.
     int MAX_BACK;
 } PWFCombStruct;
 
@@ -105,8 +227,66 @@ typedef struct PWFCombStruct {
 ///
 /// @param l A pointer to an instance of the PWFcomb object.
 /// @param nthreads The number of threads that will use  this instance of the PWFcomb object.
-/// @param max_backoff The maximum value for backoff (usually this is lower than 100).
-void PWFCombInit(PWFCombStruct *l, uint32_t nthreads, int max_backoff);
+/// @param numa_nodes The number of NUMA nodes (which may differ with the actual hw numa nodes) that PWFcomb should consider
+/// for dividing the `activate` toggles. In case that numa_nodes is equal to _SIM_PERSISTENT_AUTO_FAD_DIVISIONS_,
+/// the number of NUMA nodes provided by the HW is used.
+/// @param initial_state A pointer to the initial state of the simulated object.
+/// @param state_size The size (in bytes) of the state of the simulated object.
+/// @param max_backoff The maximum backoff delay in units of 100 nanoseconds. The actual delay is tuned automatically
+/// by each thread. In case that max_backoff is equal to 0, the maximum delay is equal to SYNCH_BACKOFF_AUTO_MAX_NS.
+void PWFCombInit(PWFCombStruct *l, uint32_t nthreads, uint32_t numa_nodes, void *initial_state, uint32_t state_size, int max_backoff);
+
+/// @brief This function allocates the `activate` toggle vectors of PWFcomb, PWFqueue and PWFstack.
+/// Each vector is allocated on the NUMA node of the threads that announce their requests on it.
+///
+/// @param nthreads The number of threads that will use the object.
+/// @param numa_nodes The requested number of divisions or _SIM_PERSISTENT_AUTO_FAD_DIVISIONS_.
+/// @param fad_divisions A pointer to an integer, where the actual number of divisions is stored.
+/// @return A pointer to an array of `*fad_divisions` toggle vectors, where all toggles are cleared.
+ToggleVector *PWFCombActivateInit(uint32_t nthreads, uint32_t numa_nodes, uint32_t *fad_divisions);
+
+/// @brief This function allocates the PWFCombRoundRec structs of PWFcomb, PWFqueue and PWFstack.
+///
+/// @param nthreads The number of threads that will use the object.
+/// @param nrecords The number of copies of object's state (i.e. one PWFCombRoundRec struct per copy).
+/// @return A pointer to an array of `nrecords` pointers to PWFCombRoundRec structs; each struct is allocated in a separate cache line.
+PWFCombRoundRec **PWFCombRoundsInit(uint32_t nthreads, uint32_t nrecords);
+
+/// @brief This function allocates `nrecords` records of `record_size` bytes (e.g. the copies of the state of PWFcomb,
+/// PWFqueue and PWFstack) in a single contiguous area, where each record starts at a separate cache line.
+/// The area is pre-faulted, so that the first rounds of the object do not suffer page faults.
+///
+/// @param records An array of `nrecords` pointers, where the addresses of the records are stored.
+/// @param nrecords The number of records.
+/// @param record_size The size (in bytes) of each record.
+/// @param persistent In case that it is true, the records are allocated in persistent memory.
+void PWFCombRecordsInit(void **records, uint32_t nrecords, size_t record_size, bool persistent);
+
+/// @brief This function returns the `activate` division that the calling thread should use.
+/// It should be called after the thread is pinned to its core.
+///
+/// @param fad_divisions The number of `activate` divisions of the object.
+/// @return The division of the calling thread.
+int PWFCombFADDivisionOfThread(uint32_t fad_divisions);
+
+/// @brief This function attaches a replication object (see `replica.h`) to an instance of PWFcomb.
+/// After each successful combining attempt, the combiner publishes a copy of the committed state
+/// (i.e. the `state` field of PWFCombStateRec) to the replication object. The shipper thread of the
+/// replication object applies the published states to a mirror object asynchronously.
+///
+/// @param l A pointer to an instance of the PWFcomb object.
+/// @param replica A pointer to an initialized replication object with state size equal to the `state_size` of the PWFcomb instance,
+/// or NULL for disabling replication.
+void PWFCombSetReplica(PWFCombStruct *l, SynchReplicaStruct *replica);
+
+/// @brief This function returns the amount of work that has been wasted by failed combining attempts of an instance of PWFcomb.
+/// A high ratio of wasted copies to applied operations indicates that deeper pools (i.e. _SIM_PERSISTENT_LOCAL_POOL_SIZE_)
+/// or higher backoff values could be beneficial. It should be called while no thread applies operations to the object.
+///
+/// @param l A pointer to an instance of the PWFcomb object.
+/// @param copies A pointer to a variable, where the number of copies of object's state that were never installed is stored.
+/// @param flushes A pointer to a variable, where the number of persisted copies that were never installed is stored.
+void PWFCombGetWasteStats(PWFCombStruct *l, uint64_t *copies, uint64_t *flushes);
 
 /// @brief This function should be called once by each thread before it applies any operation to the PWFcomb combining object.
 /// 
@@ -125,4 +305,171 @@ void PWFCombThreadStateInit(PWFCombThreadState *th_state, uint32_t nthreads, int
 /// @return RetVal The return value of the deactivate request. 
 Object PWFCombApplyOp(PWFCombStruct *l, PWFCombThreadState *th_state, RetVal (*sfunc)(void *, ArgVal, int), Object arg, int pid);
 
+/// @brief This function copies the contents of the PWFCombStateRec `src` to `dest`, i.e. everything except the
+/// `return_val`, `deactivate` and `state` pointers. The toggles, the return values and exactly `state_size` bytes
+/// of the state are stored contiguously after these pointers.
+static inline void PWFCombStateRecCopy(PWFCombStateRec *dest, PWFCombStateRec *src, uint32_t state_size) {
+    size_t offset = offsetof(PWFCombStateRec, state) + sizeof(void *);
+
+    memcpy(((void *)dest) + offset, ((void *)src) + offset, PWFCombObjectStateSize(dest->deactivate.nthreads, state_size) - offset);
+}
+
+/// @brief This function contains the actual implementation of PWFCombApplyOp. It is always inlined, thus in case that
+/// the serial function and the state size are compile-time constants, the compiler calls the serial function directly
+/// (or inlines it) and constant-folds the state-dependent part of the sizes of the copies and flushes of the state.
+/// It should not be called directly; PWFCombApplyOp and the functions generated by PWFCOMB_DEFINE_OBJECT are built on top of it.
+///
+/// @param pwfcomb_struct A pointer to an instance of the PWFcomb persistent wait-free combining object.
+/// @param th_state A pointer to thread's local state for a specific instance of PWFcomb.
+/// @param sfunc A serial function that the PWFcomb instance should execute, while applying requests announced by active threads.
+/// @param state_size The size (in bytes) of the state of the simulated object; it should be equal to `state_size` of `pwfcomb_struct`.
+/// @param arg The argument of the request that the thread wants to apply.
+/// @param pid The pid of the calling thread.
+/// @return RetVal The return value of the deactivate request.
+static inline __attribute__((always_inline)) Object PWFCombApplyOpTemplate(PWFCombStruct *pwfcomb_struct, PWFCombThreadState *th_state,
+                                                                          RetVal (*sfunc)(void *, ArgVal, int),
+                                                                          uint32_t state_size, Object arg, int pid) {
+    ToggleVector *diffs = &th_state->diffs,
+                 *l_activate = &th_state->l_activate;
+    pointer_t old_sp, new_sp;
+    PWFCombStateRec *sp_data, *lsp_data;
+    int i, j, prefix, mybank;
+    int curr_pool_index;
+    uint64_t l_val;
+
+    if (th_state->fad_division == -1) {                                                   // the first operation of the thread
+        th_state->fad_division = PWFCombFADDivisionOfThread(pwfcomb_struct->fad_divisions);
+        synchInitTimedBackoff(&th_state->backoff, pwfcomb_struct->MAX_BACK);
+    }
+    synchTimedBackoffTune(&th_state->backoff);
+
+    pwfcomb_struct->request[pid].arg = arg;                                               // pwfcomb_struct->request the operation
+    pwfcomb_struct->request[pid].valid = true;
+    synchFullFence();
+
+    mybank = TVEC_GET_BANK_OF_BIT(pid, pwfcomb_struct->nthreads);
+    TVEC_NEGATIVE_BANK(&th_state->index, &th_state->index, mybank);
+    TVEC_ATOMIC_ADD_BANK(&pwfcomb_struct->activate[th_state->fad_division], &th_state->index, mybank); // index pid's bit in pwfcomb_struct->activate, Fetch&Add acts as a full write-barrier
+    
+    if (!synchIsSystemOversubscribed()) {
+        if (synchFastRandomRange(1, pwfcomb_struct->nthreads) > 1) { 
+            synchTimedBackoffDelay(&th_state->backoff);
+        }
+    } else {
+        if (synchFastRandomRange(1, pwfcomb_struct->nthreads) > 4)
+            synchResched();
+    }
+
+    for (j = 0; j < 2; j++) {
+        old_sp = PWFCombLoadPointer(&pwfcomb_struct->pstate->S);                                                           // read reference to struct ObjectState
+        sp_data = pwfcomb_struct->mem_state[old_sp.struct_data.index];                              // read reference of struct ObjectState in a local variable lsim_persistent_struct->S
+
+        // Performance improvement
+        TVEC_XOR_BANKS(diffs, &pwfcomb_struct->activate[th_state->fad_division], &sp_data->deactivate, mybank);                               // determine the set of active processes
+        l_val = *pwfcomb_struct->flush[old_sp.struct_data.index/_SIM_PERSISTENT_LOCAL_POOL_SIZE_]; 
+        if (!PWFCombEqualPointers(old_sp, &pwfcomb_struct->pstate->S))
+            continue;
+        if (!TVEC_IS_SET(diffs, pid))                                                           // if the operation has already been deactivate return
+            break;
+
+        uint64_t local_index = PWFCombNextLocalIndex(&th_state->local_index, pid, old_sp.struct_data.index);
+        lsp_data = pwfcomb_struct->mem_state[local_index];
+        PWFCombStateRecCopy(lsp_data, sp_data, state_size);
+        if (!PWFCombEqualPointers(old_sp, &pwfcomb_struct->pstate->S)) {
+            pwfcomb_struct->waste[pid].copies++;
+            continue;
+        }
+
+        TVEC_OR_REDUCE(l_activate, (ToggleVector *)pwfcomb_struct->activate, pwfcomb_struct->fad_divisions);      // This is an atomic read, since activate is volatile
+
+        TVEC_XOR(diffs, &lsp_data->deactivate, l_activate);
+        if (!TVEC_IS_SET(diffs, pid)) {                                                         // if the operation has already been deactivate return
+            pwfcomb_struct->waste[pid].copies++;
+            break;
+        }
+        
+#ifdef DEBUG
+        lsp_data->rounds++;
+        lsp_data->counter++;
+#endif
+        lsp_data->return_val[pid] = sfunc(lsp_data->state, arg, pid);      
+        TVEC_COPY(&pwfcomb_struct->rounds[local_index]->served, diffs);
+        TVEC_REVERSE_BIT(diffs, pid);
+        // stop combining as soon as another combiner has changed S, since this copy will never be installed
+        for (i = TVEC_NEXT_CELL(diffs, 0); i < TVEC_CELLS(diffs) && PWFCombEqualPointers(old_sp, &pwfcomb_struct->pstate->S); i = TVEC_NEXT_CELL(diffs, i + 1)) {
+            prefix = i * _TVEC_BIWORD_SIZE_;
+            synchReadPrefetch(&pwfcomb_struct->request[prefix]);
+            synchReadPrefetch(&pwfcomb_struct->request[prefix + 8]);
+            synchReadPrefetch(&pwfcomb_struct->request[prefix + 16]);
+            synchReadPrefetch(&pwfcomb_struct->request[prefix + 24]);
+
+            while (diffs->cell[i] != 0L) {
+                register int pos, proc_id;
+
+                pos = synchBitSearchFirst(diffs->cell[i]);
+                proc_id = prefix + pos;
+                diffs->cell[i] ^= ((bitword_t)1) << pos;
+                if (pwfcomb_struct->request[proc_id].valid == false) {
+                    TVEC_REVERSE_BIT(l_activate, proc_id);
+                    continue;
+                }
+                lsp_data->return_val[proc_id] = pwfcomb_struct->request[proc_id].arg;
+                lsp_data->return_val[proc_id] = sfunc(lsp_data->state, pwfcomb_struct->request[proc_id].arg, proc_id);
+#ifdef DEBUG
+                lsp_data->counter++;
+#endif
+            }
+        }
+        TVEC_COPY(&lsp_data->deactivate, l_activate);                                              // change deactivate to be equal to what was read in pwfcomb_struct->activate
+
+        new_sp.struct_data.seq = old_sp.struct_data.seq + 1;                                   // increase timestamp
+        new_sp.struct_data.index = local_index;
+
+        if (PWFCombEqualPointers(old_sp, &pwfcomb_struct->pstate->S)) {
+            synchPersistRange((void *)lsp_data, PWFCombObjectStateSize(pwfcomb_struct->nthreads, state_size));
+
+            // an odd epoch indicates that the pointer to lsp_data is not yet persisted
+            if (l_val % 2 == 0)
+                l_val++;
+            else
+                l_val += 2;
+            pwfcomb_struct->rounds[local_index]->epoch = l_val;
+            *pwfcomb_struct->flush[new_sp.struct_data.index/_SIM_PERSISTENT_LOCAL_POOL_SIZE_] = l_val;
+
+            if (PWFCombEqualPointers(old_sp, &pwfcomb_struct->pstate->S) && PWFCombCASPointer(&pwfcomb_struct->pstate->S, old_sp, new_sp)) {                    // try to change pwfcomb_struct->S to the value mod_dw
+                synchPersistRange((void *)&pwfcomb_struct->pstate->S, sizeof(pointer_t));
+                synchCAS64(pwfcomb_struct->flush[new_sp.struct_data.index/_SIM_PERSISTENT_LOCAL_POOL_SIZE_], l_val, l_val+1);
+                if (pwfcomb_struct->replica != NULL)                                          // lsp_data is only modified by this thread
+                    synchReplicaAppend(pwfcomb_struct->replica, new_sp.struct_data.seq, lsp_data->state);
+                return lsp_data->return_val[pid];
+            }
+            pwfcomb_struct->waste[pid].copies++;
+            pwfcomb_struct->waste[pid].flushes++;
+        } else {
+            pwfcomb_struct->waste[pid].copies++;
+        }
+    }
+
+    curr_pool_index = pwfcomb_struct->pstate->S.struct_data.index;
+    l_val = *pwfcomb_struct->flush[curr_pool_index/_SIM_PERSISTENT_LOCAL_POOL_SIZE_];
+    // persist the pointer only if the round that served this thread has not persisted it yet
+    if (l_val%2 == 1 && l_val == pwfcomb_struct->rounds[curr_pool_index]->epoch && TVEC_IS_SET(&pwfcomb_struct->rounds[curr_pool_index]->served, pid)) {
+        synchPersistRange((void *)&pwfcomb_struct->pstate->S, sizeof(pointer_t));
+        synchCAS64(pwfcomb_struct->flush[curr_pool_index/_SIM_PERSISTENT_LOCAL_POOL_SIZE_], l_val, l_val+1);
+    }
+
+    return pwfcomb_struct->mem_state[curr_pool_index]->return_val[pid];                                    // return the value found in the record stored there
+}
+
+/// @brief This macro generates a function named `name##ApplyOp` that applies operations to a PWFcomb instance
+/// whose state is of type `state_t` and is modified by the serial function `sfunc`. The generated function has the same
+/// semantics as PWFCombApplyOp, but `sfunc` is not called through a function pointer and the size of the state is known
+/// at compile time. The generated function has the following prototype:
+/// `static Object name##ApplyOp(PWFCombStruct *l, PWFCombThreadState *th_state, Object arg, int pid)`.
+/// The PWFcomb instance should be initialized by PWFCombInit with `state_size` equal to `sizeof(state_t)`.
+#define PWFCOMB_DEFINE_OBJECT(name, state_t, sfunc)                                                         \
+    static Object name##ApplyOp(PWFCombStruct *l, PWFCombThreadState *th_state, Object arg, int pid) {     \
+        return PWFCombApplyOpTemplate(l, th_state, sfunc, sizeof(state_t), arg, pid);                      \
+    }
+
 #endif
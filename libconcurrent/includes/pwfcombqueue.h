@@ -23,7 +23,6 @@
 typedef struct PWFCombQueueEnqRec {
     /// @brief A vector of toggles, one per running thread. This toggle indicates if the corresponding running thread has a peding request or not.
     ToggleVector deactivate;
-    ToggleVector index;
     Node *first;
     Node *last;
     /// @brief A pointer to the tail of the queue, i.e. at the node that was inserted last.
@@ -35,13 +34,12 @@ typedef struct PWFCombQueueEnqRec {
 } PWFCombQueueEnqRec;
 
 /// @brief A macro for calculating the size of the PWFCombQueueEnqRec struct for a specific amount of threads.
-#define PWFCombQueueEnqStateSize(N) (sizeof(PWFCombQueueEnqRec) + 2 * _TVEC_VECTOR_SIZE(N))
+#define PWFCombQueueEnqStateSize(N) (sizeof(PWFCombQueueEnqRec) + _TVEC_VECTOR_SIZE(N))
 
 /// @brief This struct stores the state of the queue that handles the Dequeue operatios.
 typedef struct PWFCombQueueDeqState {
     /// @brief A vector of toggles, one per running thread. This toggle indicates if the corresponding running thread has a peding request or not.
     ToggleVector deactivate;
-    ToggleVector index;
     /// @brief A pointer to the array of return values.
     RetVal *return_val;
     /// @brief A pointer to the head of the queue, i.e. at the node that was inserted first.
@@ -53,7 +51,33 @@ typedef struct PWFCombQueueDeqState {
 } PWFCombQueueDeqState;
 
 /// @brief A macro for calculating the size of the PWFCombQueueState struct for a specific amount of threads.
-#define PWFCombQueueDeqStateSize(N) (sizeof(PWFCombQueueDeqState) + 2 * _TVEC_VECTOR_SIZE(N) + (N) * sizeof(RetVal))
+#define PWFCombQueueDeqStateSize(N) (sizeof(PWFCombQueueDeqState) + _TVEC_VECTOR_SIZE(N) + (N) * sizeof(RetVal))
+
+/// @brief The initial capacity of the ring buffer where each thread keeps its batches of dequeued nodes until they are recycled.
+/// The capacity is doubled in case that the ring buffer is full (e.g. because some other thread is stalled in the middle
+/// of an operation).
+#define PWFCOMB_QUEUE_RETIRED_BATCHES       128
+/// @brief A thread tries to recycle its batches of dequeued nodes once every PWFCOMB_QUEUE_RECLAIM_THRESHOLD successful dequeue combining rounds.
+#define PWFCOMB_QUEUE_RECLAIM_THRESHOLD     32
+/// @brief The reservation of a thread that does not apply any operation, which is also used for batches not tagged yet.
+#define PWFCOMB_QUEUE_QUIESCENT             UINT64_MAX
+
+/// @brief This struct describes the nodes that were removed from the queue by a single dequeue combining round.
+/// These are the nodes from `first` up to (but not including) `stop`, i.e. the head installed by the round.
+typedef struct PWFCombQueueRetiredBatch {
+    Node *first;
+    Node *stop;
+    /// @brief The sequence number of `Epstate->S` when the batch was retired.
+    uint64_t enq_seq;
+    /// @brief The reclamation epoch of the batch, or PWFCOMB_QUEUE_QUIESCENT in case that it is not tagged yet.
+    uint64_t epoch;
+} PWFCombQueueRetiredBatch;
+
+/// @brief The reclamation epoch that a thread has observed at the beginning of its current operation.
+typedef struct PWFCombQueueReservation {
+    volatile uint64_t epoch;
+    uint64_t pad[15];
+} PWFCombQueueReservation;
 
 /// @brief PWFCombQueueThreadState stores each thread's local state for a single instance of PWFqueue.
 /// For each instance of PWFqueue, a discrete instance of PWFCombQueueThreadState should be used.
@@ -62,14 +86,25 @@ typedef struct PWFCombQueueThreadState {
     ToggleVector deq_index;
     ToggleVector enq_index;
     ToggleVector diffs;
-    ToggleVector diffs_copy;
     ToggleVector l_activate;
     ToggleVector tmp_toggles;
     SynchPoolStruct pool_node;               
+    /// @brief The position of the thread in its pools of copies of the dequeue and the enqueue state respectively.
     int deq_local_index;
     int enq_local_index;
-    /// @brief Current backoff value.
-    int backoff;
+    /// @brief The `activate` division where the thread announces its requests (for both enqueues and dequeues).
+    int fad_division;
+    /// @brief The time-based backoff scheme of the thread (see backoff.h), initialized during thread's first operation.
+    SynchBackoffStruct backoff;
+    /// @brief A ring buffer of `retired_capacity` slots with batches of dequeued nodes that wait to be recycled.
+    PWFCombQueueRetiredBatch *retired;
+    uint32_t retired_capacity;
+    uint32_t retired_head;
+    uint32_t retired_size;
+    /// @brief The number of batches (starting from `retired_head`) that are tagged with a reclamation epoch.
+    uint32_t retired_tagged;
+    /// @brief The number of dequeue combining rounds that the thread has installed.
+    uint64_t retired_rounds;
 } PWFCombQueueThreadState;
 
 
@@ -88,18 +123,26 @@ typedef struct PWFCombQueueStruct {
     // Do not set this as const node
     Node guard CACHE_ALIGN;
     // Pointers to shared data
-    ToggleVector activate_enq[_SIM_PERSISTENT_FAD_DIVISIONS_] CACHE_ALIGN;
-    ToggleVector activate_deq[_SIM_PERSISTENT_FAD_DIVISIONS_];
+    ToggleVector *activate_enq CACHE_ALIGN;
+    ToggleVector *activate_deq;
+    /// @brief The number of `activate` divisions (i.e. one per NUMA node) for both enqueues and dequeues.
+    uint32_t fad_divisions;
     PWFCombQueueEnqRec ** volatile EState;
     PWFCombQueueDeqState ** volatile DState;
     volatile uint64_t ** Eflush;
     volatile uint64_t ** Dflush;
     PWFCombRequestRec * volatile ERequest;
     PWFCombRequestRec * volatile DRequest;
-    volatile uint64_t ** Ecomb_round;
-    volatile uint64_t ** Dcomb_round;
+    /// @brief Arrays of PWFCombRoundRec structs, one for each copy of the enqueue and the dequeue state respectively.
+    PWFCombRoundRec ** Erounds;
+    PWFCombRoundRec ** Drounds;
+    /// @brief An array of reservations, one per thread, used for deciding when the dequeued nodes could be recycled.
+    PWFCombQueueReservation *reservations;
     uint32_t nthreads;
+    /// @brief The maximum backoff delay (in nanoseconds) that could be used by this instance of PWFqueue.
     int MAX_BACK;
+    /// @brief The current reclamation epoch, which is increased each time that a thread tries to recycle dequeued nodes.
+    volatile uint64_t reclaim_epoch CACHE_ALIGN;
 } PWFCombQueueStruct;
 
 /// @brief This function initializes an instance of the PWFqueue persistent queue implementation.
@@ -108,8 +151,12 @@ typedef struct PWFCombQueueStruct {
 ///
 /// @param queue A pointer to an instance of the PWFqueue persistent queue implementation.
 /// @param nthreads The number of threads that will use the PWFqueue persistent queue implementation.
-/// @param max_backoff The maximum value for backoff (usually this is much lower than 100).
-void PWFCombQueueInit(PWFCombQueueStruct *queue, uint32_t nthreads, int max_backoff);
+/// @param numa_nodes The number of NUMA nodes (which may differ with the actual hw numa nodes) that PWFqueue should consider
+/// for dividing the `activate` toggles. In case that numa_nodes is equal to _SIM_PERSISTENT_AUTO_FAD_DIVISIONS_,
+/// the number of NUMA nodes provided by the HW is used.
+/// @param max_backoff The maximum backoff delay in units of 100 nanoseconds. The actual delay is tuned automatically
+/// by each thread. In case that max_backoff is equal to 0, the maximum delay is equal to SYNCH_BACKOFF_AUTO_MAX_NS.
+void PWFCombQueueInit(PWFCombQueueStruct *queue, uint32_t nthreads, uint32_t numa_nodes, int max_backoff);
 
 /// @brief This function should be called once before the thread applies any operation to the PWFqueue concurrent queue implementation.
 ///
@@ -128,6 +175,11 @@ void PWFCombQueueThreadStateInit(PWFCombQueueStruct *queue, PWFCombQueueThreadSt
 void PWFCombQueueEnqueue(PWFCombQueueStruct *queue, PWFCombQueueThreadState *th_state, ArgVal arg, int pid);
 
 /// @brief This function removes (i.e. dequeues) an element from the front of the queue and returns its value.
+/// The nodes removed by a combining round are recycled by the combiner that installed the round (see synchRecycleObj),
+/// once no thread could still access them. A node could be accessed either by a thread that applies an operation
+/// on an older copy of the dequeue state, or through the `first` field of the current enqueue state. Thus, a batch
+/// of removed nodes is tagged with a reclamation epoch only after a newer enqueue state is installed, and it is
+/// recycled when every thread that applies an operation has observed a newer epoch.
 ///
 /// @param queue A pointer to an instance of the PWFqueue persistent queue implementation.
 /// @param th_state A pointer to thread's local state of PWFqueue.
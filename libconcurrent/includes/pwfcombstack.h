@@ -21,7 +21,6 @@
 typedef struct PWFCombStackRec {
     /// @brief A vector of toggles, one per running thread. This toggle indicates if the corresponding running thread has a peding request or not.
     ToggleVector deactivate;
-    ToggleVector index;
     /// @brief A pointer to the array of return values.
     Object *return_val;
     /// @brief The head pointer that points to most-top element of the stack.
@@ -33,7 +32,7 @@ typedef struct PWFCombStackRec {
 } PWFCombStackRec;
 
 /// @brief A macro for calculating the size of the PWFCombStackRec struct for a specific amount of threads.
-#define PWFCombStackStateSize(nthreads) (sizeof(PWFCombStackRec) + 2 * _TVEC_VECTOR_SIZE(nthreads) + nthreads * sizeof(Object) + sizeof(Node *))
+#define PWFCombStackStateSize(nthreads) (sizeof(PWFCombStackRec) + _TVEC_VECTOR_SIZE(nthreads) + nthreads * sizeof(Object) + sizeof(Node *))
 
 /// @brief PWFCombStackThreadState stores each thread's local state for a single instance of PWFstack.
 /// For each instance of PWFstack, a discrete instance of PWFCombStackThreadState should be used.
@@ -42,12 +41,14 @@ typedef struct PWFCombStackThreadState {
     ToggleVector mask;
     ToggleVector index;
     ToggleVector diffs;
-    ToggleVector diffs_copy;
     ToggleVector l_activate;
     ToggleVector pops;
+    /// @brief The position of the thread in its pool of copies of stack's state.
     int local_index;
-    /// @brief Current backoff value.
-    int backoff;
+    /// @brief The `activate` division where the thread announces its requests.
+    int fad_division;
+    /// @brief The time-based backoff scheme of the thread (see backoff.h), initialized during thread's first operation.
+    SynchBackoffStruct backoff;
 } PWFCombStackThreadState;
 
 typedef struct PWFCombStackPersistentState{
@@ -59,18 +60,21 @@ typedef struct PWFCombStackPersistentState{
 /// PWFCombStackStruct should be initialized using the PWFCombStackStructInit function.
 typedef struct PWFCombStackStruct {
     volatile PWFCombStackPersistentState *pstate;
-    /// @brief A vector of toggle bits, one toggle per NUMA node. The object could also work fine with a single such toggle.
-    /// However, by using one toggle per NUMA node, the performance is increased substantially.
-    ToggleVector activate[_SIM_PERSISTENT_FAD_DIVISIONS_] CACHE_ALIGN;
+    /// @brief An array of toggle vectors, one vector per NUMA node (i.e. per `activate` division). The object could also work
+    /// fine with a single such vector. However, by using one vector per NUMA node, the performance is increased substantially.
+    ToggleVector *activate CACHE_ALIGN;
+    /// @brief The number of `activate` divisions.
+    uint32_t fad_divisions;
     /// @brief An array of pools (one pool per thread) of PWFCombStackRec structs.
     PWFCombStackRec ** volatile mem_state;
     volatile uint64_t ** flush;
     /// @brief Pointer to an array, where threads announce the requests (i.e. pushes and pops) that want to perform to the object.
     PWFCombRequestRec * volatile request;
-    volatile uint64_t ** comb_round;
+    /// @brief An array of PWFCombRoundRec structs, one for each PWFCombStackRec struct of `mem_state`.
+    PWFCombRoundRec ** rounds;
     /// @brief The number of threads that use this instance of PWFstack.
     uint32_t nthreads;
-    /// @brief The maximum backoff value that could be used by this instance of PWFstack.
+    /// @brief The maximum backoff delay (in nanoseconds) that could be used by this instance of PWFstack.
     int MAX_BACK;
 } PWFCombStackStruct;
 
@@ -81,8 +85,12 @@ typedef struct PWFCombStackStruct {
 ///  
 /// @param stack A pointer to an instance of the PWFstack persistent stack implementation.
 /// @param nthreads The number of threads that will use the PWFstack persistent stack implementation.
-/// @param max_backoff The maximum value for backoff (usually this is lower than 100).
-void PWFCombStackInit(PWFCombStackStruct *stack, uint32_t nthreads, int max_backoff);
+/// @param numa_nodes The number of NUMA nodes (which may differ with the actual hw numa nodes) that PWFstack should consider
+/// for dividing the `activate` toggles. In case that numa_nodes is equal to _SIM_PERSISTENT_AUTO_FAD_DIVISIONS_,
+/// the number of NUMA nodes provided by the HW is used.
+/// @param max_backoff The maximum backoff delay in units of 100 nanoseconds. The actual delay is tuned automatically
+/// by each thread. In case that max_backoff is equal to 0, the maximum delay is equal to SYNCH_BACKOFF_AUTO_MAX_NS.
+void PWFCombStackInit(PWFCombStackStruct *stack, uint32_t nthreads, uint32_t numa_nodes, int max_backoff);
 
 /// @brief This function should be called once by each thread before it applies any operation to the PWFstack persistent stack implementation.
 ///
@@ -0,0 +1,176 @@
+/// @file replica.h
+/// @brief This file exposes the API of a simple asynchronous replication object for persistent combining objects (i.e. PBcomb and PWFcomb).
+/// After each committed combining round, the combiner appends a copy of the committed state of the simulated object to a bounded ring.
+/// A dedicated shipper thread consumes this ring and applies the latest state to a mirror object that is stored in a separate
+/// memory-mapped file (the mirror file may live on a different device or may be opened by another process).
+/// Since each entry of the ring is a complete snapshot of object's state, a newer entry always supersedes an older one.
+/// Thus, the shipper coalesces all the pending entries and persists only the most recent of them, while the combiners never block
+/// on the replication object: whenever the ring is full, the state is stored to a single overflow entry that always keeps
+/// the most recent of the states that did not fit in the ring.
+/// Notice that the replication object copies the bytes of the `state` area of the simulated object. Thus, it is suitable for objects
+/// with a self-contained state (e.g. PBheap, atomic counters, etc.) and not for objects whose state consists of pointers to nodes
+/// allocated by the primary (e.g. PBqueue or PBstack).
+#ifndef _REPLICA_H_
+#define _REPLICA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <config.h>
+#include <primitives.h>
+
+/// @brief The default number of entries of the replication ring.
+#define SYNCH_REPLICA_RING_SIZE 64
+
+/// @brief A magic number that is stored in the header of each mirror file.
+#define SYNCH_REPLICA_MAGIC     0x5359434852455031ULL
+
+/// @brief This struct describes a single entry of the replication ring.
+typedef struct SynchReplicaEntry {
+    /// @brief A sequence number that indicates if the entry is free or if it contains a published state.
+    volatile uint64_t seq;
+    /// @brief The combining round that produced the state stored in this entry.
+    uint64_t round;
+    /// @brief A dummy field, the copy of object's state follows.
+    uint64_t data[0];
+} SynchReplicaEntry;
+
+/// @brief This struct describes the header of the mirror file. Two slots for the mirrored state follow this header,
+/// each of them `slot_size` bytes long. The shipper always writes and persists the inactive slot, and then publishes it
+/// by persisting the `commit` word. Since `commit` is a single word, a crash at any point leaves the mirror with
+/// either the previous or the new state, together with the round that this state corresponds to.
+typedef struct SynchReplicaMirror {
+    /// @brief It is equal to SYNCH_REPLICA_MAGIC for any valid mirror file.
+    uint64_t magic;
+    /// @brief The size (in bytes) of the mirrored state.
+    uint64_t state_size;
+    /// @brief The distance (in bytes) between the two slots of the mirrored state.
+    uint64_t slot_size;
+    /// @brief The active slot and the combining round of the primary object that it corresponds to,
+    /// encoded as `(round << 1) | slot` (see SYNCH_REPLICA_COMMIT_ROUND and SYNCH_REPLICA_COMMIT_SLOT).
+    volatile uint64_t commit;
+    /// @brief Padding space.
+    uint64_t pad[4];
+    /// @brief A dummy field, the two slots of the mirrored state follow.
+    uint64_t data[0];
+} SynchReplicaMirror;
+
+/// @brief This macro returns the combining round stored in the `commit` word of a mirror.
+#define SYNCH_REPLICA_COMMIT_ROUND(commit)  ((commit) >> 1)
+/// @brief This macro returns the active slot stored in the `commit` word of a mirror.
+#define SYNCH_REPLICA_COMMIT_SLOT(commit)   ((commit) & 1)
+
+/// @brief This function returns a pointer to the active slot of a mirror, i.e. the latest state that has been persisted
+/// completely. It could be used on a mirror file that is mapped by another process (e.g. a standby that recovers after a crash).
+///
+/// @param mirror A pointer to a mapped mirror file.
+/// @param round In case that it is not NULL, the combining round of the returned state is stored in `*round`.
+/// @return A pointer to the mirrored state, or NULL in case that the file is not a valid mirror file.
+static inline void *synchReplicaMirrorData(SynchReplicaMirror *mirror, uint64_t *round) {
+    uint64_t commit = mirror->commit;
+
+    if (mirror->magic != SYNCH_REPLICA_MAGIC)
+        return NULL;
+    if (round != NULL)
+        *round = SYNCH_REPLICA_COMMIT_ROUND(commit);
+    return (char *)mirror->data + SYNCH_REPLICA_COMMIT_SLOT(commit) * mirror->slot_size;
+}
+
+/// @brief SynchReplicaStruct stores the state of an instance of the replication object.
+/// SynchReplicaStruct should be initialized using the synchReplicaInit function.
+typedef struct SynchReplicaStruct {
+    /// @brief The ring of entries where combiners publish the committed states.
+    volatile char *ring;
+    /// @brief The number of entries of the ring (a power of 2).
+    uint32_t ring_size;
+    /// @brief The size (in bytes) of each entry of the ring.
+    uint32_t entry_size;
+    /// @brief The size (in bytes) of the replicated state.
+    uint32_t state_size;
+    /// @brief An entry used whenever the ring is full. Its `seq` field is odd while a combiner writes to it.
+    SynchReplicaEntry *overflow;
+    /// @brief The value of the `seq` field of the overflow entry the last time that the shipper consumed it.
+    uint64_t overflow_seen;
+    /// @brief A pointer to the memory-mapped mirror file.
+    SynchReplicaMirror *mirror;
+    /// @brief The size (in bytes) of the memory-mapped mirror file.
+    size_t mirror_size;
+    /// @brief A buffer used by the shipper for coalescing the pending states.
+    void *staging;
+    /// @brief The thread that applies the published states to the mirror.
+    pthread_t shipper;
+    /// @brief This field is true while the shipper thread is running.
+    volatile bool running;
+    /// @brief The next entry of the ring that a combiner should use.
+    volatile uint64_t head CACHE_ALIGN;
+    /// @brief The most recent combining round that has been published to the ring.
+    volatile uint64_t published_round;
+    /// @brief The number of states that were stored to the overflow entry because the ring was full.
+    volatile uint64_t overflows;
+    /// @brief The number of states that were dropped because both the ring and the overflow entry were busy.
+    volatile uint64_t dropped;
+    /// @brief The next entry of the ring that the shipper should consume.
+    volatile uint64_t tail CACHE_ALIGN;
+    /// @brief The most recent combining round that has been persisted to the mirror.
+    volatile uint64_t applied_round;
+    /// @brief The number of states consumed by the shipper.
+    volatile uint64_t shipped;
+    /// @brief The number of times that the shipper has persisted a state to the mirror.
+    volatile uint64_t mirror_writes;
+    /// @brief The maximum lag (in combining rounds) observed by the shipper.
+    volatile uint64_t max_lag;
+} SynchReplicaStruct;
+
+/// @brief This function initializes an instance of the replication object and creates (or truncates) its mirror file.
+/// It should be called once (by a single thread) before the replication object is attached to a PBcomb or PWFcomb instance.
+///
+/// @param r A pointer to an instance of the replication object.
+/// @param path The path of the mirror file. In case that path is NULL, an unnamed (i.e. unlinked) file is created
+/// in the SYNCH_PERSISTENT_DEV_PATH or the SYNCH_PERSISTENT_DEV_PATH_FALLBACK directory.
+/// @param state_size The size (in bytes) of the state of the replicated object.
+/// @param ring_size The number of entries of the replication ring; it is rounded up to a power of 2.
+/// In case that ring_size is equal to 0, SYNCH_REPLICA_RING_SIZE is used.
+/// @return On success, 0 is returned. Otherwise, -1 is returned.
+int synchReplicaInit(SynchReplicaStruct *r, const char *path, uint32_t state_size, uint32_t ring_size);
+
+/// @brief This function spawns the shipper thread of the replication object.
+///
+/// @param r A pointer to an instance of the replication object.
+/// @return On success, 0 is returned. Otherwise, -1 is returned.
+int synchReplicaStart(SynchReplicaStruct *r);
+
+/// @brief This function waits until the shipper has applied all the published states to the mirror and then stops it.
+///
+/// @param r A pointer to an instance of the replication object.
+void synchReplicaStop(SynchReplicaStruct *r);
+
+/// @brief This function is used by the combiners for publishing the state of a committed combining round.
+/// It never blocks; in case that the ring is full, the state is stored to the overflow entry. In the rare case
+/// that another combiner concurrently writes the overflow entry, the state is dropped.
+///
+/// @param r A pointer to an instance of the replication object.
+/// @param round The combining round that produced the state. Rounds should be monotonically increasing.
+/// @param state A pointer to the committed state (state_size bytes are copied).
+/// @return In case that the state is published, true is returned. Otherwise, false is returned.
+bool synchReplicaAppend(SynchReplicaStruct *r, uint64_t round, void *state);
+
+/// @brief This function returns the current lag of the replica, i.e. the number of combining rounds
+/// that have been published, but they are not yet persisted to the mirror.
+///
+/// @param r A pointer to an instance of the replication object.
+/// @return The lag of the replica in combining rounds.
+uint64_t synchReplicaLag(SynchReplicaStruct *r);
+
+/// @brief This function returns a pointer to the mirrored state, i.e. the active slot of the mirror.
+///
+/// @param r A pointer to an instance of the replication object.
+/// @return A pointer to the mirrored state.
+void *synchReplicaMirrorState(SynchReplicaStruct *r);
+
+/// @brief This function unmaps the mirror file and frees all the memory allocated by the replication object.
+/// The shipper thread should have been stopped using synchReplicaStop.
+///
+/// @param r A pointer to an instance of the replication object.
+void synchReplicaDestroy(SynchReplicaStruct *r);
+
+#endif
@@ -0,0 +1,139 @@
+/// @file shadow.h
+/// @brief This file exposes the API of a shadow image of persistent memory that is used for crash-injection testing.
+/// Whenever the shadow image is enabled, each PWB (i.e. synchFlushPersistentMemory) records a snapshot of the
+/// written-back cache lines in a per-thread buffer and each PSYNC (i.e. synchDrainPersistentMemory) appends the
+/// buffered snapshots to a log. Thus, the log contains only the bytes that are guaranteed to be persisted,
+/// i.e. their contents at the time they were written back, and only after a subsequent PSYNC.
+/// The log is stored in a shared memory mapping, so it survives the crash of a child process (see `fork`).
+/// Moreover, every PWB and PSYNC is a numbered persist event and the process can be killed (using SIGKILL)
+/// just before a chosen event. After the crash, the parent process builds a view of the log and reads
+/// the persisted contents of any address of the crashed process through it, e.g. for running a recovery routine.
+/// An example of use is provided in benchmarks/crashbench.c file.
+#ifndef _SHADOW_H_
+#define _SHADOW_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/// @brief The size (in bytes) of each cache line recorded by the shadow image.
+#define SYNCH_SHADOW_LINE_SIZE      64
+
+/// @brief The number of written-back cache lines that each thread buffers until its next PSYNC.
+/// In case that the buffer is full, the buffered lines are appended to the log, as if they were persisted early.
+#define SYNCH_SHADOW_PENDING_LINES  256
+
+/// @brief The maximum number of roots that the shadow image stores (see synchShadowSetRoot).
+#define SYNCH_SHADOW_ROOTS          8
+
+/// @brief This struct describes a persisted cache line.
+typedef struct SynchShadowLine {
+    /// @brief The address of the cache line. It is equal to 0 while the entry is not completely written.
+    volatile uint64_t addr;
+    /// @brief A global sequence number taken just before the contents of the line were captured by a PWB.
+    /// The entries of the log are appended in the order of PSYNCs, thus the latest contents of a line
+    /// are those with the largest stamp and not the last entry of the log.
+    uint64_t stamp;
+    /// @brief The contents of the cache line at the time it was written back.
+    uint8_t data[SYNCH_SHADOW_LINE_SIZE];
+} SynchShadowLine;
+
+/// @brief This struct describes the shared log of the shadow image.
+typedef struct SynchShadowLog {
+    /// @brief The number of persist events (i.e. PWBs and PSYNCs) executed since the last synchShadowReset.
+    volatile uint64_t events;
+    /// @brief The process is killed just before the `crash_at`-th persist event; 0 means never.
+    volatile uint64_t crash_at;
+    /// @brief The number of entries of the log that are reserved.
+    volatile uint64_t size;
+    /// @brief The next stamp that a PWB assigns to a captured cache line.
+    volatile uint64_t stamps;
+    /// @brief The maximum number of entries of the log.
+    uint64_t capacity;
+    /// @brief It is true in case that some persisted cache lines did not fit in the log.
+    volatile bool overflow;
+    /// @brief Addresses published by the crashed process for locating its persistent objects.
+    volatile uint64_t roots[SYNCH_SHADOW_ROOTS];
+    /// @brief The entries of the log.
+    SynchShadowLine lines[0];
+} SynchShadowLog;
+
+/// @brief This struct describes a view of the log, i.e. the latest persisted contents of each recorded cache line.
+typedef struct SynchShadowView {
+    /// @brief The recorded cache lines sorted by address; each address appears once, with its most recently captured contents.
+    SynchShadowLine *lines;
+    /// @brief The number of recorded cache lines.
+    uint64_t nlines;
+} SynchShadowView;
+
+/// @brief This flag is true in case that the shadow image is enabled.
+extern bool synch_persist_shadow;
+
+/// @brief This function creates the shared log of the shadow image and enables the recording of persist events.
+/// It should be called once (by a single thread) before any persistent object is created.
+///
+/// @param capacity The maximum number of cache lines that the log stores.
+/// @return On success, 0 is returned. Otherwise, -1 is returned.
+int synchShadowInit(uint64_t capacity);
+
+/// @brief This function disables the shadow image and unmaps its log.
+void synchShadowDestroy(void);
+
+/// @brief This function clears the log, the roots and the counter of persist events.
+/// It should be called while no other thread or process uses the shadow image.
+///
+/// @param crash_at The calling process (or any child forked afterwards) is killed just before its `crash_at`-th
+/// persist event. In case that `crash_at` is equal to 0, the process is never killed.
+void synchShadowReset(uint64_t crash_at);
+
+/// @brief This function returns the number of persist events executed since the last synchShadowReset.
+///
+/// @return The number of persist events.
+uint64_t synchShadowEvents(void);
+
+/// @brief This function publishes an address that is needed for locating a persistent object after a crash.
+///
+/// @param i The index of the root; it should be smaller than SYNCH_SHADOW_ROOTS.
+/// @param ptr The published address.
+void synchShadowSetRoot(int i, void *ptr);
+
+/// @brief This function returns an address published by synchShadowSetRoot.
+///
+/// @param i The index of the root.
+/// @return The published address, or NULL in case that the root was not published.
+void *synchShadowGetRoot(int i);
+
+/// @brief This function returns true in case that some persisted cache lines did not fit in the log,
+/// i.e. the contents of the view may be stale.
+bool synchShadowOverflow(void);
+
+/// @brief This function records a PWB. It is called by synchFlushPersistentMemory whenever the shadow image is enabled.
+///
+/// @param ptr A pointer to the memory range.
+/// @param size The size (in bytes) of the memory range.
+void synchShadowPWB(void *ptr, size_t size);
+
+/// @brief This function records a PSYNC. It is called by synchDrainPersistentMemory whenever the shadow image is enabled.
+void synchShadowPSync(void);
+
+/// @brief This function builds a view of the log.
+///
+/// @param view A pointer to the view.
+/// @return On success, 0 is returned. Otherwise, -1 is returned.
+int synchShadowBuildView(SynchShadowView *view);
+
+/// @brief This function frees the memory of a view.
+///
+/// @param view A pointer to the view.
+void synchShadowFreeView(SynchShadowView *view);
+
+/// @brief This function reads the persisted contents of a memory range of the crashed process.
+///
+/// @param view A pointer to the view.
+/// @param addr The address of the memory range in the address space of the crashed process.
+/// @param buf A pointer to a buffer of at least `size` bytes, where the persisted contents are stored.
+/// @param size The size (in bytes) of the memory range.
+/// @return In case that all the bytes of the range are persisted, true is returned. Otherwise, false is returned.
+bool synchShadowRead(SynchShadowView *view, const void *addr, void *buf, size_t size);
+
+#endif
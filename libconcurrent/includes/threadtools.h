@@ -47,6 +47,14 @@ inline uint32_t synchPreferedCoreOfThread(uint32_t pid);
 /// @brief This function returns the number of system's processing cores.
 inline uint32_t synchGetNCores(void);
 
+/// @brief This function returns the number of NUMA nodes that the running threads may use.
+/// In case that SYNCH_NUMA_SUPPORT is not defined in libconcurrent/config.h, this function returns 1.
+inline uint32_t synchGetNumaNodes(void);
+
+/// @brief This function returns the NUMA node of the core that the current posix thread or fiber is pinned to.
+/// In case that SYNCH_NUMA_SUPPORT is not defined in libconcurrent/config.h, this function returns 0.
+inline uint32_t synchGetPreferedNumaNode(void);
+
 /// @brief In case that this function is called by a posix thread, it hints OS to give the CPU to
 /// some other thread. In case that this function is called by a fiber, it gives the CPU control 
 /// to the next fiber (if any) running in the same posix thread.
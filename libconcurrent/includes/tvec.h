@@ -1,148 +1,230 @@
-#include <string.h>
-#include <primitives.h>
-
-#ifndef _TVEC_H_
-#    define _TVEC_H_
-
-#    define bitword_t                  uint64_t
-#    define _TVEC_DIVISION_SHIFT_BITS_ 6
-#    define _TVEC_MODULO_BITS_         63
-#    define _TVEC_BIWORD_SIZE_         64
-
-/* automatic partial unrolling*/
-#    define _TVEC_CELLS_(N)      ((N >> _TVEC_DIVISION_SHIFT_BITS_) + 1)
-#    define _TVEC_VECTOR_SIZE(N) (_TVEC_CELLS_(N) * sizeof(bitword_t))
-#    define LOOP(EXPR, I, TIMES) {for (I = 0; I < TIMES; I++) {EXPR;}}
-
-typedef struct ToggleVector {
-    uint32_t nthreads;
-    uint32_t tvec_cells;
-    bitword_t *cell;
-} ToggleVector;
-
-// Operations that handle banks of bits and not the whole vectors
-// --------------------------------------------------------------
-
-static inline int TVEC_GET_BANK_OF_BIT(int bit, uint32_t nthreads) {
-    if (nthreads > _TVEC_BIWORD_SIZE_)
-        return bit >> _TVEC_DIVISION_SHIFT_BITS_;
-    else
-        return 0;
-}
-
-static inline void TVEC_ATOMIC_COPY_BANKS(ToggleVector *tv1, ToggleVector *tv2, int bank) {
-    tv1->cell[bank] = tv2->cell[bank];
-}
-
-static inline void TVEC_ATOMIC_ADD_BANK(volatile ToggleVector *tv1, ToggleVector *tv2, int bank) {
-#    if _TVEC_BIWORD_SIZE_ == 32
-    synchFAA32(&tv1->cell[bank], tv2->cell[bank]);
-#    else
-    synchFAA64(&tv1->cell[bank], tv2->cell[bank]);
-#    endif
-}
-
-static inline void TVEC_NEGATIVE_BANK(ToggleVector *tv1, ToggleVector *tv2, int bank) {
-    tv1->cell[bank] = -tv2->cell[bank];
-}
-
-static inline void TVEC_XOR_BANKS(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2, int bank) {
-    res->cell[bank] = tv1->cell[bank] ^ tv2->cell[bank];
-}
-
-static inline void TVEC_AND_BANKS(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2, int bank) {
-    res->cell[bank] = tv1->cell[bank] & tv2->cell[bank];
-}
-
-// Operations that handle whole vectors of bits
-// --------------------------------------------
-
-static inline void TVEC_INIT(ToggleVector *tv1, uint32_t nthreads) {
-    int i;
-
-    tv1->nthreads = nthreads;
-    tv1->tvec_cells = _TVEC_CELLS_(nthreads);
-    tv1->cell = synchGetMemory(_TVEC_VECTOR_SIZE(nthreads));
-    LOOP(tv1->cell[i] = 0L, i, tv1->tvec_cells);
-}
-
-static inline void TVEC_INIT_AT(ToggleVector *tv1, uint32_t nthreads, void *ptr) {
-    int i;
-
-    tv1->nthreads = nthreads;
-    tv1->tvec_cells = _TVEC_CELLS_(nthreads);
-    tv1->cell = ptr;
-    LOOP(tv1->cell[i] = 0L, i, tv1->tvec_cells);
-}
-
-static inline void TVEC_SET_ZERO(ToggleVector *tv1) {
-    int i;
-
-    LOOP(tv1->cell[i] = 0L, i, tv1->tvec_cells);
-}
-
-static inline void TVEC_COPY(ToggleVector *dest, ToggleVector *src) {
-    memcpy(dest->cell, src->cell, _TVEC_VECTOR_SIZE(dest->nthreads));
-}
-
-static inline void TVEC_NEGATIVE(ToggleVector *res, ToggleVector *tv) {
-    int i = 0;
-
-    LOOP(res->cell[i] = -tv->cell[i], i, res->tvec_cells);
-}
-
-static inline void TVEC_REVERSE_BIT(ToggleVector *tv1, int bit) {
-    int i, offset;
-
-    i = bit >> _TVEC_DIVISION_SHIFT_BITS_;
-    offset = bit & _TVEC_MODULO_BITS_;
-    tv1->cell[i] ^= ((bitword_t)1) << offset;
-}
-
-static inline void TVEC_SET_BIT(ToggleVector *tv1, int bit) {
-    int i, offset;
-
-    i = bit >> _TVEC_DIVISION_SHIFT_BITS_;
-    offset = bit & _TVEC_MODULO_BITS_;
-    tv1->cell[i] |= ((bitword_t)1) << offset;
-}
-
-static inline bool TVEC_IS_SET(ToggleVector *tv1, int pid) {
-    int i, offset;
-
-    i = pid >> _TVEC_DIVISION_SHIFT_BITS_;
-    offset = pid & _TVEC_MODULO_BITS_;
-    // Commented code is optimized to avoid branches
-    // if ( (tv1.cell[i] & (1 << offset)) ==  0) return false;
-    // else return true;
-    return (tv1->cell[i] >> offset) & 1;
-}
-
-static inline void TVEC_OR(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2) {
-    int i;
-
-    LOOP(res->cell[i] = tv1->cell[i] | tv2->cell[i], i, res->tvec_cells);
-}
-
-static inline void TVEC_AND(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2) {
-    int i;
-
-    LOOP(res->cell[i] = tv1->cell[i] & tv2->cell[i], i, res->tvec_cells);
-}
-
-static inline void TVEC_XOR(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2) {
-    int i;
-
-    LOOP(res->cell[i] = tv1->cell[i] ^ tv2->cell[i], i, res->tvec_cells);
-}
-
-static inline int TVEC_COUNT_BITS(ToggleVector *tv) {
-    int i, count;
-
-    count = 0;
-    LOOP(count += synchNonZeroBits(tv->cell[i]), i, tv->tvec_cells);
-
-    return count;
-}
-
-#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <primitives.h>
+
+#ifndef _TVEC_H_
+#    define _TVEC_H_
+
+#    define bitword_t                  uint64_t
+#    define _TVEC_DIVISION_SHIFT_BITS_ 6
+#    define _TVEC_MODULO_BITS_         63
+#    define _TVEC_BIWORD_SIZE_         64
+
+/* automatic partial unrolling*/
+// TVEC_CELLS(tv) is the number of words of the toggle vector tv; in case that the width of the vectors
+// is fixed at compile time (see SYNCH_TVEC_MAX_THREADS in config.h), it is a constant
+#    ifdef SYNCH_TVEC_MAX_THREADS
+#        define _TVEC_CELLS_(N)  ((SYNCH_TVEC_MAX_THREADS + _TVEC_BIWORD_SIZE_ - 1) >> _TVEC_DIVISION_SHIFT_BITS_)
+#        define TVEC_CELLS(tv)   _TVEC_CELLS_(0)
+#    else
+#        define _TVEC_CELLS_(N)  ((N >> _TVEC_DIVISION_SHIFT_BITS_) + 1)
+#        define TVEC_CELLS(tv)   ((tv)->tvec_cells)
+#    endif
+#    define _TVEC_VECTOR_SIZE(N) (_TVEC_CELLS_(N) * sizeof(bitword_t))
+#    define LOOP(EXPR, I, TIMES) {for (I = 0; I < TIMES; I++) {EXPR;}}
+
+/// @brief Toggle vectors of at least _TVEC_SIMD_MIN_CELLS_ cells (i.e. for 192 threads or more) are processed by the
+/// SIMD kernels of tvec.c, which are selected at runtime according to the instruction sets that the processor supports.
+/// Smaller vectors are processed by inlined scalar code, since the cost of a function call is higher than the gain.
+#    define _TVEC_SIMD_MIN_CELLS_ 4
+
+#    define TVEC_SIMD_NONE   0
+#    define TVEC_SIMD_AVX2   1
+#    define TVEC_SIMD_AVX512 2
+
+typedef struct ToggleVector {
+    uint32_t nthreads;
+    uint32_t tvec_cells;
+    bitword_t *cell;
+} ToggleVector;
+
+/// @brief The widest SIMD instruction set (i.e. TVEC_SIMD_NONE, TVEC_SIMD_AVX2 or TVEC_SIMD_AVX512) that is used by the toggle vector kernels.
+/// It is detected using CPUID during the startup of the program.
+extern int synch_tvec_simd;
+
+/// @brief res = a | b for vectors of `cells` cells.
+void synchTVecOr(bitword_t *res, bitword_t *a, bitword_t *b, uint32_t cells);
+/// @brief res = a ^ b for vectors of `cells` cells.
+void synchTVecXor(bitword_t *res, bitword_t *a, bitword_t *b, uint32_t cells);
+/// @brief res = tvs[0] | tvs[1] | ... | tvs[n - 1] for vectors of `cells` cells.
+void synchTVecOrReduce(bitword_t *res, ToggleVector *tvs, uint32_t n, uint32_t cells);
+/// @brief It returns the first cell that is not equal to 0, starting from cell `from`; `cells` is returned in case that there is no such cell.
+uint32_t synchTVecNextCell(bitword_t *cell, uint32_t from, uint32_t cells);
+
+// Operations that handle banks of bits and not the whole vectors
+// --------------------------------------------------------------
+
+static inline int TVEC_GET_BANK_OF_BIT(int bit, uint32_t nthreads) {
+#    if defined(SYNCH_TVEC_MAX_THREADS) && SYNCH_TVEC_MAX_THREADS <= _TVEC_BIWORD_SIZE_
+    return 0;
+#    else
+    if (nthreads > _TVEC_BIWORD_SIZE_)
+        return bit >> _TVEC_DIVISION_SHIFT_BITS_;
+    else
+        return 0;
+#    endif
+}
+
+static inline void TVEC_ATOMIC_COPY_BANKS(ToggleVector *tv1, ToggleVector *tv2, int bank) {
+    tv1->cell[bank] = tv2->cell[bank];
+}
+
+static inline void TVEC_ATOMIC_ADD_BANK(volatile ToggleVector *tv1, ToggleVector *tv2, int bank) {
+#    if _TVEC_BIWORD_SIZE_ == 32
+    synchFAA32(&tv1->cell[bank], tv2->cell[bank]);
+#    else
+    synchFAA64(&tv1->cell[bank], tv2->cell[bank]);
+#    endif
+}
+
+static inline void TVEC_NEGATIVE_BANK(ToggleVector *tv1, ToggleVector *tv2, int bank) {
+    tv1->cell[bank] = -tv2->cell[bank];
+}
+
+static inline void TVEC_XOR_BANKS(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2, int bank) {
+    res->cell[bank] = tv1->cell[bank] ^ tv2->cell[bank];
+}
+
+static inline void TVEC_AND_BANKS(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2, int bank) {
+    res->cell[bank] = tv1->cell[bank] & tv2->cell[bank];
+}
+
+// Operations that handle whole vectors of bits
+// --------------------------------------------
+
+static inline void TVEC_CHECK_WIDTH(uint32_t nthreads) {
+#    ifdef SYNCH_TVEC_MAX_THREADS
+    if (nthreads > SYNCH_TVEC_MAX_THREADS) {
+        fprintf(stderr, "ERROR: toggle vectors are configured for at most %d threads (see SYNCH_TVEC_MAX_THREADS)\n", SYNCH_TVEC_MAX_THREADS);
+        exit(EXIT_FAILURE);
+    }
+#    endif
+}
+
+static inline void TVEC_INIT(ToggleVector *tv1, uint32_t nthreads) {
+    int i;
+
+    TVEC_CHECK_WIDTH(nthreads);
+    tv1->nthreads = nthreads;
+    tv1->tvec_cells = _TVEC_CELLS_(nthreads);
+    tv1->cell = synchGetMemory(_TVEC_VECTOR_SIZE(nthreads));
+    LOOP(tv1->cell[i] = 0L, i, TVEC_CELLS(tv1));
+}
+
+static inline void TVEC_INIT_AT(ToggleVector *tv1, uint32_t nthreads, void *ptr) {
+    int i;
+
+    TVEC_CHECK_WIDTH(nthreads);
+    tv1->nthreads = nthreads;
+    tv1->tvec_cells = _TVEC_CELLS_(nthreads);
+    tv1->cell = ptr;
+    LOOP(tv1->cell[i] = 0L, i, TVEC_CELLS(tv1));
+}
+
+static inline void TVEC_SET_ZERO(ToggleVector *tv1) {
+    int i;
+
+    LOOP(tv1->cell[i] = 0L, i, TVEC_CELLS(tv1));
+}
+
+static inline void TVEC_COPY(ToggleVector *dest, ToggleVector *src) {
+    memcpy(dest->cell, src->cell, TVEC_CELLS(dest) * sizeof(bitword_t));
+}
+
+static inline void TVEC_NEGATIVE(ToggleVector *res, ToggleVector *tv) {
+    int i = 0;
+
+    LOOP(res->cell[i] = -tv->cell[i], i, TVEC_CELLS(res));
+}
+
+static inline void TVEC_REVERSE_BIT(ToggleVector *tv1, int bit) {
+    int i, offset;
+
+    i = bit >> _TVEC_DIVISION_SHIFT_BITS_;
+    offset = bit & _TVEC_MODULO_BITS_;
+    tv1->cell[i] ^= ((bitword_t)1) << offset;
+}
+
+static inline void TVEC_SET_BIT(ToggleVector *tv1, int bit) {
+    int i, offset;
+
+    i = bit >> _TVEC_DIVISION_SHIFT_BITS_;
+    offset = bit & _TVEC_MODULO_BITS_;
+    tv1->cell[i] |= ((bitword_t)1) << offset;
+}
+
+static inline bool TVEC_IS_SET(ToggleVector *tv1, int pid) {
+    int i, offset;
+
+    i = pid >> _TVEC_DIVISION_SHIFT_BITS_;
+    offset = pid & _TVEC_MODULO_BITS_;
+    // Commented code is optimized to avoid branches
+    // if ( (tv1.cell[i] & (1 << offset)) ==  0) return false;
+    // else return true;
+    return (tv1->cell[i] >> offset) & 1;
+}
+
+static inline void TVEC_OR(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2) {
+    int i;
+
+    if (TVEC_CELLS(res) >= _TVEC_SIMD_MIN_CELLS_) {
+        synchTVecOr(res->cell, tv1->cell, tv2->cell, TVEC_CELLS(res));
+        return;
+    }
+    LOOP(res->cell[i] = tv1->cell[i] | tv2->cell[i], i, TVEC_CELLS(res));
+}
+
+static inline void TVEC_AND(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2) {
+    int i;
+
+    LOOP(res->cell[i] = tv1->cell[i] & tv2->cell[i], i, TVEC_CELLS(res));
+}
+
+static inline void TVEC_XOR(ToggleVector *res, ToggleVector *tv1, ToggleVector *tv2) {
+    int i;
+
+    if (TVEC_CELLS(res) >= _TVEC_SIMD_MIN_CELLS_) {
+        synchTVecXor(res->cell, tv1->cell, tv2->cell, TVEC_CELLS(res));
+        return;
+    }
+    LOOP(res->cell[i] = tv1->cell[i] ^ tv2->cell[i], i, TVEC_CELLS(res));
+}
+
+// res = tvs[0] | tvs[1] | ... | tvs[n - 1]; each cell of tvs is read exactly once
+static inline void TVEC_OR_REDUCE(ToggleVector *res, ToggleVector *tvs, uint32_t n) {
+    uint32_t i, j;
+
+    if (TVEC_CELLS(res) >= _TVEC_SIMD_MIN_CELLS_) {
+        synchTVecOrReduce(res->cell, tvs, n, TVEC_CELLS(res));
+        return;
+    }
+    for (i = 0; i < TVEC_CELLS(res); i++) {
+        bitword_t w = 0;
+
+        for (j = 0; j < n; j++)
+            w |= tvs[j].cell[i];
+        res->cell[i] = w;
+    }
+}
+
+// returns the first cell of tv (starting from cell `from`) that contains at least one set bit, or tv->tvec_cells
+static inline uint32_t TVEC_NEXT_CELL(ToggleVector *tv, uint32_t from) {
+    if (TVEC_CELLS(tv) - from >= _TVEC_SIMD_MIN_CELLS_)
+        return synchTVecNextCell(tv->cell, from, TVEC_CELLS(tv));
+    while (from < TVEC_CELLS(tv) && tv->cell[from] == 0)
+        from++;
+
+    return from;
+}
+
+static inline int TVEC_COUNT_BITS(ToggleVector *tv) {
+    int i, count;
+
+    count = 0;
+    LOOP(count += synchNonZeroBits(tv->cell[i]), i, TVEC_CELLS(tv));
+
+    return count;
+}
+
+#endif
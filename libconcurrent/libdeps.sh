@@ -2,8 +2,8 @@
 
 LDLIBS="-lpthread -latomic";
 
-DEFINITIONS=(SYNCH_NUMA_SUPPORT SYNCH_TRACK_CPU_COUNTERS SYNCH_ENABLE_PERSISTENT_MEM);
-LIBS=("-lnuma" "-lpapi" "-lpmem -lvmem");
+DEFINITIONS=(SYNCH_NUMA_SUPPORT SYNCH_TRACK_CPU_COUNTERS SYNCH_ENABLE_PERSISTENT_MEM SYNCH_PERSIST_USE_LIBPMEM);
+LIBS=("-lnuma" "-lpapi" "-lvmem" "-lpmem");
 
 for i in ${!DEFINITIONS[@]}; do
     if grep -xq "\s*#define\s\+${DEFINITIONS[i]}\(\s*\|\s.*\)" libconcurrent/config.h
@@ -12,4 +12,10 @@ for i in ${!DEFINITIONS[@]}; do
     fi
 done
 
+# The in-tree persistence backend (see persist.h) is available only on x86_64
+if ! [[ "$LDLIBS" =~ "-lpmem" ]] && [ "$(uname -m)" != "x86_64" ]
+then
+    LDLIBS="$LDLIBS -lpmem";
+fi
+
 echo $LDLIBS;
\ No newline at end of file
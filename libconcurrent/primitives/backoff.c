@@ -1,7 +1,20 @@
+#include <time.h>
 #include <backoff.h>
+#include <primitives.h>
 #include <threadtools.h>
 #include <sched.h> // sched_yield();
 
+#define SYNCH_BACKOFF_CALIBRATION_NS 2000000
+
+static volatile uint64_t cycles_per_usec = 0;
+
+static inline int64_t getTimeNanos(void) {
+    struct timespec tm;
+
+    clock_gettime(CLOCK_MONOTONIC, &tm);
+    return tm.tv_sec * 1000000000LL + tm.tv_nsec;
+}
+
 void synchInitBackoff(SynchBackoffStruct *b, unsigned base_bits, unsigned cap_bits, unsigned shift_bits) {
     b->backoff_base_bits = base_bits;
     b->backoff_cap_bits = cap_bits;
@@ -47,3 +60,72 @@ void synchBackoffIncrease(SynchBackoffStruct *b) {
     if (b->backoff > b->backoff_cap)
         b->backoff = b->backoff_cap;
 }
+
+uint64_t synchBackoffCyclesPerMicrosecond(void) {
+    // Concurrent calibrations are harmless, since they store (almost) the same value
+    if (cycles_per_usec == 0) {
+        int64_t start_ns, end_ns;
+        uint64_t start_cycles, cycles;
+
+        start_ns = getTimeNanos();
+        start_cycles = synchGetTSC();
+        do {
+            end_ns = getTimeNanos();
+        } while (end_ns - start_ns < SYNCH_BACKOFF_CALIBRATION_NS);
+        cycles = ((synchGetTSC() - start_cycles) * 1000) / (end_ns - start_ns);
+        cycles_per_usec = (cycles > 0) ? cycles : 1;
+    }
+
+    return cycles_per_usec;
+}
+
+void synchInitTimedBackoff(SynchBackoffStruct *b, uint64_t max_ns) {
+    uint64_t cycles = synchBackoffCyclesPerMicrosecond();
+
+    if (max_ns == 0)
+        max_ns = SYNCH_BACKOFF_AUTO_MAX_NS;
+    if (max_ns < SYNCH_BACKOFF_MIN_NS)
+        max_ns = SYNCH_BACKOFF_MIN_NS;
+    b->delay_min = (SYNCH_BACKOFF_MIN_NS * cycles) / 1000;
+    b->delay_max = (max_ns * cycles) / 1000;
+    if (b->delay_min == 0)
+        b->delay_min = 1;
+    if (b->delay_max < b->delay_min)
+        b->delay_max = b->delay_min;
+    b->delay = b->delay_min;
+    b->direction = 1;
+    b->window_ops = 0;
+    b->window_start = synchGetTSC();
+    b->last_cost = 0;
+}
+
+void synchTimedBackoffDelay(SynchBackoffStruct *b) {
+#ifndef SYNCH_DISABLE_BACKOFF
+    uint64_t end = synchGetTSC() + b->delay;
+
+    while (synchGetTSC() < end)
+        ;
+#endif
+}
+
+void synchTimedBackoffTune(SynchBackoffStruct *b) {
+    uint64_t now, cost, step;
+
+    if (++b->window_ops < SYNCH_BACKOFF_TUNE_WINDOW)
+        return;
+
+    now = synchGetTSC();
+    cost = (now - b->window_start) / b->window_ops;
+    // reverse the direction in case that the last adjustment increased the cost per operation
+    if (b->last_cost != 0 && cost > b->last_cost)
+        b->direction = -b->direction;
+    b->last_cost = cost;
+
+    step = (b->delay >> 2) | 1;
+    if (b->direction > 0)
+        b->delay = (b->delay + step < b->delay_max) ? b->delay + step : b->delay_max;
+    else
+        b->delay = (b->delay > b->delay_min + step) ? b->delay - step : b->delay_min;
+    b->window_ops = 0;
+    b->window_start = now;
+}
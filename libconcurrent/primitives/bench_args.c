@@ -9,6 +9,8 @@
 #include <threadtools.h>
 #include <stdlib.h>
 
+enum { OPT_PWB_NS = 256, OPT_PSYNC_NS, OPT_NVM_BW, OPT_CRASH_POINTS, OPT_REPETITIONS, OPT_LANES, OPT_CHOICES, OPT_SEQUENCED, OPT_PRODUCERS, OPT_REPLICA };
+
 static void printHelp(const char *exec_name) {
     fprintf(stderr,
             "Usage: %s OPTION1 NUM1  OPTION2 NUM2...\n"
@@ -20,6 +22,16 @@ static void printHelp(const char *exec_name) {
             "-w,  --max_work   \t set the amount of workload (i.e. dummy loop iterations among two consecutive operations of the benchmarked object), default is 64\n"
             "-b,  --backoff, --backoff_high \t set an upper backoff bound\n"
             "-l,  --backoff_low\t set a lower backoff bound\n"
+            "     --pwb_ns     \t emulate NVM: set the cost (in nanoseconds) of writing back a single cache line\n"
+            "     --psync_ns   \t emulate NVM: set the cost (in nanoseconds) of a psync per outstanding cache line\n"
+            "     --nvm_bw     \t emulate NVM: set the bandwidth (in MB/s) of the memory channel shared by all threads\n"
+            "     --crash_points\t set the number of crash points that crash-injection benchmarks test, default is every persist event\n"
+            "     --repetitions\t set the number of times that recovery benchmarks recover each object, default is 10\n"
+            "     --lanes      \t set the number of lanes of relaxed objects (heaps per thread for PBmultiqueue), default is 4\n"
+            "     --choices    \t set the number of lanes that each removal samples in relaxed objects, default is 2\n"
+            "     --sequenced  \t order the elements of relaxed objects by global sequence numbers\n"
+            "     --producers  \t set the number of threads that only insert elements in queue benchmarks (the rest only remove elements), default is 0\n"
+            "     --replica    \t replicate the state of persistent combining objects to a mirror file by a shipper thread\n"
             "\n"
             "-h, --help        \t displays this help and exits\n",
             exec_name);
@@ -36,6 +48,16 @@ void synchParseArguments(SynchBenchArgs *bench_args, int argc, char *argv[]) {
              {"backoff_low", required_argument, 0, 'l'},
              {"backoff_high", required_argument, 0, 'b'},
              {"numa_nodes", required_argument, 0, 'n'},
+             {"pwb_ns", required_argument, 0, OPT_PWB_NS},
+             {"psync_ns", required_argument, 0, OPT_PSYNC_NS},
+             {"nvm_bw", required_argument, 0, OPT_NVM_BW},
+             {"crash_points", required_argument, 0, OPT_CRASH_POINTS},
+             {"repetitions", required_argument, 0, OPT_REPETITIONS},
+             {"lanes", required_argument, 0, OPT_LANES},
+             {"choices", required_argument, 0, OPT_CHOICES},
+             {"sequenced", no_argument, 0, OPT_SEQUENCED},
+             {"producers", required_argument, 0, OPT_PRODUCERS},
+             {"replica", no_argument, 0, OPT_REPLICA},
              {"help", no_argument, 0, 'h'},
              {0, 0, 0, 0}};
 
@@ -47,6 +69,16 @@ void synchParseArguments(SynchBenchArgs *bench_args, int argc, char *argv[]) {
     bench_args->backoff_high = 0;
     bench_args->backoff_low = 0;
     bench_args->numa_nodes = HSYNCH_DEFAULT_NUMA_POLICY;
+    bench_args->pwb_ns = 0;
+    bench_args->psync_ns = 0;
+    bench_args->nvm_bandwidth = 0;
+    bench_args->crash_points = 0;
+    bench_args->repetitions = 10;
+    bench_args->lanes = 4;
+    bench_args->choices = 2;
+    bench_args->sequenced = false;
+    bench_args->producers = 0;
+    bench_args->replica = false;
 
     while ((opt = getopt_long(argc, argv, "t:f:r:w:b:l:n:h", long_options, &long_index)) != -1) {
         switch (opt) {
@@ -71,6 +103,36 @@ void synchParseArguments(SynchBenchArgs *bench_args, int argc, char *argv[]) {
         case 'n':
             bench_args->numa_nodes = atoi(optarg);
             break;
+        case OPT_PWB_NS:
+            bench_args->pwb_ns = atoi(optarg);
+            break;
+        case OPT_PSYNC_NS:
+            bench_args->psync_ns = atoi(optarg);
+            break;
+        case OPT_NVM_BW:
+            bench_args->nvm_bandwidth = atoi(optarg);
+            break;
+        case OPT_CRASH_POINTS:
+            bench_args->crash_points = atoi(optarg);
+            break;
+        case OPT_REPETITIONS:
+            bench_args->repetitions = atoi(optarg);
+            break;
+        case OPT_LANES:
+            bench_args->lanes = atoi(optarg);
+            break;
+        case OPT_CHOICES:
+            bench_args->choices = atoi(optarg);
+            break;
+        case OPT_SEQUENCED:
+            bench_args->sequenced = true;
+            break;
+        case OPT_PRODUCERS:
+            bench_args->producers = atoi(optarg);
+            break;
+        case OPT_REPLICA:
+            bench_args->replica = true;
+            break;
         case 'h':
             printHelp(argv[0]);
             exit(EXIT_SUCCESS);
@@ -91,6 +153,9 @@ void synchParseArguments(SynchBenchArgs *bench_args, int argc, char *argv[]) {
     bench_args->total_runs = bench_args->runs;
     bench_args->runs /= bench_args->nthreads;
 
+    if (bench_args->pwb_ns != 0 || bench_args->psync_ns != 0 || bench_args->nvm_bandwidth != 0)
+        synchSetNVMEmulation(bench_args->pwb_ns, bench_args->psync_ns, bench_args->nvm_bandwidth);
+
 #ifdef DEBUG
     fprintf(stderr,
             "DEBUG: threads: %d -- fibers_per_thread: %d -- runs_per_thread: %ld -- max_work: %d\n",
@@ -98,5 +163,8 @@ void synchParseArguments(SynchBenchArgs *bench_args, int argc, char *argv[]) {
             bench_args->fibers_per_thread,
             bench_args->runs,
             bench_args->max_work);
+    if (synch_nvm_emulation)
+        fprintf(stderr, "DEBUG: NVM emulation -- pwb_ns: %u -- psync_ns: %u -- bandwidth (MB/s): %u -- pwb: %s\n",
+                bench_args->pwb_ns, bench_args->psync_ns, bench_args->nvm_bandwidth, synchPersistBackendName());
 #endif
 }
@@ -0,0 +1,39 @@
+#include <string.h>
+#include <lineset.h>
+
+static void allocLineSet(SynchLineSet *set, uint32_t max_lines) {
+    set->max_lines = max_lines;
+    set->capacity = 16;
+    while (set->capacity < 2 * max_lines)
+        set->capacity *= 2;
+    set->lines = synchGetAlignedMemory(CACHE_LINE_SIZE, max_lines * sizeof(uintptr_t));
+    set->counts = synchGetAlignedMemory(CACHE_LINE_SIZE, max_lines * sizeof(int64_t));
+    set->slots = synchGetAlignedMemory(CACHE_LINE_SIZE, max_lines * sizeof(uint32_t));
+    set->table = synchGetAlignedMemory(CACHE_LINE_SIZE, set->capacity * sizeof(uint32_t));
+    memset(set->table, 0, set->capacity * sizeof(uint32_t));
+    set->size = 0;
+}
+
+void synchLineSetInit(SynchLineSet *set, uint32_t max_lines) {
+    allocLineSet(set, (max_lines > 0) ? max_lines : 1);
+}
+
+void synchLineSetExpand(SynchLineSet *set) {
+    SynchLineSet old = *set;
+    uint32_t i;
+
+    allocLineSet(set, 2 * old.max_lines);
+    for (i = 0; i < old.size; i++) {
+        synchLineSetInsert(set, (void *)old.lines[i]);
+        set->counts[i] = old.counts[i];
+    }
+    synchLineSetDestroy(&old);
+}
+
+void synchLineSetDestroy(SynchLineSet *set) {
+    synchFreeMemory(set->lines, set->max_lines * sizeof(uintptr_t));
+    synchFreeMemory(set->counts, set->max_lines * sizeof(int64_t));
+    synchFreeMemory(set->slots, set->max_lines * sizeof(uint32_t));
+    synchFreeMemory(set->table, set->capacity * sizeof(uint32_t));
+    set->size = 0;
+}
@@ -0,0 +1,94 @@
+#include <primitives.h>
+#include <backoff.h>
+#include <persist.h>
+
+#ifdef SYNCH_PERSIST_LIBPMEM
+int synch_pwb_method = SYNCH_PWB_LIBPMEM;
+#else
+#    include <cpuid.h>
+
+// clflush is supported by every x86_64 processor, thus it is safe to use it until detectPWB runs.
+int synch_pwb_method = SYNCH_PWB_CLFLUSH;
+
+__attribute__((constructor)) static void detectPWB(void) {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid_max(0, NULL) < 7)
+        return;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (ebx & (1U << 24))
+        synch_pwb_method = SYNCH_PWB_CLWB;
+    else if (ebx & (1U << 23))
+        synch_pwb_method = SYNCH_PWB_CLFLUSHOPT;
+}
+#endif
+
+const char *synchPersistBackendName(void) {
+    switch (synch_pwb_method) {
+        case SYNCH_PWB_CLWB:
+            return "clwb";
+        case SYNCH_PWB_CLFLUSHOPT:
+            return "clflushopt";
+        case SYNCH_PWB_CLFLUSH:
+            return "clflush";
+        default:
+            return "libpmem";
+    }
+}
+
+bool synch_nvm_emulation = false;
+
+static uint64_t pwb_cycles = 0;
+static uint64_t psync_cycles = 0;
+static uint64_t bandwidth_mbs = 0;
+static uint64_t cycles_per_usec = 1;
+// The time-stamp counter value at which the emulated memory channel becomes idle.
+static volatile uint64_t channel_free CACHE_ALIGN = 0;
+// The number of cache lines written back by the current thread since its previous PSYNC.
+static __thread uint64_t pending_lines = 0;
+
+static inline void spinUntil(uint64_t tsc) {
+    while (synchGetTSC() < tsc)
+        ;
+}
+
+void synchSetNVMEmulation(uint32_t pwb_ns, uint32_t psync_ns, uint32_t bw_mbs) {
+    cycles_per_usec = synchBackoffCyclesPerMicrosecond();
+    pwb_cycles = (pwb_ns * cycles_per_usec) / 1000;
+    psync_cycles = (psync_ns * cycles_per_usec) / 1000;
+    bandwidth_mbs = bw_mbs;
+    channel_free = 0;
+    synch_nvm_emulation = (pwb_ns != 0 || psync_ns != 0 || bw_mbs != 0);
+    synchFullFence();
+}
+
+void synchEmulatePWB(void *ptr, size_t size) {
+    uintptr_t first = (uintptr_t)ptr / SYNCH_PWB_LINE_SIZE;
+    uintptr_t last = ((uintptr_t)ptr + (size > 0 ? size - 1 : 0)) / SYNCH_PWB_LINE_SIZE;
+    uint64_t lines = (size > 0) ? last - first + 1 : 0;
+
+    pending_lines += lines;
+    if (pwb_cycles > 0)
+        spinUntil(synchGetTSC() + lines * pwb_cycles);
+}
+
+void synchEmulatePSync(void) {
+    uint64_t now = synchGetTSC();
+    uint64_t done = now + pending_lines * psync_cycles;
+
+    // The outstanding lines are transferred through the shared channel; the transfer starts as soon
+    // as the channel becomes idle and the PSYNC completes when both the transfer and its own latency are over.
+    if (bandwidth_mbs > 0 && pending_lines > 0) {
+        uint64_t cost = (pending_lines * SYNCH_PWB_LINE_SIZE * cycles_per_usec) / bandwidth_mbs;
+        uint64_t old, start;
+
+        do {
+            old = channel_free;
+            start = (old > now) ? old : now;
+        } while (!__CAS64(&channel_free, old, start + cost));
+        if (start + cost > done)
+            done = start + cost;
+    }
+    pending_lines = 0;
+    spinUntil(done);
+}
@@ -3,33 +3,122 @@
 #include <config.h>
 #include <pool.h>
 #include <stdio.h>
+#include <string.h>
 
 #define POOL_BLOCK_METADATA_SIZE sizeof(SynchPoolBlockMetadata)
 
-static const uint32_t BLOCK_SIZE = 4096 * 8192;
+// Process-wide statistics about the blocks of all pools (see synchPoolGetStats).
+static volatile uint64_t total_blocks = 0;
+static volatile uint64_t total_bytes = 0;
+static volatile uint64_t peak_bytes = 0;
+static volatile uint64_t persistent_bytes = 0;
+
+static void accountBlock(SynchPoolStruct *pool, int64_t size) {
+    uint64_t bytes, peak;
+
+    synchFAA64(&total_blocks, (size > 0) ? 1 : -1);
+    if (pool->is_persistent)
+        synchFAA64(&persistent_bytes, size);
+    bytes = synchFAA64(&total_bytes, size) + size;
+    peak = peak_bytes;
+    while (bytes > peak && !synchCAS64(&peak_bytes, peak, bytes))
+        peak = peak_bytes;
+}
+
+// The owner pool of each object is found through a two-level map of POOL_MAP_CHUNK_SIZE chunks of memory.
+// The blocks of the pools are aligned to POOL_MAP_CHUNK_SIZE, thus each chunk belongs to at most one block.
+// The map covers 48-bit virtual addresses; the objects of blocks outside this range are always recycled locally.
+#define POOL_MAP_CHUNK_SHIFT    16
+#define POOL_MAP_CHUNK_SIZE     (1UL << POOL_MAP_CHUNK_SHIFT)
+#define POOL_MAP_LEVEL_BITS     16
+#define POOL_MAP_LEVEL_SIZE     (1UL << POOL_MAP_LEVEL_BITS)
+
+static SynchPoolStruct ** volatile pool_map[POOL_MAP_LEVEL_SIZE];
+
+static SynchPoolStruct * volatile *poolMapSlot(void *addr, bool create) {
+    uint64_t chunk = ((uint64_t)addr) >> POOL_MAP_CHUNK_SHIFT;
+    uint64_t top = chunk >> POOL_MAP_LEVEL_BITS;
+    SynchPoolStruct **level;
+
+    if (top >= POOL_MAP_LEVEL_SIZE)
+        return NULL;
+    level = pool_map[top];
+    if (level == NULL) {
+        if (!create)
+            return NULL;
+        level = synchGetAlignedMemory(CACHE_LINE_SIZE, POOL_MAP_LEVEL_SIZE * sizeof(SynchPoolStruct *));
+        memset(level, 0, POOL_MAP_LEVEL_SIZE * sizeof(SynchPoolStruct *));
+        if (!synchCASPTR(&pool_map[top], NULL, level)) {
+            synchFreeMemory(level, POOL_MAP_LEVEL_SIZE * sizeof(SynchPoolStruct *));
+            level = pool_map[top];
+        }
+    }
+
+    return &level[chunk & (POOL_MAP_LEVEL_SIZE - 1)];
+}
+
+static void mapBlock(SynchPoolBlock *block, uint64_t size, SynchPoolStruct *owner) {
+    SynchPoolStruct * volatile *slot;
+    uint64_t offset;
+
+    for (offset = 0; offset < size; offset += POOL_MAP_CHUNK_SIZE) {
+        slot = poolMapSlot((char *)block + offset, owner != NULL);
+        if (slot != NULL)
+            *slot = owner;
+    }
+}
+
+inline static SynchPoolStruct *poolOwner(void *obj) {
+    SynchPoolStruct * volatile *slot = poolMapSlot(obj, false);
+
+    return (slot != NULL) ? *slot : NULL;
+}
 
 static void *get_new_block(SynchPoolStruct *pool) {
-    uint32_t obj_size;
+    uint64_t size = pool->next_block_size;
     SynchPoolBlock *block;
 
-    obj_size = pool->obj_size;
-    if (pool->is_persistent) block = synchGetPersistentMemory(CACHE_LINE_SIZE, BLOCK_SIZE);
-    else block = synchGetAlignedMemory(CACHE_LINE_SIZE, BLOCK_SIZE);
-    block->metadata.entries = (BLOCK_SIZE - POOL_BLOCK_METADATA_SIZE) / obj_size;
-    block->metadata.free_entries = (BLOCK_SIZE - POOL_BLOCK_METADATA_SIZE) / obj_size;
+    while (size - POOL_BLOCK_METADATA_SIZE < pool->obj_size)
+        size *= 2;
+    if (pool->is_persistent) block = synchGetPersistentMemory(POOL_MAP_CHUNK_SIZE, size);
+    else block = synchGetAlignedMemory(POOL_MAP_CHUNK_SIZE, size);
+    mapBlock(block, size, pool);
+    block->metadata.entries = (size - POOL_BLOCK_METADATA_SIZE) / pool->obj_size;
+    block->metadata.free_entries = block->metadata.entries;
     block->metadata.cur_entry = 0;
-    block->metadata.object_size = obj_size;
+    block->metadata.object_size = pool->obj_size;
+    block->metadata.size = size;
     block->metadata.next = NULL;
     block->metadata.back = NULL;
+    // each block is twice as large as the previous one, up to `max_block_size`
+    if (2 * size <= pool->max_block_size)
+        pool->next_block_size = 2 * size;
+    else if (size < pool->max_block_size)
+        pool->next_block_size = pool->max_block_size;
+    accountBlock(pool, (int64_t)size);
 
     return block;
 }
 
-int synchInitPool(SynchPoolStruct *pool, uint32_t obj_size) {
-    SynchPoolBlock *block;
+static void free_block(SynchPoolStruct *pool, SynchPoolBlock *block) {
+    uint64_t size = block->metadata.size;
 
-    pool->is_persistent = false;
-    if (obj_size > BLOCK_SIZE - POOL_BLOCK_METADATA_SIZE) {
+    mapBlock(block, size, NULL);
+    accountBlock(pool, -(int64_t)size);
+    if (pool->is_persistent) synchFreePersistentMemory(block, size);
+    else synchFreeMemory(block, size);
+}
+
+// Rounds up a block size to a multiple of POOL_MAP_CHUNK_SIZE.
+inline static uint64_t blockSize(uint64_t size) {
+    if (size < POOL_MAP_CHUNK_SIZE)
+        return POOL_MAP_CHUNK_SIZE;
+    return (size + POOL_MAP_CHUNK_SIZE - 1) & ~(POOL_MAP_CHUNK_SIZE - 1);
+}
+
+static int initPool(SynchPoolStruct *pool, uint32_t obj_size, bool is_persistent) {
+    pool->is_persistent = is_persistent;
+    if (obj_size > SYNCH_POOL_MAX_BLOCK_SIZE - POOL_BLOCK_METADATA_SIZE) {
         fprintf(stderr, "ERROR: synchInitPool: object size unsupported\n");
 
         return SYNCH_POOL_INIT_ERROR;
@@ -38,45 +127,159 @@ int synchInitPool(SynchPoolStruct *pool, uint32_t obj_size) {
     }
 
     pool->obj_size = obj_size;
-    // Get the first block of the pool
-    block = get_new_block(pool);
-
-    pool->entries_per_block = (BLOCK_SIZE - POOL_BLOCK_METADATA_SIZE) / obj_size;
+    pool->next_block_size = blockSize(SYNCH_POOL_FIRST_BLOCK_SIZE);
+    pool->max_block_size = blockSize(SYNCH_POOL_MAX_BLOCK_SIZE);
+    // the first block is allocated by the first call of synchAllocObj
     pool->recycle_list = NULL;
-    pool->head_block = block;
-    pool->cur_block = block;
+    pool->head_block = NULL;
+    pool->cur_block = NULL;
+    pool->remote_batch_size = 0;
+    pool->remote_batch = NULL;
+    pool->remote_batch_tail = NULL;
+    pool->remote_batch_owner = NULL;
+    pool->remote_list = NULL;
+    pool->line_slots = NULL;
+    pool->line_slots_used = 0;
+    pool->line_slots_victim = 0;
+    pool->objs_per_line = 0;
 
     return SYNCH_POOL_INIT_SUCC;
 }
 
+int synchInitPool(SynchPoolStruct *pool, uint32_t obj_size) {
+    return initPool(pool, obj_size, false);
+}
+
 int synchInitPoolPersistent(SynchPoolStruct *pool, uint32_t obj_size) {
-    SynchPoolBlock *block;
+    return initPool(pool, obj_size, true);
+}
 
-    pool->is_persistent = true;
-    if (obj_size > BLOCK_SIZE - POOL_BLOCK_METADATA_SIZE) {
-        fprintf(stderr, "ERROR: synchInitPool: object size unsupported\n");
+void synchPoolSetBlockSizes(SynchPoolStruct *pool, uint64_t first_block_size, uint64_t max_block_size) {
+    pool->max_block_size = blockSize(max_block_size);
+    if (pool->head_block == NULL)
+        pool->next_block_size = blockSize(first_block_size);
+    if (pool->next_block_size > pool->max_block_size)
+        pool->next_block_size = pool->max_block_size;
+}
 
-        return SYNCH_POOL_INIT_ERROR;
-    } else if (obj_size < sizeof(void *)) {
-        obj_size = sizeof(void *);
+// Moves the objects gathered in a slot of `line_slots` to the front of the list of recycled objects,
+// so that they are handed out consecutively.
+static void releaseLineSlot(SynchPoolStruct *pool, uint32_t index) {
+    SynchPoolLineSlot *slot = &pool->line_slots[index];
+
+    slot->tail->next = pool->recycle_list;
+    pool->recycle_list = slot->head;
+    slot->head = NULL;
+    slot->tail = NULL;
+    slot->count = 0;
+    pool->line_slots_used &= ~(1ULL << index);
+}
+
+static void packObject(SynchPoolStruct *pool, SynchBlockObject *object) {
+    uintptr_t line = (uintptr_t)object & ~((uintptr_t)SYNCH_POOL_LINE_SIZE - 1);
+    uint64_t used = pool->line_slots_used;
+    SynchPoolLineSlot *slot;
+    uint32_t index;
+
+    // the slots are searched associatively, since the objects of a few lines are usually recycled in an interleaved order
+    while (used != 0) {
+        index = __builtin_ctzll(used);
+        if (pool->line_slots[index].line == line)
+            goto found;
+        used &= used - 1;
     }
+    if (~pool->line_slots_used & SYNCH_POOL_LINE_SLOTS_MASK) {
+        index = __builtin_ctzll(~pool->line_slots_used & SYNCH_POOL_LINE_SLOTS_MASK);
+    } else {
+        // all slots are in use, thus a partially gathered line is released in a round-robin fashion
+        index = pool->line_slots_victim;
+        pool->line_slots_victim = (index + 1) & (SYNCH_POOL_LINE_SLOTS - 1);
+        releaseLineSlot(pool, index);
+    }
+    pool->line_slots[index].line = line;
+    pool->line_slots[index].tail = object;
+    pool->line_slots_used |= 1ULL << index;
+found:
+    slot = &pool->line_slots[index];
+    object->next = slot->head;
+    slot->head = object;
+    slot->count++;
+    if (slot->count == pool->objs_per_line)
+        releaseLineSlot(pool, index);
+}
 
-    pool->obj_size = obj_size;
-    // Get the first block of the pool
-    block = get_new_block(pool);
+void synchPoolSetLinePacking(SynchPoolStruct *pool, bool enable) {
+    if (enable && pool->line_slots == NULL && pool->obj_size < SYNCH_POOL_LINE_SIZE && SYNCH_POOL_LINE_SIZE % pool->obj_size == 0) {
+        pool->line_slots = synchGetAlignedMemory(CACHE_LINE_SIZE, SYNCH_POOL_LINE_SLOTS * sizeof(SynchPoolLineSlot));
+        memset(pool->line_slots, 0, SYNCH_POOL_LINE_SLOTS * sizeof(SynchPoolLineSlot));
+        pool->line_slots_used = 0;
+        pool->line_slots_victim = 0;
+        pool->objs_per_line = SYNCH_POOL_LINE_SIZE / pool->obj_size;
+    } else if (!enable && pool->line_slots != NULL) {
+        while (pool->line_slots_used != 0)
+            releaseLineSlot(pool, __builtin_ctzll(pool->line_slots_used));
+        synchFreeMemory(pool->line_slots, SYNCH_POOL_LINE_SLOTS * sizeof(SynchPoolLineSlot));
+        pool->line_slots = NULL;
+        pool->objs_per_line = 0;
+    }
+}
 
-    pool->entries_per_block = (BLOCK_SIZE - POOL_BLOCK_METADATA_SIZE) / obj_size;
-    pool->recycle_list = NULL;
-    pool->head_block = block;
-    pool->cur_block = block;
+void synchPoolPrefault(SynchPoolStruct *pool, uint64_t nobjs) {
+    SynchPoolBlock *block;
+    uint64_t size, n;
 
-    return SYNCH_POOL_INIT_SUCC;
+    if (nobjs == 0)
+        return;
+    if (pool->head_block == NULL) {
+        size = blockSize(POOL_BLOCK_METADATA_SIZE + nobjs * pool->obj_size);
+        if (size > pool->max_block_size)
+            size = pool->max_block_size;
+        if (size > pool->next_block_size)
+            pool->next_block_size = size;
+        pool->head_block = get_new_block(pool);
+        pool->cur_block = pool->head_block;
+    }
+
+    block = pool->cur_block;
+    while (true) {
+        n = (nobjs < block->metadata.free_entries) ? nobjs : block->metadata.free_entries;
+        synchPrefaultMemory(&block->heap[block->metadata.cur_entry * pool->obj_size], n * pool->obj_size);
+        nobjs -= n;
+        if (nobjs == 0)
+            break;
+        if (block->metadata.next == NULL) {
+            SynchPoolBlock *new_block = get_new_block(pool);
+            new_block->metadata.back = block;
+            block->metadata.next = new_block;
+        }
+        block = block->metadata.next;
+    }
 }
 
 void *synchAllocObj(SynchPoolStruct *pool) {
     SynchBlockObject *ret = NULL;
 
+    if (pool->recycle_list == NULL && pool->remote_list != NULL) {
+        if (pool->line_slots == NULL) {
+            pool->recycle_list = synchSWAP(&pool->remote_list, NULL);
+        } else {
+            SynchBlockObject *list = synchSWAP(&pool->remote_list, NULL), *next;
+
+            while (list != NULL) {
+                next = list->next;
+                packObject(pool, list);
+                list = next;
+            }
+        }
+    }
+    // a single partially gathered line is released at a time, so that the rest of the lines could be completed
+    if (pool->recycle_list == NULL && pool->line_slots_used != 0)
+        releaseLineSlot(pool, __builtin_ctzll(pool->line_slots_used));
     if (pool->recycle_list == NULL) {
+        if (pool->cur_block == NULL) {
+            pool->head_block = get_new_block(pool);
+            pool->cur_block = pool->head_block;
+        }
         if (pool->cur_block->metadata.free_entries > 0) {
             ret = (void *)&pool->cur_block->heap[(pool->cur_block->metadata.cur_entry) * (pool->obj_size)];
             pool->cur_block->metadata.free_entries -= 1;
@@ -87,6 +290,7 @@ void *synchAllocObj(SynchPoolStruct *pool) {
             } else {
                 SynchPoolBlock *new_block = get_new_block(pool);
                 new_block->metadata.back = pool->cur_block;
+                pool->cur_block->metadata.next = new_block;
                 pool->cur_block = new_block;
             }
             ret = synchAllocObj(pool);
@@ -106,13 +310,47 @@ void *synchAllocObj(SynchPoolStruct *pool) {
 void synchRecycleObj(SynchPoolStruct *pool, void *obj) {
 #ifndef SYNCH_POOL_NODE_RECYCLING_DISABLE
     SynchBlockObject *object = obj;
-    object->next = pool->recycle_list;
-    pool->recycle_list = object;
+    SynchPoolStruct *owner = poolOwner(obj);
+
+    if ((owner == NULL || owner == pool) && pool->line_slots != NULL) {
+        packObject(pool, object);
+    } else if (owner == NULL || owner == pool) {
+        object->next = pool->recycle_list;
+        pool->recycle_list = object;
+    } else {
+        if (owner != pool->remote_batch_owner)
+            synchPoolFlushRemote(pool);
+        object->next = pool->remote_batch;
+        if (pool->remote_batch == NULL)
+            pool->remote_batch_tail = object;
+        pool->remote_batch = object;
+        pool->remote_batch_owner = owner;
+        pool->remote_batch_size++;
+        if (pool->remote_batch_size == SYNCH_POOL_REMOTE_BATCH)
+            synchPoolFlushRemote(pool);
+    }
 #endif
 }
 
+void synchPoolFlushRemote(SynchPoolStruct *pool) {
+    SynchPoolStruct *owner = pool->remote_batch_owner;
+    SynchBlockObject *head;
+
+    if (pool->remote_batch == NULL)
+        return;
+    // the whole batch is pushed with a single CAS, while the owner removes the whole list with a single swap
+    do {
+        head = owner->remote_list;
+        pool->remote_batch_tail->next = head;
+    } while (!synchCASPTR(&owner->remote_list, head, pool->remote_batch));
+    pool->remote_batch = NULL;
+    pool->remote_batch_tail = NULL;
+    pool->remote_batch_owner = NULL;
+    pool->remote_batch_size = 0;
+}
+
 void synchRollback(SynchPoolStruct *pool, uint32_t num_objs) {
-    while (num_objs > 0) {
+    while (num_objs > 0 && pool->cur_block != NULL) {
         if (num_objs > pool->cur_block->metadata.cur_entry) {
             num_objs -= pool->cur_block->metadata.cur_entry;
             pool->cur_block->metadata.cur_entry = 0;
@@ -129,11 +367,60 @@ void synchRollback(SynchPoolStruct *pool, uint32_t num_objs) {
     }
 }
 
+uint64_t synchPoolFootprint(SynchPoolStruct *pool) {
+    SynchPoolBlock *block = pool->head_block;
+    uint64_t objects = 0;
+
+    while (block != NULL) {
+        objects += block->metadata.cur_entry;
+        if (block == pool->cur_block)
+            break;
+        block = block->metadata.next;
+    }
+
+    return objects * pool->obj_size;
+}
+
+void synchPoolTrim(SynchPoolStruct *pool) {
+    SynchPoolBlock *block, *next;
+
+    if (pool->cur_block == NULL)
+        return;
+    // the blocks are used in order, thus the blocks after the current one have never handed out an object
+    block = pool->cur_block->metadata.next;
+    pool->cur_block->metadata.next = NULL;
+    while (block != NULL) {
+        next = block->metadata.next;
+        free_block(pool, block);
+        block = next;
+    }
+    while (pool->cur_block != NULL && pool->cur_block->metadata.cur_entry == 0) {
+        block = pool->cur_block;
+        pool->cur_block = block->metadata.back;
+        if (pool->cur_block != NULL)
+            pool->cur_block->metadata.next = NULL;
+        else
+            pool->head_block = NULL;
+        // the pool grows again starting from the size of the released block
+        pool->next_block_size = block->metadata.size;
+        free_block(pool, block);
+    }
+}
+
+void synchPoolGetStats(SynchPoolStats *stats) {
+    stats->blocks = total_blocks;
+    stats->bytes = total_bytes;
+    stats->peak_bytes = peak_bytes;
+    stats->persistent_bytes = persistent_bytes;
+}
+
 void synchDestroyPool(SynchPoolStruct *pool) {
+    synchPoolFlushRemote(pool);
+    synchPoolSetLinePacking(pool, false);
     while (pool->head_block != NULL) {
         SynchPoolBlock *block = pool->head_block;
         pool->head_block = pool->head_block->metadata.next;
-        synchFreeMemory(block, BLOCK_SIZE);
+        free_block(pool, block);
     }
     pool->head_block = NULL;
     pool->cur_block = NULL;
@@ -10,10 +10,16 @@
 #endif
 
 #ifdef SYNCH_ENABLE_PERSISTENT_MEM
-#   include <libpmem.h>
 #   include <libvmem.h>
 #endif
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef SYNCH_HUGE_PAGES
+#    include <fcntl.h>
+#endif
+
 #define MAX_VENDOR_STR_SIZE 64
 
 #ifdef DEBUG
@@ -23,10 +29,6 @@ extern __thread int64_t __executed_swap;
 extern __thread int64_t __executed_faa;
 #endif
 
-#ifdef SYNCH_COUNT_PWBS
-extern __thread int64_t __executed_pwb;
-#endif
-
 #ifdef __OLD_GCC_X86__
 inline bool __CASPTR(void *A, void *B, void *C) {
     uint64_t prev;
@@ -162,9 +164,71 @@ inline void *synchGetMemory(size_t size) {
         return p;
 }
 
+#ifdef SYNCH_HUGE_PAGES
+inline static size_t hugeSize(size_t size) {
+    return (size + SYNCH_HUGE_PAGE_SIZE - 1) & ~((size_t)SYNCH_HUGE_PAGE_SIZE - 1);
+}
+
+// Maps a memory area of `size` bytes (rounded up to a multiple of SYNCH_HUGE_PAGE_SIZE), which is aligned to
+// SYNCH_HUGE_PAGE_SIZE and is backed by huge pages. In case that `fd` is -1, the area is anonymous; otherwise,
+// the file `fd` is mapped. It returns NULL in case of error.
+static void *mapHugeMemory(size_t size, int fd) {
+    size_t len = hugeSize(size);
+    char *area, *p;
+    void *ret;
+
+    if (fd == -1) {
+        // explicit huge pages are available only in case that they have been reserved by the administrator
+        ret = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ret != MAP_FAILED)
+            return ret;
+    }
+    // an area larger by a huge page is reserved, so that an aligned part of it could be mapped
+    area = mmap(NULL, len + SYNCH_HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (area == MAP_FAILED)
+        return NULL;
+    p = (char *)(((uintptr_t)area + SYNCH_HUGE_PAGE_SIZE - 1) & ~((uintptr_t)SYNCH_HUGE_PAGE_SIZE - 1));
+    if (p > area)
+        munmap(area, p - area);
+    munmap(p + len, area + SYNCH_HUGE_PAGE_SIZE - p);
+    if (fd == -1)
+        ret = mmap(p, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    else
+        ret = mmap(p, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    if (ret == MAP_FAILED) {
+        munmap(p, len);
+        return NULL;
+    }
+    madvise(ret, len, MADV_HUGEPAGE);
+
+    return ret;
+}
+
+static void *getHugeMemory(size_t size, int node) {
+    void *p = mapHugeMemory(size, -1);
+
+    if (p == NULL) {
+        perror("memory allocation fail");
+        exit(EXIT_FAILURE);
+    }
+#    ifdef SYNCH_NUMA_SUPPORT
+    if (node < 0)
+        numa_setlocal_memory(p, hugeSize(size));
+    else
+        numa_tonode_memory(p, hugeSize(size), node);
+#    endif
+
+    return p;
+}
+#endif
+
 inline void *synchGetAlignedMemory(size_t align, size_t size) {
     void *p;
 
+#ifdef SYNCH_HUGE_PAGES
+    if (size >= SYNCH_HUGE_PAGE_SIZE && align <= SYNCH_HUGE_PAGE_SIZE)
+        return getHugeMemory(size, -1);
+#endif
 #ifdef SYNCH_NUMA_SUPPORT
     p = numa_alloc_local(size + align);
     long plong = (long)p;
@@ -182,7 +246,38 @@ inline void *synchGetAlignedMemory(size_t align, size_t size) {
         return p;
 }
 
+inline void *synchGetAlignedMemoryOnNode(size_t align, size_t size, uint32_t node) {
+    void *p;
+
+#ifdef SYNCH_HUGE_PAGES
+    if (size >= SYNCH_HUGE_PAGE_SIZE && align <= SYNCH_HUGE_PAGE_SIZE)
+        return getHugeMemory(size, (int)node);
+#endif
+#ifdef SYNCH_NUMA_SUPPORT
+    p = numa_alloc_onnode(size + align, node);
+    long plong = (long)p;
+    plong += align;
+    plong &= ~(align - 1);
+    p = (void *)plong;
+#else
+    p = (void *)memalign(align, size);
+#endif
+
+    if (p == NULL) {
+        perror("memory allocation fail");
+        exit(EXIT_FAILURE);
+    } else
+        return p;
+}
+
 inline void synchFreeMemory(void *ptr, size_t size) {
+#ifdef SYNCH_HUGE_PAGES
+    // the same condition as in synchGetAlignedMemory, since the alignment of a huge mapping is at least SYNCH_HUGE_PAGE_SIZE
+    if (size >= SYNCH_HUGE_PAGE_SIZE && ((uintptr_t)ptr & (SYNCH_HUGE_PAGE_SIZE - 1)) == 0) {
+        munmap(ptr, hugeSize(size));
+        return;
+    }
+#endif
 #ifdef SYNCH_NUMA_SUPPORT
     numa_free(ptr, size);
 #else
@@ -193,6 +288,31 @@ inline void synchFreeMemory(void *ptr, size_t size) {
 #ifdef SYNCH_ENABLE_PERSISTENT_MEM
 static __thread bool persist_mem_init = false;
 static __thread VMEM *vmp = NULL;
+
+#   ifdef SYNCH_HUGE_PAGES
+// Creates the pool of persistent memory of the thread in a file of `dir`, which is mapped at an address aligned to
+// SYNCH_HUGE_PAGE_SIZE, so that a DAX file system is able to map it using PMD (i.e. 2MB) entries.
+static VMEM *createHugePersistentPool(const char *dir, size_t size) {
+    char path[4096];
+    void *p;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/synch_vmem_XXXXXX", dir);
+    if ((fd = mkstemp(path)) == -1)
+        return NULL;
+    unlink(path);
+    if (ftruncate(fd, hugeSize(size)) != 0) {
+        close(fd);
+        return NULL;
+    }
+    p = mapHugeMemory(size, fd);
+    close(fd);
+    if (p == NULL)
+        return NULL;
+
+    return vmem_create_in_region(p, hugeSize(size));
+}
+#   endif
 #endif
 
 
@@ -201,7 +321,13 @@ inline void *synchGetPersistentMemory(size_t align, size_t size) {
     void *p;
 
     if (persist_mem_init == false) {
-        vmp = vmem_create(SYNCH_PERSISTENT_DEV_PATH, SYNCH_PERSISTENT_MEM_SIZE_INIT);
+#   ifdef SYNCH_HUGE_PAGES
+        vmp = createHugePersistentPool(SYNCH_PERSISTENT_DEV_PATH, SYNCH_PERSISTENT_MEM_SIZE_INIT);
+        if (vmp == NULL)
+            vmp = createHugePersistentPool(SYNCH_PERSISTENT_DEV_PATH_FALLBACK, SYNCH_PERSISTENT_MEM_SIZE_INIT);
+#   endif
+        if (vmp == NULL)
+            vmp = vmem_create(SYNCH_PERSISTENT_DEV_PATH, SYNCH_PERSISTENT_MEM_SIZE_INIT);
         if (vmp == NULL) {
             perror("vmem_create");
             vmp = vmem_create(SYNCH_PERSISTENT_DEV_PATH_FALLBACK, SYNCH_PERSISTENT_MEM_SIZE_INIT);
@@ -234,20 +360,21 @@ inline void synchFreePersistentMemory(void *ptr, size_t size) {
 #endif
 }
 
-inline void synchFlushPersistentMemory(void *ptr, size_t size) {
-#ifdef SYNCH_COUNT_PWBS
-    __executed_pwb += (!size%64)?size/64:size/64+1;
-#endif
-
-#ifndef SYNCH_DISABLE_PWBS              
-    pmem_flush(ptr, size);
-#endif
-}
-
-inline void synchDrainPersistentMemory(void) {
-#ifndef SYNCH_DISABLE_PSYNCS
-    pmem_drain();
+void synchPrefaultMemory(void *ptr, size_t size) {
+    uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)ptr & ~(page_size - 1);
+    uintptr_t addr;
+
+    if (size == 0)
+        return;
+#ifdef MADV_POPULATE_WRITE
+    // all the pages are faulted in with a single system call (Linux 5.14 or later)
+    if (madvise((void *)start, (uintptr_t)ptr + size - start, MADV_POPULATE_WRITE) == 0)
+        return;
 #endif
+    *(volatile char *)ptr = *(volatile char *)ptr;
+    for (addr = start + page_size; addr < (uintptr_t)ptr + size; addr += page_size)
+        *(volatile char *)addr = *(volatile char *)addr;
 }
 
 inline int64_t synchGetTimeMillis(void) {
@@ -259,6 +386,20 @@ inline int64_t synchGetTimeMillis(void) {
     } else return tm.tv_sec*1000LL + tm.tv_nsec/1000000LL;
 }
 
+inline uint64_t synchGetTSC(void) {
+#if defined(__amd64__) || defined(__x86_64__)
+    uint32_t low, high;
+
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_MONOTONIC, &tm);
+    return tm.tv_sec * 1000000000ULL + tm.tv_nsec;
+#endif
+}
+
 inline uint64_t synchGetMachineModel(void) {
 #if defined(__amd64__) || defined(__x86_64__)
     char cpu_model[MAX_VENDOR_STR_SIZE] = {'\0'};
@@ -0,0 +1,284 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <config.h>
+#include <primitives.h>
+#include <replica.h>
+
+#define SYNCH_REPLICA_APPEND_ATTEMPTS 4
+
+static inline SynchReplicaEntry *getEntry(SynchReplicaStruct *r, uint64_t pos) {
+    return (SynchReplicaEntry *)(r->ring + (pos & (r->ring_size - 1)) * r->entry_size);
+}
+
+static int openMirrorFile(const char *path) {
+    const char *dirs[] = {SYNCH_PERSISTENT_DEV_PATH, SYNCH_PERSISTENT_DEV_PATH_FALLBACK};
+    char template[256];
+    int i, fd = -1;
+
+    if (path != NULL) {
+        fd = open(path, O_RDWR | O_CREAT, 0666);
+        if (fd == -1)
+            perror("synchReplicaInit: open");
+        return fd;
+    }
+
+    for (i = 0; i < sizeof(dirs) / sizeof(dirs[0]) && fd == -1; i++) {
+        snprintf(template, sizeof(template), "%ssynch_replica_XXXXXX", dirs[i]);
+        fd = mkstemp(template);
+    }
+    // nobody else knows the name of the file, thus it is removed as soon as it is unmapped
+    if (fd == -1)
+        perror("synchReplicaInit: mkstemp");
+    else
+        unlink(template);
+
+    return fd;
+}
+
+int synchReplicaInit(SynchReplicaStruct *r, const char *path, uint32_t state_size, uint32_t ring_size) {
+    uint64_t i, slot_size;
+    int fd;
+
+    if (ring_size == 0)
+        ring_size = SYNCH_REPLICA_RING_SIZE;
+    r->ring_size = 1;
+    while (r->ring_size < ring_size)
+        r->ring_size <<= 1;
+
+    r->state_size = state_size;
+    r->entry_size = sizeof(SynchReplicaEntry) + state_size;
+    r->entry_size = (r->entry_size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+    r->ring = synchGetAlignedMemory(CACHE_LINE_SIZE, (size_t)r->ring_size * r->entry_size);
+    for (i = 0; i < r->ring_size; i++)
+        getEntry(r, i)->seq = i;
+    r->overflow = synchGetAlignedMemory(CACHE_LINE_SIZE, r->entry_size);
+    r->overflow->seq = 0;
+    r->overflow->round = 0;
+    r->overflow_seen = 0;
+    r->staging = synchGetAlignedMemory(CACHE_LINE_SIZE, state_size);
+
+    fd = openMirrorFile(path);
+    if (fd == -1)
+        return -1;
+    slot_size = ((uint64_t)state_size + CACHE_LINE_SIZE - 1) & ~((uint64_t)CACHE_LINE_SIZE - 1);
+    r->mirror_size = sizeof(SynchReplicaMirror) + 2 * slot_size;
+    if (ftruncate(fd, r->mirror_size) == -1) {
+        perror("synchReplicaInit: ftruncate");
+        close(fd);
+        return -1;
+    }
+    r->mirror = mmap(NULL, r->mirror_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (r->mirror == MAP_FAILED) {
+        perror("synchReplicaInit: mmap");
+        r->mirror = NULL;
+        return -1;
+    }
+    r->mirror->magic = SYNCH_REPLICA_MAGIC;
+    r->mirror->state_size = state_size;
+    r->mirror->slot_size = slot_size;
+    r->mirror->commit = 0;
+    synchPersistRange(r->mirror, sizeof(SynchReplicaMirror));
+
+    r->running = false;
+    r->head = 0;
+    r->tail = 0;
+    r->published_round = 0;
+    r->applied_round = 0;
+    r->overflows = 0;
+    r->dropped = 0;
+    r->shipped = 0;
+    r->mirror_writes = 0;
+    r->max_lag = 0;
+    synchFullFence();
+
+    return 0;
+}
+
+// The overflow entry is protected by a sequence lock: its `seq` field is odd while a combiner writes it.
+static bool appendOverflow(SynchReplicaStruct *r, uint64_t round, void *state) {
+    uint64_t seq = r->overflow->seq;
+
+    if ((seq & 1) != 0 || !synchCAS64(&r->overflow->seq, seq, seq + 1)) {
+        synchFAA64(&r->dropped, 1);
+        return false;
+    }
+    if (round > r->overflow->round) {
+        r->overflow->round = round;
+        memcpy(r->overflow->data, state, r->state_size);
+    }
+    synchNonTSOFence();
+    r->overflow->seq = seq + 2;
+    synchFAA64(&r->overflows, 1);
+
+    return true;
+}
+
+bool synchReplicaAppend(SynchReplicaStruct *r, uint64_t round, void *state) {
+    SynchReplicaEntry *entry;
+    uint64_t pos = r->head, published;
+    bool claimed = false;
+    int i;
+
+    // Claim an entry of the ring; give up after a few attempts or if the ring is full
+    for (i = 0; i < SYNCH_REPLICA_APPEND_ATTEMPTS && !claimed; i++) {
+        int64_t diff;
+
+        entry = getEntry(r, pos);
+        diff = (int64_t)(entry->seq - pos);
+        if (diff == 0)
+            claimed = synchCAS64(&r->head, pos, pos + 1);
+        else if (diff < 0)
+            break;
+        if (!claimed)
+            pos = r->head;
+    }
+
+    // rounds may be appended out of order by concurrent combiners, so the maximum is updated with a CAS loop
+    published = r->published_round;
+    while (round > published && !synchCAS64(&r->published_round, published, round))
+        published = r->published_round;
+
+    if (!claimed)
+        return appendOverflow(r, round, state);
+
+    entry->round = round;
+    memcpy(entry->data, state, r->state_size);
+    synchNonTSOFence();
+    entry->seq = pos + 1;
+
+    return true;
+}
+
+// Consumes all the published entries of the ring and persists the most recent state to the mirror.
+// It returns the number of consumed entries.
+static uint64_t shipPendingStates(SynchReplicaStruct *r) {
+    uint64_t pos = r->tail, consumed = 0, best_round = r->applied_round;
+    uint64_t seq;
+
+    // A state stored to the overflow entry is consumed only if it was not modified while it was copied.
+    // The overflow entry is checked first, so a torn copy in staging is always overwritten or ignored.
+    seq = r->overflow->seq;
+    if (seq != r->overflow_seen && (seq & 1) == 0) {
+        uint64_t round;
+
+        synchNonTSOFence();
+        round = r->overflow->round;
+        if (round > best_round) {
+            memcpy(r->staging, r->overflow->data, r->state_size);
+            synchFullFence();
+            if (r->overflow->seq == seq)
+                best_round = round;
+        }
+        synchFullFence();
+        if (r->overflow->seq == seq) {
+            r->overflow_seen = seq;
+            consumed++;
+        }
+    }
+
+    while (true) {
+        SynchReplicaEntry *entry = getEntry(r, pos);
+
+        if (entry->seq != pos + 1)
+            break;
+        synchNonTSOFence();
+        if (entry->round > best_round) {
+            best_round = entry->round;
+            memcpy(r->staging, entry->data, r->state_size);
+        }
+        synchNonTSOFence();
+        entry->seq = pos + r->ring_size;
+        pos++;
+        consumed++;
+    }
+
+    if (consumed > 0) {
+        r->tail = pos;
+        r->shipped += consumed;
+    }
+
+    if (best_round > r->applied_round) {
+        uint64_t lag = r->published_round - r->applied_round;
+        uint64_t slot = 1 - SYNCH_REPLICA_COMMIT_SLOT(r->mirror->commit);
+        char *data = (char *)r->mirror->data + slot * r->mirror->slot_size;
+
+        if (lag > r->max_lag)
+            r->max_lag = lag;
+        // the inactive slot is persisted before it is published, so the active slot is never torn
+        memcpy(data, r->staging, r->state_size);
+        synchPersistRange(data, r->state_size);
+        r->mirror->commit = (best_round << 1) | slot;
+        synchPersistRange((void *)&r->mirror->commit, sizeof(uint64_t));
+        r->applied_round = best_round;
+        r->mirror_writes++;
+    }
+
+    return consumed;
+}
+
+static void *shipperThread(void *arg) {
+    SynchReplicaStruct *r = (SynchReplicaStruct *)arg;
+
+    while (true) {
+        bool running = r->running;
+
+        synchFullFence();
+        if (shipPendingStates(r) == 0) {
+            if (!running)
+                break;
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+int synchReplicaStart(SynchReplicaStruct *r) {
+    r->running = true;
+    synchFullFence();
+    if (pthread_create(&r->shipper, NULL, shipperThread, (void *)r) != 0) {
+        perror("synchReplicaStart: pthread_create");
+        r->running = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+void synchReplicaStop(SynchReplicaStruct *r) {
+    if (r->running) {
+        r->running = false;
+        synchFullFence();
+        pthread_join(r->shipper, NULL);
+    }
+}
+
+uint64_t synchReplicaLag(SynchReplicaStruct *r) {
+    uint64_t published = r->published_round;
+    uint64_t applied = r->applied_round;
+
+    return (published > applied) ? published - applied : 0;
+}
+
+void *synchReplicaMirrorState(SynchReplicaStruct *r) {
+    return synchReplicaMirrorData(r->mirror, NULL);
+}
+
+void synchReplicaDestroy(SynchReplicaStruct *r) {
+    if (r->mirror != NULL)
+        munmap(r->mirror, r->mirror_size);
+    synchFreeMemory((void *)r->ring, (size_t)r->ring_size * r->entry_size);
+    synchFreeMemory(r->staging, r->state_size);
+    synchFreeMemory(r->overflow, r->entry_size);
+    r->mirror = NULL;
+    r->overflow = NULL;
+    r->ring = NULL;
+    r->staging = NULL;
+}
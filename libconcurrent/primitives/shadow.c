@@ -0,0 +1,210 @@
+#include <signal.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <primitives.h>
+#include <shadow.h>
+
+bool synch_persist_shadow = false;
+
+static SynchShadowLog *shadow_log = NULL;
+static size_t shadow_log_size = 0;
+
+// The cache lines written back by the current thread since its previous PSYNC.
+static __thread SynchShadowLine pending[SYNCH_SHADOW_PENDING_LINES];
+static __thread uint32_t pending_size = 0;
+
+int synchShadowInit(uint64_t capacity) {
+    shadow_log_size = sizeof(SynchShadowLog) + capacity * sizeof(SynchShadowLine);
+    shadow_log = mmap(NULL, shadow_log_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shadow_log == MAP_FAILED) {
+        perror("synchShadowInit: mmap");
+        shadow_log = NULL;
+        return -1;
+    }
+    shadow_log->capacity = capacity;
+    synchShadowReset(0);
+    synch_persist_shadow = true;
+    synchFullFence();
+
+    return 0;
+}
+
+void synchShadowDestroy(void) {
+    synch_persist_shadow = false;
+    synchFullFence();
+    if (shadow_log != NULL)
+        munmap(shadow_log, shadow_log_size);
+    shadow_log = NULL;
+}
+
+void synchShadowReset(uint64_t crash_at) {
+    uint64_t used = shadow_log->size;
+    int i;
+
+    if (used > shadow_log->capacity)
+        used = shadow_log->capacity;
+    memset(shadow_log->lines, 0, used * sizeof(SynchShadowLine));
+    for (i = 0; i < SYNCH_SHADOW_ROOTS; i++)
+        shadow_log->roots[i] = 0;
+    shadow_log->size = 0;
+    shadow_log->stamps = 0;
+    shadow_log->overflow = false;
+    shadow_log->events = 0;
+    shadow_log->crash_at = crash_at;
+    pending_size = 0;
+    synchFullFence();
+}
+
+uint64_t synchShadowEvents(void) {
+    return shadow_log->events;
+}
+
+void synchShadowSetRoot(int i, void *ptr) {
+    shadow_log->roots[i] = (uint64_t)ptr;
+    synchFullFence();
+}
+
+void *synchShadowGetRoot(int i) {
+    return (void *)shadow_log->roots[i];
+}
+
+bool synchShadowOverflow(void) {
+    return shadow_log->overflow;
+}
+
+static inline void countEvent(void) {
+    uint64_t event = __FAA64(&shadow_log->events, 1) + 1;
+
+    if (event == shadow_log->crash_at)
+        kill(getpid(), SIGKILL);
+}
+
+static void commitPending(void) {
+    uint64_t pos = __FAA64(&shadow_log->size, pending_size);
+    uint32_t i;
+
+    for (i = 0; i < pending_size; i++, pos++) {
+        if (pos >= shadow_log->capacity) {
+            shadow_log->overflow = true;
+            break;
+        }
+        shadow_log->lines[pos].stamp = pending[i].stamp;
+        memcpy(shadow_log->lines[pos].data, pending[i].data, SYNCH_SHADOW_LINE_SIZE);
+        synchNonTSOFence();
+        shadow_log->lines[pos].addr = pending[i].addr;
+    }
+    pending_size = 0;
+}
+
+void synchShadowPWB(void *ptr, size_t size) {
+    uint64_t line = (uint64_t)ptr & ~((uint64_t)SYNCH_SHADOW_LINE_SIZE - 1);
+    uint64_t end = (uint64_t)ptr + size;
+
+    countEvent();
+    for (; line < end; line += SYNCH_SHADOW_LINE_SIZE) {
+        if (pending_size == SYNCH_SHADOW_PENDING_LINES)
+            commitPending();
+        pending[pending_size].addr = line;
+        // the stamp is taken before the capture, so a capture with a larger stamp never misses a store
+        // that was visible to a capture with a smaller one
+        pending[pending_size].stamp = __FAA64(&shadow_log->stamps, 1);
+        memcpy(pending[pending_size].data, (void *)line, SYNCH_SHADOW_LINE_SIZE);
+        pending_size++;
+    }
+}
+
+void synchShadowPSync(void) {
+    countEvent();
+    commitPending();
+}
+
+static int compareLines(const void *a, const void *b) {
+    const SynchShadowLine *l1 = *(const SynchShadowLine **)a;
+    const SynchShadowLine *l2 = *(const SynchShadowLine **)b;
+
+    if (l1->addr != l2->addr)
+        return (l1->addr < l2->addr) ? -1 : 1;
+    // entries of the same line are ordered by the time they were captured, so the latest one is the last
+    return (l1->stamp > l2->stamp) - (l1->stamp < l2->stamp);
+}
+
+int synchShadowBuildView(SynchShadowView *view) {
+    uint64_t used = shadow_log->size, i, n = 0;
+    SynchShadowLine **sorted;
+
+    if (used > shadow_log->capacity)
+        used = shadow_log->capacity;
+    sorted = malloc((used + 1) * sizeof(SynchShadowLine *));
+    view->lines = malloc((used + 1) * sizeof(SynchShadowLine));
+    if (sorted == NULL || view->lines == NULL) {
+        free(sorted);
+        free(view->lines);
+        return -1;
+    }
+
+    // entries that were not completely written before the crash are ignored
+    for (i = 0; i < used; i++) {
+        if (shadow_log->lines[i].addr != 0)
+            sorted[n++] = &shadow_log->lines[i];
+    }
+    qsort(sorted, n, sizeof(SynchShadowLine *), compareLines);
+
+    view->nlines = 0;
+    for (i = 0; i < n; i++) {
+        if (i + 1 < n && sorted[i + 1]->addr == sorted[i]->addr)
+            continue;
+        memcpy(&view->lines[view->nlines++], sorted[i], sizeof(SynchShadowLine));
+    }
+    free(sorted);
+
+    return 0;
+}
+
+void synchShadowFreeView(SynchShadowView *view) {
+    free(view->lines);
+    view->lines = NULL;
+    view->nlines = 0;
+}
+
+static SynchShadowLine *findLine(SynchShadowView *view, uint64_t line) {
+    int64_t low = 0, high = (int64_t)view->nlines - 1;
+
+    while (low <= high) {
+        int64_t mid = (low + high) / 2;
+
+        if (view->lines[mid].addr == line)
+            return &view->lines[mid];
+        else if (view->lines[mid].addr < line)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return NULL;
+}
+
+bool synchShadowRead(SynchShadowView *view, const void *addr, void *buf, size_t size) {
+    uint64_t pos = (uint64_t)addr;
+    uint64_t end = pos + size;
+
+    while (pos < end) {
+        uint64_t line = pos & ~((uint64_t)SYNCH_SHADOW_LINE_SIZE - 1);
+        uint64_t offset = pos - line;
+        uint64_t len = SYNCH_SHADOW_LINE_SIZE - offset;
+        SynchShadowLine *entry = findLine(view, line);
+
+        if (entry == NULL)
+            return false;
+        if (len > end - pos)
+            len = end - pos;
+        memcpy(buf, entry->data + offset, len);
+        buf = (char *)buf + len;
+        pos += len;
+    }
+
+    return true;
+}
@@ -2,6 +2,7 @@
 #include <stats.h>
 #include <primitives.h>
 #include <threadtools.h>
+#include <pool.h>
 
 #ifdef DEBUG
 #    include <types.h>
@@ -30,7 +31,7 @@ volatile int64_t __total_executed_pwb = 0;
 #    include <pthread.h>
 #    include <papi.h>
 
-#    define N_CPU_COUNTERS 4
+#    define N_CPU_COUNTERS 5
 
 static volatile int *__cpu_events = NULL;
 static volatile long long **__cpu_values = NULL;
@@ -106,6 +107,10 @@ void synchStartCPUCounters(int id) {
         if (id == 0)
             fprintf(stderr, "PAPI WARNING: unable to create event for cpu stalls\n");
     }
+    if (PAPI_add_event(__cpu_events[id], PAPI_TLB_DM) != PAPI_OK) {
+        if (id == 0)
+            fprintf(stderr, "PAPI WARNING: unable to create event for data TLB misses\n");
+    }
     if (PAPI_start(__cpu_events[id]) != PAPI_OK) {
         fprintf(stderr, "PAPI ERROR: unable to start performance counters\n");
         exit(EXIT_FAILURE);
@@ -154,6 +159,33 @@ void synchPrintStats(uint32_t nthreads, uint64_t runs) {
 #endif
     printf("\n");
 
+    SynchPoolStats pool_stats;
+
+    synchPoolGetStats(&pool_stats);
+    if (pool_stats.peak_bytes > 0) {
+        fprintf(stderr, "pool_blocks: %lu\tpool_reserved: %.2f (MB)\tpool_peak_reserved: %.2f (MB)\tpool_persistent_reserved: %.2f (MB)\n",
+                pool_stats.blocks, pool_stats.bytes / (1024.0 * 1024.0), pool_stats.peak_bytes / (1024.0 * 1024.0),
+                pool_stats.persistent_bytes / (1024.0 * 1024.0));
+    }
+
+#ifdef SYNCH_HUGE_PAGES
+    // the amount of memory that is currently mapped using huge pages, either transparent or explicit ones
+    FILE *smaps = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+    long kbytes, huge_kbytes = 0;
+
+    if (smaps != NULL) {
+        while (fgets(line, sizeof(line), smaps) != NULL) {
+            if (sscanf(line, "AnonHugePages: %ld kB", &kbytes) == 1 || sscanf(line, "ShmemPmdMapped: %ld kB", &kbytes) == 1 ||
+                sscanf(line, "FilePmdMapped: %ld kB", &kbytes) == 1 || sscanf(line, "Private_Hugetlb: %ld kB", &kbytes) == 1 ||
+                sscanf(line, "Shared_Hugetlb: %ld kB", &kbytes) == 1)
+                huge_kbytes += kbytes;
+        }
+        fclose(smaps);
+        fprintf(stderr, "huge_pages: %.2f (MB)\n", huge_kbytes / 1024.0);
+    }
+#endif
+
 #ifdef SYNCH_TRACK_CPU_COUNTERS
     long long __total_cpu_values[N_CPU_COUNTERS];
     int k, j;
@@ -169,11 +201,13 @@ void synchPrintStats(uint32_t nthreads, uint64_t runs) {
             "DEBUG: L1 data cache misses: %.2lf\t"
             "L2 data cache misses: %.2lf\t"
             "Branch mis-predictions: %.2lf\t"
-            "CPU stalls: %.2lf\t total operations: %ld\n",
+            "CPU stalls: %.2lf\t"
+            "Data TLB misses: %.2lf\t total operations: %ld\n",
             __total_cpu_values[0] / ops,
             __total_cpu_values[1] / ops,
             __total_cpu_values[2] / ops,
             __total_cpu_values[3] / ops,
+            __total_cpu_values[4] / ops,
             (long)ops);
 #endif
 }
@@ -45,6 +45,26 @@ inline uint32_t synchGetNCores(void) {
     return __ncores;
 }
 
+inline uint32_t synchGetNumaNodes(void) {
+#ifdef SYNCH_NUMA_SUPPORT
+    int nodes = numa_num_task_nodes();
+
+    return (nodes > 0) ? nodes : 1;
+#else
+    return 1;
+#endif
+}
+
+inline uint32_t synchGetPreferedNumaNode(void) {
+#ifdef SYNCH_NUMA_SUPPORT
+    int node = numa_node_of_cpu(synchGetPreferedCore());
+
+    return (node > 0) ? node : 0;
+#else
+    return 0;
+#endif
+}
+
 inline static void *kthreadWrapper(void *arg) {
     int cpu_id;
     long pid = (long)arg;
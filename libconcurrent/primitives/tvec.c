@@ -0,0 +1,182 @@
+#include <tvec.h>
+
+#if defined(__GNUC__) && (defined(__amd64__) || defined(__x86_64__))
+#    include <immintrin.h>
+#    define TVEC_SIMD_X86
+#endif
+
+int synch_tvec_simd = TVEC_SIMD_NONE;
+
+#ifdef TVEC_SIMD_X86
+__attribute__((constructor)) static void detectSIMD(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        synch_tvec_simd = TVEC_SIMD_AVX512;
+    else if (__builtin_cpu_supports("avx2"))
+        synch_tvec_simd = TVEC_SIMD_AVX2;
+}
+
+__attribute__((target("avx2"))) static uint32_t orAVX2(bitword_t *res, bitword_t *a, bitword_t *b, uint32_t cells) {
+    uint32_t i;
+
+    for (i = 0; i + 4 <= cells; i += 4) {
+        __m256i va = _mm256_loadu_si256((__m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((__m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(res + i), _mm256_or_si256(va, vb));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2"))) static uint32_t xorAVX2(bitword_t *res, bitword_t *a, bitword_t *b, uint32_t cells) {
+    uint32_t i;
+
+    for (i = 0; i + 4 <= cells; i += 4) {
+        __m256i va = _mm256_loadu_si256((__m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((__m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(res + i), _mm256_xor_si256(va, vb));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2"))) static uint32_t orReduceAVX2(bitword_t *res, ToggleVector *tvs, uint32_t n, uint32_t cells) {
+    uint32_t i, j;
+
+    for (i = 0; i + 4 <= cells; i += 4) {
+        __m256i acc = _mm256_setzero_si256();
+
+        for (j = 0; j < n; j++)
+            acc = _mm256_or_si256(acc, _mm256_loadu_si256((__m256i *)(tvs[j].cell + i)));
+        _mm256_storeu_si256((__m256i *)(res + i), acc);
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2"))) static uint32_t nextCellAVX2(bitword_t *cell, uint32_t from, uint32_t cells) {
+    uint32_t i;
+
+    for (i = from; i + 4 <= cells; i += 4) {
+        __m256i v = _mm256_loadu_si256((__m256i *)(cell + i));
+
+        if (!_mm256_testz_si256(v, v))
+            break;
+    }
+
+    return i;
+}
+
+__attribute__((target("avx512f"))) static uint32_t orAVX512(bitword_t *res, bitword_t *a, bitword_t *b, uint32_t cells) {
+    uint32_t i;
+
+    for (i = 0; i + 8 <= cells; i += 8) {
+        __m512i va = _mm512_loadu_si512((void *)(a + i));
+        __m512i vb = _mm512_loadu_si512((void *)(b + i));
+        _mm512_storeu_si512((void *)(res + i), _mm512_or_si512(va, vb));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx512f"))) static uint32_t xorAVX512(bitword_t *res, bitword_t *a, bitword_t *b, uint32_t cells) {
+    uint32_t i;
+
+    for (i = 0; i + 8 <= cells; i += 8) {
+        __m512i va = _mm512_loadu_si512((void *)(a + i));
+        __m512i vb = _mm512_loadu_si512((void *)(b + i));
+        _mm512_storeu_si512((void *)(res + i), _mm512_xor_si512(va, vb));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx512f"))) static uint32_t orReduceAVX512(bitword_t *res, ToggleVector *tvs, uint32_t n, uint32_t cells) {
+    uint32_t i, j;
+
+    for (i = 0; i + 8 <= cells; i += 8) {
+        __m512i acc = _mm512_setzero_si512();
+
+        for (j = 0; j < n; j++)
+            acc = _mm512_or_si512(acc, _mm512_loadu_si512((void *)(tvs[j].cell + i)));
+        _mm512_storeu_si512((void *)(res + i), acc);
+    }
+
+    return i;
+}
+
+__attribute__((target("avx512f"))) static uint32_t nextCellAVX512(bitword_t *cell, uint32_t from, uint32_t cells) {
+    uint32_t i;
+
+    for (i = from; i + 8 <= cells; i += 8) {
+        __m512i v = _mm512_loadu_si512((void *)(cell + i));
+
+        if (_mm512_test_epi64_mask(v, v) != 0)
+            break;
+    }
+
+    return i;
+}
+#endif
+
+// Each of the following functions processes as many cells as possible with the widest available SIMD instructions
+// and it falls back to scalar code for the remaining cells.
+
+void synchTVecOr(bitword_t *res, bitword_t *a, bitword_t *b, uint32_t cells) {
+    uint32_t i = 0;
+
+#ifdef TVEC_SIMD_X86
+    if (synch_tvec_simd == TVEC_SIMD_AVX512)
+        i = orAVX512(res, a, b, cells);
+    else if (synch_tvec_simd == TVEC_SIMD_AVX2)
+        i = orAVX2(res, a, b, cells);
+#endif
+    for (; i < cells; i++)
+        res[i] = a[i] | b[i];
+}
+
+void synchTVecXor(bitword_t *res, bitword_t *a, bitword_t *b, uint32_t cells) {
+    uint32_t i = 0;
+
+#ifdef TVEC_SIMD_X86
+    if (synch_tvec_simd == TVEC_SIMD_AVX512)
+        i = xorAVX512(res, a, b, cells);
+    else if (synch_tvec_simd == TVEC_SIMD_AVX2)
+        i = xorAVX2(res, a, b, cells);
+#endif
+    for (; i < cells; i++)
+        res[i] = a[i] ^ b[i];
+}
+
+void synchTVecOrReduce(bitword_t *res, ToggleVector *tvs, uint32_t n, uint32_t cells) {
+    uint32_t i = 0, j;
+
+#ifdef TVEC_SIMD_X86
+    if (synch_tvec_simd == TVEC_SIMD_AVX512)
+        i = orReduceAVX512(res, tvs, n, cells);
+    else if (synch_tvec_simd == TVEC_SIMD_AVX2)
+        i = orReduceAVX2(res, tvs, n, cells);
+#endif
+    for (; i < cells; i++) {
+        bitword_t w = 0;
+
+        for (j = 0; j < n; j++)
+            w |= tvs[j].cell[i];
+        res[i] = w;
+    }
+}
+
+uint32_t synchTVecNextCell(bitword_t *cell, uint32_t from, uint32_t cells) {
+    uint32_t i = from;
+
+#ifdef TVEC_SIMD_X86
+    if (synch_tvec_simd == TVEC_SIMD_AVX512)
+        i = nextCellAVX512(cell, from, cells);
+    else if (synch_tvec_simd == TVEC_SIMD_AVX2)
+        i = nextCellAVX2(cell, from, cells);
+#endif
+    while (i < cells && cell[i] == 0)
+        i++;
+
+    return i;
+}